@@ -40,6 +40,10 @@ class ApertureStop
 
         ApertureStop(){}    /**< \brief creates an empty ApertureStop container with no obstructing region*/
 
+        /** \brief copy constructor. Every Region of the source aperture is duplicated, since regions are owned and deleted by their container
+         */
+        ApertureStop(const ApertureStop& aperture);
+
         /** \brief destructor. Clear the region list and destroy the object
          *
          *  the destructor will destroy all regions of the list with the delete operator. It mean that the regions must be created on the stack before assignation
@@ -54,6 +58,16 @@ class ApertureStop
          */
         double getTransmissionAt(const Ref<Vector2d> &point);
 
+        /** \brief Get a box enclosing the transmitting area of the composite aperture
+         *
+         *  Since the outside of all regions is opaque when the first region is transparent, the transmitting area
+         *  is contained in the union of the transparent regions
+         * \param[out] lower the lower X and Y bounds of the box
+         * \param[out] upper the upper X and Y bounds of the box
+         * \return true if the transmitting area is bounded; false if the aperture is empty or its first region is opaque
+         */
+        bool getBoundingBox(Vector2d &lower, Vector2d &upper);
+
         /** \brief Adds a region to the top of the region list and return its index
          *
          * \param pRegion a pointer to the Region object to be added to the list
@@ -83,6 +83,7 @@ class Ellipse: public Region
         void move(double angle, const Ref<Vector2d> &translation);
         void setSymmetric(const Ref<Vector2d> &point, const Ref<Vector2d> &dir);
         void setSymmetric(const Ref<Vector2d> &point);
+        void getBoundingBox(Vector2d &lower, Vector2d &upper);
 
         void dump(){std::cout << std::endl << m_Mat << std::endl;}/**< \brief \e Debugging \e function: dumps the internal ellipse matrix to std::out */
 
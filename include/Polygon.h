@@ -105,6 +105,7 @@ class Polygon: public Region
 
          void setSymmetric(const Ref<Vector2d> &point, const Ref<Vector2d> &dir);
          void setSymmetric(const Ref<Vector2d> &point);
+         void getBoundingBox(Vector2d &lower, Vector2d &upper);
 
          /** \brief \brief \e Debugging \e function: dumps the internal data arrays (vertices, side vectors and side equations) to std::out
           */
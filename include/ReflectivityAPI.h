@@ -419,6 +419,26 @@ DLL_EXPORT bool CoatingTableCompute(const char* coatingTable);
 
 DLL_EXPORT bool GetCoatingTableStatus(const char* coatingTable, short * pstatus);
 
+/** \brief Tabulates the reflectivity of the coatings of several CoatingTables
+ *
+ *  Each table is computed as by CoatingTableCompute(), one after the other, since the tables share the material databases
+ *  and RefleX does not guarantee their concurrent use. The progress can be polled from another thread with GetCoatingComputeProgress()
+ * \param numTables the number of tables in the list
+ * \param tableNames an array of numTables names of CoatingTable. A table cannot be listed twice
+ * \return true if all tables were successfully tabulated; false otherwise and OptiXLastError reports the first failure
+ */
+DLL_EXPORT bool CoatingTablesCompute(int32_t numTables, const char** tableNames);
+
+/** \brief Retrieves the progress of the running, or last, call to CoatingTableCompute() or CoatingTablesCompute()
+ *
+ *  The progress is counted in tables, since RefleX computes a table in a single call: CoatingTableCompute() goes from 0/1 to 1/1.
+ * \param[out] tablesDone address of a variable which will receive the number of tables whose computation is finished, successfully or not
+ * \param[out] tablesTotal address of a variable which will receive the number of tables to compute
+ * \return true if the values are returned; false if an address is invalid
+ *  \note Since it can be called while another thread is computing, this function neither clears nor sets OptiXLastError
+ */
+DLL_EXPORT bool GetCoatingComputeProgress(int32_t* tablesDone, int32_t* tablesTotal);
+
 
 /** \} */     // ingroup reflectivityAPI
 
@@ -89,6 +89,13 @@ class Region
          */
         virtual void setSymmetric(const Ref<Vector2d> &point)=0;
 
+        /** \brief computes the smallest box, with sides parallel to the axes, which encloses the region
+         *
+         * \param[out] lower the lower X and Y bounds of the box
+         * \param[out] upper the upper X and Y bounds of the box
+         */
+        virtual void getBoundingBox(Vector2d &lower, Vector2d &upper)=0;
+
         virtual void  operator>>(xmlNodePtr apernode)=0;
 
     protected:
@@ -0,0 +1,70 @@
+#ifndef ALIGNMENTCACHE_H_INCLUDED
+#define ALIGNMENTCACHE_H_INCLUDED
+
+////////////////////////////////////////////////////////////////////////////////
+/**
+*      \file           alignmentcache.h
+*
+*      \brief         Precomputed alignments of an element chain for energy scans
+*
+*      \author         François Polack <francois.polack@synchroton-soleil.fr>
+*      \date        2024-10-31  Creation
+*      \date         Last update
+*
+
+*/
+///////////////////////////////////////////////////////////////////////////////////
+//
+//             REVISIONS
+//
+////////////////////////////////////////////////////////////////////////////////////
+
+#include "gratingbase.h"
+#include <vector>
+
+/** \brief Stores the alignment of an element chain at each wavelength of a list, so that the steps of an energy scan do not need a full realignment
+ *
+ *  The cache is built on a copy of the chain (see DuplicateChain()), and does not modify the original chain.
+ *  Applying a cached step copies back the space transforms and the aligned surface equations of each element, without any computation.
+ *  Gratings also reload their diffraction orders from the parameters, and rebuild their grating vector map if it is outdated (see GratingBase::restoreAlignment()).
+ *  It replaces the call to ElementBase::alignFromHere() (and to AlignGrating4Cff() in constant Cff mode).
+ *  \n The cached alignments are only valid as long as the parameters and the links of the elements are not changed.
+ *  Applying a step of an outdated cache throws an exception.
+ */
+class AlignmentCache
+{
+public:
+    AlignmentCache():m_first(NULL), m_grating(NULL){} /**< \brief default constructor of an empty cache */
+
+    /** \brief computes and stores the alignment of the chain at each wavelength
+     * \param first the first element of the chain to align
+     * \param wavelengths the list of alignment wavelengths (must be > 0)
+     * \param grating if not NULL, a grating of the chain the theta angle of which is set at each wavelength to keep a constant Cff value
+     * \param Cff the Cff value used if grating is not NULL (must be > 0)
+     * \throw ParameterException if the arguments are invalid, ElementException if the alignment failed at some wavelength
+     */
+    void build(ElementBase* first, const std::vector<double>& wavelengths, GratingBase* grating=NULL, double Cff=0);
+
+    /** \brief aligns the original chain as computed at a wavelength of the list
+     *
+     *  In constant Cff mode the theta parameter of the grating is updated
+     * \param index the index of the wavelength in the list given to build()
+     * \throw ParameterException if the index is out of range or the chain was modified after the cache was built
+     */
+    void apply(size_t index);
+
+    inline size_t size(){return m_wavelengths.size();} /**< \brief returns the number of cached wavelengths */
+    inline double getWavelength(size_t index){return m_wavelengths.at(index);} /**< \brief returns the wavelength of a cached step */
+    inline const std::vector<ElementBase*>& getElements(){return m_elements;} /**< \brief returns the elements of the cached chain, in chain order */
+
+private:
+    ElementBase* m_first;       /**< \brief first element of the cached chain */
+    GratingBase* m_grating;     /**< \brief the grating aligned at constant Cff, or NULL */
+    std::vector<ElementBase*> m_elements;   /**< \brief the elements of the chain, in chain order */
+    std::vector<uint64_t> m_changeCounts;   /**< \brief the parameter change counters of the elements, when the cache was built or last applied */
+    std::vector<double> m_wavelengths;      /**< \brief the cached wavelengths */
+    std::vector<double> m_thetas;           /**< \brief the theta value of m_grating at each wavelength */
+    std::vector<std::vector<ElementBase::AlignmentState> > m_states; /**< \brief the saved transforms of each element (second index) at each wavelength (first index) */
+};
+
+#endif // ALIGNMENTCACHE_H_INCLUDED
@@ -84,11 +84,23 @@ class BidimSpline
          *  - \f$   limits =  \left[ {\begin{array}{cc}     x_{min} & y_{min} \\     x_{max} & y_{max} \\   \end{array} } \right]  \f$
          * \param gridData Array of the surface points in an evenly spaced grid inside the rectangle defined by limits
          *
+         *  The tensor product system is separable. It is solved by two passes of the tridiagonal uniformSpaced1DSolveT() solver, along X then along Y,
+         *  which is linear in the number of data points, instead of the general sparse solve of buildControlPoints().
+         *  At least 4 points are required along each axis.
          */
         void setFromGridData(const Array22d& limits, const Ref<ArrayXXd> & gridData );
 
 
-        void setFromGradient(const Array22d& limits, const Ref<ArrayXXd> & gradx, const Ref<ArrayXXd> & grady);
+        /** \brief Defines the 2D spline interpolator of a surface from its gradient known on evenly spaced points
+         *
+         * \param limits the aperture limits into which the surface is defined, with the same layout as in setFromGridData()
+         * \param gradx Array of the X partial derivatives of the surface in an evenly spaced grid inside the rectangle defined by limits
+         * \param grady Array of the Y partial derivatives of the surface, with the same dimensions as gradx
+         * \param spectral if true (default) the gradient is integrated into heights by SpectralIntegrateGradient() and the interpolator is built by setFromGridData().
+         *      If false, the control values are directly obtained from a sparse least squares system, which is much slower
+         *      and limited to small grids.
+         */
+        void setFromGradient(const Array22d& limits, const Ref<ArrayXXd> & gradx, const Ref<ArrayXXd> & grady, bool spectral=true);
 
         /** \brief retieves the interpolation limits as a fixed size array
          *
@@ -261,6 +273,8 @@ class BidimSpline
         *
         * \param input  The sampled data. It can be a RowVector or or an array, in which case the equation is solved for each row of the input
         * \return ArrayXXd an array 2 rows larger than input has columns. Its number of columns is the number of rows of input
+        *
+        *  The rows of input are solved by panels distributed over the OpenMP threads.
         */
        ArrayXXd uniformSpaced1DSolveT(const Ref<ArrayXXd> &input);
 
@@ -286,6 +300,18 @@ class BidimSpline
     private:
 };
 
+/** \brief Integrates a gradient map into a height map by the Frankot-Chellappa method
+ *
+ *  The gradient maps are mirrored on a grid of double size, to make their periodic extension continuous, and the heights are obtained
+ *  as the least squares integrable surface, by a division in Fourier space.
+ * \param gradx Array of the X partial derivatives sampled on an evenly spaced grid (X along the rows)
+ * \param grady Array of the Y partial derivatives, with the same dimensions as gradx
+ * \param xStep the grid step in X
+ * \param yStep the grid step in Y
+ * \return the array of integrated heights, with the same dimensions as gradx. The integration constant is set to give a zero mean height
+ */
+ArrayXXd SpectralIntegrateGradient(const Ref<const ArrayXXd>& gradx, const Ref<const ArrayXXd>& grady, double xStep, double yStep);
+
 #endif // BIDIMSPLINE_Hr
 
 
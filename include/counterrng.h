@@ -0,0 +1,76 @@
+#ifndef COUNTERRNG_H_INCLUDED
+#define COUNTERRNG_H_INCLUDED
+
+////////////////////////////////////////////////////////////////////////////////
+/**
+*      \file           counterrng.h
+*
+*      \brief         Counter based random number generator for parallel ray generation
+*
+*      \author         François Polack <francois.polack@synchroton-soleil.fr>
+*      \date        2024-10-28  Creation
+*      \date         Last update
+*
+
+*/
+///////////////////////////////////////////////////////////////////////////////////
+//
+//             REVISIONS
+//
+////////////////////////////////////////////////////////////////////////////////////
+
+#include <inttypes.h>
+
+/** \brief Philox4x32-10 counter based random number generator (J. K. Salmon et al., SC'11)
+ *
+ *  The generator has no state: each call returns four independent 32 bit random words computed from a 128 bit counter and the 64 bit seed.
+ *  Giving each ray its own counter value makes the draws independent of the thread which computes the ray,
+ *  so that a parallel generation is reproducible for a given seed.
+ */
+class CounterRNG
+{
+public:
+    /** \brief constructor
+     * \param seed the key of the generator. Different seeds give independent sequences
+     */
+    explicit CounterRNG(uint64_t seed=0):m_key0(uint32_t(seed)), m_key1(uint32_t(seed >> 32)){}
+
+    /** \brief computes the four random words of a counter value
+     * \param counter the first 64 bits of the counter, usually the index of the ray
+     * \param stream the last 64 bits of the counter, used to get more than four words per ray
+     * \param[out] words an array of four 32 bit words which receives the random values
+     */
+    inline void block(uint64_t counter, uint64_t stream, uint32_t words[4]) const
+    {
+        uint32_t c0=uint32_t(counter), c1=uint32_t(counter >> 32), c2=uint32_t(stream), c3=uint32_t(stream >> 32);
+        uint32_t k0=m_key0, k1=m_key1;
+        for(int round=0; round < 10; ++round)
+        {
+            uint64_t p0=uint64_t(0xD2511F53U)*c0;
+            uint64_t p1=uint64_t(0xCD9E8D57U)*c2;
+            uint32_t n0=uint32_t(p1 >> 32)^c1^k0;
+            uint32_t n2=uint32_t(p0 >> 32)^c3^k1;
+            c1=uint32_t(p1);
+            c3=uint32_t(p0);
+            c0=n0;
+            c2=n2;
+            k0+=0x9E3779B9U;
+            k1+=0xBB67AE85U;
+        }
+        words[0]=c0;
+        words[1]=c1;
+        words[2]=c2;
+        words[3]=c3;
+    }
+
+    /** \brief converts a random word to a uniform deviate in the open interval (0,1) */
+    static inline double uniform(uint32_t word){return (word+0.5)*0x1.0p-32;}
+
+    /** \brief converts two random words to a uniform deviate with 53 significant bits in the interval [0,1) */
+    static inline double uniform(uint32_t high, uint32_t low){return ((uint64_t(high) << 21) ^ (low >> 11))*0x1.0p-53;}
+
+private:
+    uint32_t m_key0, m_key1;
+};
+
+#endif // COUNTERRNG_H_INCLUDED
@@ -51,7 +51,74 @@ enum UnitType/*:int32_t*/{
 enum RecordMode{
     RecordNone=0,   /**< do not record impacts on this surface */
     RecordInput=1,  /**< record the inpacts in entrance space  */
-    RecordOutput=2  /**< record the impacts in exit space */
+    RecordOutput=2,  /**< record the impacts in exit space */
+    RecordInputStatistics=3,    /**< do not store the impacts but accumulate the spot statistics in entrance space (must be equal to RecordInput+2) */
+    RecordOutputStatistics=4    /**< do not store the impacts but accumulate the spot statistics in exit space (must be equal to RecordOutput+2) */
+};
+
+/** \ingroup enums
+ * \brief Bit flags selecting the ray data kept in compact impact recording (see SetRecordingFormat)
+ */
+enum ImpactField{
+    ImpactPosition=1,       /**< position of the impact (origin and distance of the ray) */
+    ImpactDirection=2,      /**< direction of the ray */
+    ImpactWavelength=4,     /**< wavelength of the ray */
+    ImpactIntensity=8,      /**< intensity of the ray \f$ |A_S|^2+|A_P|^2 \f$ ; not stored if ImpactPolarization is set*/
+    ImpactPolarization=16,  /**< complex S and P amplitudes and S polarization vector */
+    ImpactAllFields=31      /**< all ray data */
+};
+
+/** \ingroup enums
+ * \brief Floating point precision of the compact impact storage
+ */
+enum ImpactPrecision{
+    Float32Precision=0,     /**< impact data are stored as 4 byte floats */
+    Float64Precision=1,     /**< impact data are stored as 8 byte doubles */
+    LongDoublePrecision=2   /**< impact data are stored in the internal computation precision (FloatType) */
+};
+
+/** \ingroup enums
+ * \brief Identifiers of the scalar columns of an impact file (see ExportImpacts)
+ *
+ *  The columns related to an \ref ImpactField flag are stored if this flag is set
+ */
+enum ImpactColumn{
+    ColumnX=0,          /**< X coordinate of the impact (ImpactPosition)*/
+    ColumnY=1,          /**< Y coordinate of the impact (ImpactPosition)*/
+    ColumnZ=2,          /**< Z coordinate of the impact (ImpactPosition)*/
+    ColumnDistance=3,   /**< path length of the ray from its previous origin (ImpactPosition)*/
+    ColumnDX=4,         /**< X component of the ray direction (ImpactDirection)*/
+    ColumnDY=5,         /**< Y component of the ray direction (ImpactDirection)*/
+    ColumnDZ=6,         /**< Z component of the ray direction (ImpactDirection)*/
+    ColumnWavelength=7, /**< wavelength of the ray (ImpactWavelength)*/
+    ColumnIntensity=8,  /**< intensity \f$ |A_S|^2+|A_P|^2 \f$ of the ray (ImpactIntensity)*/
+    ColumnReS=9,        /**< real part of the S amplitude (ImpactPolarization)*/
+    ColumnImS=10,       /**< imaginary part of the S amplitude (ImpactPolarization)*/
+    ColumnReP=11,       /**< real part of the P amplitude (ImpactPolarization)*/
+    ColumnImP=12,       /**< imaginary part of the P amplitude (ImpactPolarization)*/
+    ColumnSX=13,        /**< X component of the S polarization vector (ImpactPolarization)*/
+    ColumnSY=14,        /**< Y component of the S polarization vector (ImpactPolarization)*/
+    ColumnSZ=15,        /**< Z component of the S polarization vector (ImpactPolarization)*/
+    ColumnAlive=16,     /**< alive flags of the rays, stored as one byte per ray. This column is always present */
+    ColumnOrder=17      /**< diffraction order of the last grating met by the rays, stored as one int16 per ray. This column is always present */
+};
+
+/** \ingroup enums
+ * \brief Sampling method of the random sources, selected by their "sampling" parameter
+ */
+enum SamplingMode{
+    PseudoRandomSampling=0, /**< independent pseudo random draws (default) */
+    SobolSampling=1,        /**< Owen scrambled Sobol low discrepancy sequence */
+    HaltonSampling=2        /**< Halton low discrepancy sequence with a random shift */
+};
+
+/** \ingroup enums
+ * \brief Shape of the region of interest of a recording filter
+ */
+enum RoiShape{
+    RoiNone=0,      /**< no region of interest */
+    RoiRectangle=1, /**< rectangular region of interest */
+    RoiEllipse=2    /**< elliptical region of interest */
 };
 
 /** \ingroup enums
@@ -338,6 +405,14 @@ typedef struct __Parameter{
 }Parameter; /**< \brief Struct defining a parameter for the interface functions */
 
 
+/** \ingroup enums
+ * \brief probability law of the random deviations applied to a toleranced parameter
+ */
+enum ToleranceLaw{
+    UniformLaw=0,   /**< the deviation is uniformly distributed in the [-spread, +spread] interval */
+    GaussianLaw=1   /**< the deviation is normally distributed with a standard deviation equal to spread */
+};
+
 /** \brief Structure designed to receive spot diagram
  *
  *  The calling program must define the m_dim member to the appropriate spot vector size,
@@ -358,6 +433,84 @@ typedef struct __C_DiagramStruct
 }C_DiagramStruct; /**< \brief struct for returning a spot diagram through the interface functions */
 
 
+/** \brief Structure designed to receive the spot statistics accumulated by a surface in RecordInputStatistics or RecordOutputStatistics mode
+ *
+ *  The 4 components of the vectors are X, Y, and the X and Y direction cosines of the rays in the AlignedLocalFrame of the surface,
+ *  on the plane Z=0 of this frame, as in the spot diagrams
+ */
+typedef struct __C_SpotStatistics
+{
+    int64_t count;      /**< \brief number of rays accumulated */
+    int64_t lost;       /**< \brief number of rays reaching the surface dead or lost at the surface */
+    double mean[4];     /**< \brief mean value of the 4 components */
+    double sigma[4];    /**< \brief RMS value of the 4 components */
+    double min[4];      /**< \brief minimum value of the 4 components */
+    double max[4];      /**< \brief maximum value of the 4 components */
+    double covariance[16];  /**< \brief the 4 x 4 covariance matrix of the components (symmetric) */
+}C_SpotStatistics;
+
+/** \brief Structure receiving the best focus position computed from the ray moments (see GetBestFocus())
+ *
+ *  Distances are measured along the alignment axis from the surface, in the AlignedLocalFrame of the surface.
+ *  RMS sizes are intensity weighted if requested. If the beam is collimated in one direction, the corresponding distance is NaN
+ */
+typedef struct __BestFocus
+{
+    double zX;          /**< \brief distance of the minimum RMS size in X */
+    double zY;          /**< \brief distance of the minimum RMS size in Y */
+    double z;           /**< \brief distance of the minimum of the combined RMS size \f$ \sqrt{\sigma_x^2+\sigma_y^2} \f$ */
+    double waistX;      /**< \brief RMS size in X at distance zX */
+    double waistY;      /**< \brief RMS size in Y at distance zY */
+    double waist;       /**< \brief combined RMS size at distance z */
+    double meanX;       /**< \brief mean X position of the spot at distance z */
+    double meanY;       /**< \brief mean Y position of the spot at distance z */
+    int64_t count;      /**< \brief number of alive rays used in the computation */
+}BestFocus;
+
+/** \brief Structure defining the filter applied to the impacts before recording (see SetRecordingFilter())
+ *
+ *  An impact is recorded if it passes all the active criteria. Decimation applies to the rays which passed the alive, order and region of interest tests.
+ *  They are counted in propagation order from the last ClearImpacts call, so that the selection is reproducible. When lost rays or a part of the rays are discarded, the impact indexes are no longer common to all the surfaces.
+ */
+typedef struct __RecordingFilter
+{
+    int32_t roiShape;       /**< \brief shape of the region of interest, a value of the \ref RoiShape enum */
+    int32_t roiFrame;       /**< \brief frame in which the region of interest is defined, a value of the \ref FrameID enum. The test is made on the X and Y coordinates of the impact*/
+    double roiCenter[2];    /**< \brief X and Y coordinates of the center of the region of interest */
+    double roiHalfSize[2];  /**< \brief half widths of the rectangle or semi axes of the ellipse, along X and Y */
+    int64_t stride;         /**< \brief only one ray in stride is recorded (1 or less to disable)*/
+    double probability;     /**< \brief probability of recording a ray (1 or more to disable) */
+    uint64_t seed;          /**< \brief seed of the random selection of the rays when probability < 1 */
+    int32_t aliveOnly;      /**< \brief if non zero the lost rays are not recorded */
+    int32_t orderActive;    /**< \brief if non zero only the rays diffracted in the given order by the last grating met are recorded */
+    int32_t order;          /**< \brief the diffraction order selected when orderActive is non zero (see GratingBase multi-order mode) */
+}RecordingFilter;
+
+/** \brief Header of the columnar binary impact files written by ExportImpacts()
+ *
+ *  The file starts with this 256 byte header, in the native (little endian) byte order. It is followed by numColumns scalar columns
+ *  of numRays values, in float or double according to precision, by the alive column of numRays bytes and by the order column of numRays int16.
+ *  Column k, which holds the data identified by columns[k], starts at byte dataOffset + k*columnStride of the file;
+ *  the alive column starts at dataOffset + numColumns*columnStride, and the order column 64 byte aligned after the alive column.
+ *  dataOffset and columnStride are multiples of 64 bytes, so that the file can be memory mapped and each column read as an aligned array.
+ */
+typedef struct __ImpactFileHeader
+{
+    char magic[8];          /**< \brief file signature "OPTXIMPC" (not null terminated)*/
+    uint32_t version;       /**< \brief version of the file format, currently 2 (version 1 files have no order column) */
+    uint32_t headerSize;    /**< \brief size of the header in bytes */
+    uint32_t fields;        /**< \brief the combination of \ref ImpactField flags defining the stored columns */
+    int32_t precision;      /**< \brief Float32Precision or Float64Precision, a value of the \ref ImpactPrecision enum */
+    int32_t frame;          /**< \brief the frame of the positions and directions, a value of the \ref FrameID enum*/
+    uint32_t numColumns;    /**< \brief number of scalar columns, the alive column excepted */
+    uint64_t numRays;       /**< \brief number of impacts stored in each column */
+    uint64_t columnStride;  /**< \brief distance in bytes between the beginnings of two consecutive columns */
+    uint64_t dataOffset;    /**< \brief position in the file of the first column */
+    int32_t columns[16];    /**< \brief \ref ImpactColumn identifiers of the stored columns in file order; unused entries are -1 */
+    char elementName[64];   /**< \brief name of the recording element, null terminated */
+    char reserved[72];      /**< \brief padding to 256 bytes, set to 0 */
+}ImpactFileHeader;
+
 /** \brief C equivalent structure to WavefrontData, holding a Wavefront map */
 typedef struct __C_WFtype
 {
@@ -467,5 +620,32 @@ typedef struct __SurfaceStats
     double sigmaPrimY;
 } SurfaceStats;
 
+/** \brief structure defining a randomly perturbed parameter in a Monte Carlo tolerance analysis
+ */
+typedef struct __ToleranceParameter
+{
+    size_t elementID;       /**< \brief the ID of the element holding the parameter */
+    const char* paramName;  /**< \brief the name of the toleranced parameter. Array parameters cannot be toleranced */
+    int32_t law;            /**< \brief the probability law of the deviation, a value of the \ref ToleranceLaw enum */
+    double spread;          /**< \brief half-width of the uniform law or standard deviation of the gaussian law, in internal units of the parameter */
+}ToleranceParameter;
+
+/** \brief structure returning the figures of merit of a Monte Carlo tolerance realization
+ *
+ *  All values are computed in the AlignedLocalFrame of the target surface, on the observation plane
+ */
+typedef struct __ToleranceResult
+{
+    double meanX;       /**< \brief mean X position of the spot */
+    double meanY;       /**< \brief mean Y position of the spot */
+    double sigmaX;      /**< \brief RMS width of the spot in X */
+    double sigmaY;      /**< \brief RMS width of the spot in Y */
+    double sigmaXprime; /**< \brief RMS divergence of the rays in X */
+    double sigmaYprime; /**< \brief RMS divergence of the rays in Y */
+    int32_t count;      /**< \brief number of rays reaching the target surface */
+    int32_t lost;       /**< \brief number of rays lost in the propagation */
+    int32_t status;     /**< \brief 0 if the realization is valid, -1 if the alignment or propagation failed */
+}ToleranceResult;
+
 #endif // CTYPES_H_INCLUDED
 
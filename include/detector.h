@@ -0,0 +1,107 @@
+#ifndef DETECTOR_H_INCLUDED
+#define DETECTOR_H_INCLUDED
+
+////////////////////////////////////////////////////////////////////////////////
+/**
+*      \file           detector.h
+*
+*      \brief         DetectorBase class declaration
+*
+*      DetectorBase defines the pixel image accumulation common to all Detector elements
+*
+*      \author         François Polack <francois.polack@synchroton-soleil.fr>
+*      \date        2024-10-21  Creation
+*      \date         Last update
+*
+
+*/
+///////////////////////////////////////////////////////////////////////////////////
+//
+//             REVISIONS
+//
+////////////////////////////////////////////////////////////////////////////////////
+
+#include "surface.h"
+
+/** \brief Base class for all detectors
+ *
+ *  A detector is a transmissive surface which deposits the intensity and Stokes parameters of each ray crossing it in a pixel image,
+ *  while the rays are propagated. No ray is stored, so that the memory used does not depend on the number of rays.
+ *  \n The image lies in a plane normal to the alignment axis, at a distance image_distance downstream of the surface; the pixel grid is centered on the axis.
+ *  Each OpenMP thread accumulates its own image and the images are summed on request by getImage().
+ *
+ *     Parameters defined  by the DetectorBase class
+ *     -----------------------------------------
+ *
+ *   Name of parameter | UnitType | Description
+ *   ----------------- | -------- | --------------
+ *   \b pixels_X | Dimensionless | Number of pixels along X
+ *   \b pixels_Y | Dimensionless | Number of pixels along Y
+ *   \b pixel_size_X | Distance | Pixel size along X
+ *   \b pixel_size_Y | Distance | Pixel size along Y
+ *   \b image_distance | Distance | distance of the image plane from the surface, along the alignment axis
+ *   \b lambda_bins | Dimensionless | Number of bins of the wavelength axis (1 for no wavelength resolution)
+ *   \b lambda_min | Distance | lower bound of the wavelength axis (unused if lambda_bins=1)
+ *   \b lambda_max | Distance | upper bound of the wavelength axis (unused if lambda_bins=1)
+ *
+ *  The image size is read from the parameters at alignment time. These parameters cannot be optimized (NotOptimizable flag set),
+ *  except image_distance.
+ */
+class DetectorBase: virtual public Surface
+{
+public:
+    /** \brief constructor overrides Surface constructor and defines the detector parameters
+     * \param name name of the new element (empty name by default)
+     * \param previous pointer to the previous element (NULL by default)
+     */
+    DetectorBase(string name="" ,Surface * previous=NULL);
+    virtual ~DetectorBase(){}  /**< \brief destructor */
+    virtual inline string getOptixClass(){return "DetectorBase";} /**< return the derived class name ie. DetectorBase */
+
+    /** \brief reads the image geometry from the parameters and resets the image
+     *
+     *  This function is called by Detector::align()
+     * \return 0 if successful; -1 if the parameters do not define a valid pixel grid (OptiX last error is set)
+     */
+    int setImageGeometry();
+
+    /** \brief ray transmission followed by the deposit of the ray in the image (reimplemented from Surface) */
+    virtual RayType& transmit(RayType& ray);
+
+    /** \brief clears the image and the impacts of all elements of the surface chain starting from this element (reimplemented from Surface)
+     *
+     *  The thread images are reallocated if the maximum number of OpenMP threads changed since the last call
+     */
+    virtual void clearImpacts();
+
+    /** \brief get the image accumulated since the last clearImpacts() call
+     *
+     * \param[out] dims the 4 image dimensions, from inner to outer: pixels_X, pixels_Y, lambda_bins, 4 Stokes parameters
+     * \return the sum of the thread images. Elements are ordered with the X pixel index varying fastest.
+     *  \n The 4 Stokes planes are in order: S0=Is+Ip, S1=Is-Ip, S2=Re(S*.P), S3=Im(S*.P), as in the rows 5 to 8 of the spot diagram
+     */
+    ArrayXd getImage(size_t dims[4]);
+
+    inline int64_t getOutsideCount(){return m_outsideCount.sum();} /**< \brief returns the number of alive rays which fell outside the image */
+
+    /** \brief returns the number of alive rays which could not be deposited, because the image geometry is invalid
+     * or the depositing thread has no image (thread number beyond the maximum number of threads at the last clearImpacts() call)
+     */
+    inline int64_t getDroppedCount(){return m_droppedCount;}
+
+protected:
+    /** \brief adds the ray to the image of the calling thread
+     * \param ray an alive ray, intercepted by the surface, in the entrance frame
+     */
+    void depositRay(RayType& ray);
+
+    Index m_nx=0, m_ny=0, m_nl=1;  /**< \brief the image dimensions; m_nl is the number of wavelength bins */
+    double m_pixelX=0, m_pixelY=0;  /**< \brief the pixel sizes */
+    double m_lambdaMin=0, m_lambdaMax=0;  /**< \brief the bounds of the wavelength axis */
+    FloatType m_imageDistance=0;    /**< \brief the distance of the image plane from the surface*/
+    vector<ArrayXd> m_images;  /**< \brief one image per thread of size 4*m_nx*m_ny*m_nl */
+    Array<int64_t,Dynamic,1> m_outsideCount; /**< \brief per thread count of the rays falling outside the image */
+    int64_t m_droppedCount=0;   /**< \brief count of the rays which could not be deposited in a thread image (updated atomically) */
+};
+
+#endif // DETECTOR_H_INCLUDED
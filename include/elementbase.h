@@ -134,6 +134,19 @@ public:
     typedef Matrix<FloatType,3,3> RotationType;  /**< \brief the type of rotation matrix used for space coordinate transforms */
     typedef Transform<FloatType,3,Affine> IsometryType; /**< \brief the type of isometry matrix used for space coordinate transforms */
 
+    /** \brief the space transforms of an element computed by setFrameTransforms(), and its aligned surface equation,
+     *  which can be saved and restored without realignment */
+    struct AlignmentState
+    {
+        IsometryType exitFrame;         /**< \brief saved m_exitFrame */
+        IsometryType surfaceDirect;     /**< \brief saved m_surfaceDirect */
+        IsometryType surfaceInverse;    /**< \brief saved m_surfaceInverse */
+        VectorType translationFromPrevious; /**< \brief saved m_translationFromPrevious */
+        RotationType frameDirect;       /**< \brief saved m_frameDirect */
+        RotationType frameInverse;      /**< \brief saved m_frameInverse */
+        vector<FloatType> shapeState;   /**< \brief saved aligned surface equation, in the layout of the shape class (see saveShapeState()) */
+    };
+
     ElementBase(bool transparent=true, string name="", ElementBase* previous=NULL); /**< \brief default  constructor (Film) with explicit chaining to previous */
 
     /** \brief virtual destructor
@@ -164,8 +177,37 @@ public:
     */
     virtual int align(double wavelength)=0;
 
-/** \brief  call transmit or reflect according to surface type ray and iterate to the next surface*/
-    virtual void propagate(RayType& ray)=0 ;/**< \param ray the propagated ray */
+    /** \brief Saves the space transforms and the aligned surface equation of the element, which must be aligned
+     * \param[out] state the AlignmentState receiving the transforms
+     */
+    void saveAlignment(AlignmentState& state);
+
+    /** \brief Restores the space transforms and the aligned surface equation saved by saveAlignment() and marks the element as aligned
+     *
+     *  The surface equation is copied back by restoreShapeState(), so that nothing is recomputed
+     * \param state the saved state. It must have been computed with the current parameter values
+     * \param wavelength the wavelength at which the state was computed
+     * \return 0 if OK ; -1 if the saved surface equation does not match the shape of the element
+     */
+    virtual int restoreAlignment(const AlignmentState& state, double wavelength);
+
+    /** \brief Copies the surface equation computed by align() in the computation frame. Reimplemented by the shape classes
+     * \param[out] shapeState receives the equation coefficients; this default implementation, for elements without surface equation, clears it
+     */
+    virtual void saveShapeState(vector<FloatType>& shapeState){shapeState.clear();}
+
+    /** \brief Sets the surface equation in the computation frame from coefficients saved by saveShapeState(). Reimplemented by the shape classes
+     * \param shapeState the saved coefficients
+     * \return 0 if OK ; -1 if the size of shapeState does not match the shape
+     */
+    virtual int restoreShapeState(const vector<FloatType>& shapeState){return shapeState.empty() ? 0 : -1;}
+
+    inline uint64_t getChangeCount(){return m_changeCount;} /**< \brief returns a counter incremented each time a parameter of the element is changed */
+
+/** \brief  call transmit or reflect according to surface type ray and iterate to the next surface
+ * \param ray the propagated ray
+ * \return the number of rays which reached the end of the chain dead. Can exceed 1 when a grating splits the ray into several orders */
+    virtual int propagate(RayType& ray)=0 ;
 
 
 
@@ -291,6 +333,7 @@ public:
             param.flags=it->second.flags;
             it->second=param;
             m_isaligned=false;
+            ++m_changeCount;
 
             return true;
         }
@@ -542,6 +585,7 @@ protected:
 //            " data  address " << result.first->second.paramArray <<std::endl;
 
         m_isaligned=false;  //maybe some changes do not require this
+        ++m_changeCount;
         return result.first;
     }
     /** \brief removes a tagged parameter from the parameter and helpstring lists
@@ -589,6 +633,7 @@ protected: //variables
 
     bool m_transmissive;   /**< \brief  flag defining whether ray propagation should call the surface transmit() or reflect()  function */
     bool m_isaligned;  /**< \brief flag tracking if the surfacee need to be realigned unset when a parameter is changed */
+    uint64_t m_changeCount; /**< \brief counter of the parameter changes, used to check the validity of saved alignment states */
 
 
 };
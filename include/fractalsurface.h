@@ -22,15 +22,22 @@
 #include <vector>
 #include <cstdio>
 #include <fstream>
+#include <mutex>
 
 #include "ctypes.h"  // this includes Eigen and iostream
 
 using Eigen::ArrayXXd, Eigen::Ref, Eigen::VectorXd;
 
+/** \brief returns the lock serializing FFTW plan creation and destruction
+ *
+ *  The FFTW planner is global and not thread safe, so every plan creation or destruction in the library must hold this lock
+ */
+std::mutex& FFTWPlannerMutex();
+
 /** \brief class for generating fractal surfaces
- *  \warning
- *  The gaussian generator uses  \b std::random_device \b as a source of random number.
- *  It might not be available on non Windows system and could be replaced by \b default_random_engine \b
+ *
+ *  The gaussian noise is drawn from a \b std::mt19937_64 \b engine initialized with the \p seed parameter of generate().
+ *  A non zero seed gives a reproducible surface; with seed=0 the engine is seeded once from \b std::random_device \b
  */
 class FractalSurface
 {
@@ -71,8 +78,12 @@ class FractalSurface
          * \param xStep tabulation step in the X direction
          * \param ySize number of surface points to generate in the Y direction
          * \param yStep tabulation step in the Y direction
+         * \param seed seed of the random generator. If 0 (default) the generator is seeded from std::random_device
+         *
+         *  The random map is filtered in Fourier space with real to complex FFTW transforms of the span() padded size.
+         *  FFTW plans are kept in a cache and reused by all subsequent realizations of the same size.
          */
-        ArrayXXd generate(int32_t xSize, double xStep, int32_t ySize, double yStep);
+        ArrayXXd generate(int32_t xSize, double xStep, int32_t ySize, double yStep, uint64_t seed=0);
 
         /** \brief Detrend the given surface array according to a mask
          *
@@ -44,6 +44,16 @@ class Pattern
         *   this is a pure virtual function, implemented by derived classes */
         virtual Surface::VectorType gratingVector(const Surface::VectorType &position,
                                 const Surface::VectorType &normal=Surface::VectorType::UnitZ())=0;
+
+        /** \brief Line density vectors of a block of points in grating coordinates
+         *
+         *  This default implementation calls gratingVector() for each point. Derived classes reimplement it with column-wise
+         *  double precision expressions which the compiler can vectorize
+         * \param[in] positions the 3 x N matrix of the positions where the line density vectors must be computed
+         * \param[in] normals the 3 x N matrix of the unit surface normals at these positions
+         * \param[out] G a 3 x N matrix which receives the line density vectors
+         */
+        virtual void gratingVectors(const Ref<const Matrix3Xd>& positions, const Ref<const Matrix3Xd>& normals, Ref<Matrix3Xd> G);
 };
 
 /** \brief Base class for all gratings
@@ -55,8 +65,26 @@ class Pattern
  *   ----------------- | -------- | --------------
  *   \b order_align | Dimensionless | The alignment order
  *   \b order_use   | Dimensionless | The utilization order (normally same as order_align)
+ *   \b orders      | Dimensionless | Array of the orders propagated together in multi-order mode (empty by default)
  *
  * these parameters belong to the GratingGroup and cannot be optimized (flags set to 1)
+ *
+ *  Multi-order mode
+ *  ----------------
+ *  If the \b orders array is not empty, each incoming ray is split in one child ray per listed order, and all the children are propagated downstream
+ *  in the same pass. The children of a ray are consecutive in the impact vectors of this surface and of all the downstream surfaces,
+ *  and each of them is tagged by its diffraction order (RayType::m_order), which is kept in the impact store and in the exported impact files.
+ *  The impacts of a single order can be extracted after the trace (see Surface::setOrderSelection()), or only this order can be recorded
+ *  with the order criterion of the recording filter (see Surface::setRecordingFilter()). The losses returned by the source count each lost child.
+ *  \n Evanescent orders are propagated as lost rays to keep the ray indexes consistent. The order_use parameter is ignored in this mode.
+ *
+ *  Grating vector map
+ *  ------------------
+ *  For high volume traces, the line density vector can be interpolated from a map, which fits its X and Y components in the surface frame
+ *  with 2D Legendre polynomials over a rectangle of the ruled area (see setGratingMap()). The Z component is deduced from the surface normal,
+ *  since the grating vector is tangent to the surface. The map is built with the lowest degree reaching the requested accuracy,
+ *  and it is rebuilt at alignment only when a shape or pattern parameter has changed. Since the map is expressed in the surface frame,
+ *  positioning changes (theta, distance, phi, ...), as made at each step of an energy scan, keep it valid. Impacts outside the mapped rectangle use the exact pattern.
  */
 class GratingBase :  virtual public Surface, virtual public Pattern
 {
@@ -77,15 +105,94 @@ class GratingBase :  virtual public Surface, virtual public Pattern
         *  \n If transmissive: the alignment axis is not changed */
         int setFrameTransforms(double alWavelength);
 
+        /** \brief computes the half deviation angle theta for which the Cff ratio is satisfied at the given wavelength
+         *
+         *  The computation uses the line density at the grating center
+         * \param Cff The Cff ratio (i.e. output/input sine of grazing angle)
+         * \param wavelength the wavelength (m)
+         * \return the value to give to the theta parameter
+         * \throw ParameterException if the Cff value cannot be reached at this wavelength
+         */
+        double getCffTheta(double Cff, double wavelength);
+
+        /** \brief Defines the grating vector map used for propagation
+         *
+         *  If the grating is aligned, the map is built immediately, otherwise at the next alignment
+         * \param halfLength half length (along X) of the mapped area in the surface frame. If 0, the map is removed and the exact pattern is used
+         * \param halfWidth half width (along Y) of the mapped area in the surface frame
+         * \param tolerance the maximum error on the grating vector, relative to its maximum modulus over the mapped area
+         * \param maxDegree the maximum degree of the fitted polynomials in X and Y
+         * \return the relative error of the map, or 0 if it is not yet built or was removed
+         * \throw ParameterException if the arguments are invalid or the tolerance cannot be reached with maxDegree. The map is then removed
+         */
+        double setGratingMap(double halfLength, double halfWidth, double tolerance, int maxDegree);
+
+        /** \brief Rebuilds the grating vector map if one is defined and it was built with different shape or pattern parameter values. Called by align()
+         * \return 0 if OK; -1 if the map could not be built and OptiXLastError is set
+         */
+        int updateGratingMap();
+
+        /** \brief Restores a saved alignment state (see ElementBase::restoreAlignment()), then reloads the diffraction orders
+         *  from the parameters and rebuilds the grating vector map if the shape or pattern parameters changed since it was built
+         * \param state the saved state
+         * \param wavelength the wavelength at which the state was computed
+         * \return 0 if OK ; -1 if the saved surface equation does not match the shape, or the map cannot be built and OptiXLastError is set
+         */
+        virtual int restoreAlignment(const AlignmentState& state, double wavelength);
+
+        inline double getGratingMapError(){return m_mapValid ? m_mapError : 0;} /**< \brief returns the relative error of the map, or 0 if no map is used */
+
         virtual RayType& transmit(RayType& ray);       /**< \brief Implementation of transmission grating  */
 
         virtual RayType& reflect(RayType& ray);    /**<  \brief Implementation of reflexion grating  */
 
+        /** \brief propagates the ray in the order_use order, or, in multi-order mode, splits the ray in one child per order of the orders
+         *  array and propagates all the children to the next surface
+         *
+         *  In multi-order mode the input ray is left in the state of the last propagated child
+         * \return the number of children lost downstream of the grating
+         */
+        virtual int propagate(RayType& ray);
+
+        inline const vector<int>& getOrders(){return m_orders;} /**< \brief the orders propagated in multi-order mode, or an empty vector in single order mode */
+
 
 
     protected:
         int m_alignmentOrder;/**< \brief order to be used for aligning*/
         int m_useOrder;/**< \brief order to be used for propagation */
+        vector<int> m_orders;/**< \brief orders propagated in multi-order mode (empty in single order mode) */
+
+        void updateOrders(); /**< \brief reads m_alignmentOrder, m_useOrder and m_orders from the order_align, order_use and orders parameters */
+
+        /** \brief transmits the ray in the given diffraction order  \param ray the input ray  \param order the diffraction order \return the diffracted ray */
+        RayType& transmitOrder(RayType& ray, int order);
+        /** \brief reflects the ray in the given diffraction order  \param ray the input ray  \param order the diffraction order \return the diffracted ray */
+        RayType& reflectOrder(RayType& ray, int order);
+
+        /** \brief line density vector used for propagation, taken from the map if it is valid at this position, or computed by gratingVector()
+         * \param position the position in the surface frame
+         * \param normal the unit surface normal in the surface frame
+         * \return the line density vector in the surface frame
+         */
+        VectorType mappedGratingVector(const VectorType& position, const VectorType& normal);
+
+        /** \brief fits the grating vector map on the current surface and pattern, with the lowest degree reaching the tolerance
+         *  \throw ParameterException if the tolerance cannot be reached, or an intercept exception if the mapped area is not on the surface */
+        void buildGratingMap();
+
+        /** \brief collects the values of the ShapeGroup and GratingGroup parameters, on which the grating vectors in the surface frame depend
+         * \return the values in parameter name order; array parameters contribute their dimensions followed by their elements */
+        vector<double> mapParameterValues();
+
+        double m_mapHalfLength;  /**< \brief half length of the mapped area (0 if no map is defined) */
+        double m_mapHalfWidth;   /**< \brief half width of the mapped area */
+        double m_mapTolerance;   /**< \brief requested relative accuracy of the map */
+        int m_mapMaxDegree;      /**< \brief maximum degree of the map polynomials */
+        bool m_mapValid;         /**< \brief true if the map was built and can be used */
+        double m_mapError;       /**< \brief relative error of the map */
+        vector<double> m_mapParameters; /**< \brief values of the shape and pattern parameters when the map was built (see mapParameterValues()) */
+        MatrixXd m_mapGx, m_mapGy; /**< \brief Legendre coefficients of the X and Y components of the grating vector */
         IsometryType psiTransform;/**< \brief transform from surface space to propagation space
             *   this transform combines the psi rotation around the surface Z axis and the axis permutation between surface and propagation space representations */
     private:
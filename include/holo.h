@@ -85,6 +85,16 @@ class Holo :   virtual public Surface, virtual public Pattern
         virtual Surface::VectorType gratingVector(const Surface::VectorType &position, const
                                 Surface::VectorType &normal);
 
+#ifdef HOLO_EULERIAN
+        /** \brief computes the line density vectors of a block of points, in double precision with column-wise expressions
+         *
+         * \param[in] positions the 3 x N matrix of the positions in the surface frame
+         * \param[in] normals the 3 x N matrix of the unit surface normals at these positions
+         * \param[out] G a 3 x N matrix which receives the line density vectors
+         */
+        virtual void gratingVectors(const Ref<const Matrix3Xd>& positions, const Ref<const Matrix3Xd>& normals, Ref<Matrix3Xd> G);
+#endif // HOLO_EULERIAN
+
         /** \brief Computes the orientation and curvature of the grating central line and a third order polynomial approximation
          *  of the line density function along the meridional axis (X)
          *
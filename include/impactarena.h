@@ -0,0 +1,112 @@
+#ifndef IMPACTARENA_H_INCLUDED
+#define IMPACTARENA_H_INCLUDED
+
+////////////////////////////////////////////////////////////////////////////////
+/**
+*      \file           impactarena.h
+*
+*      \brief         ImpactArena class and ArenaAllocator template: single block allocation of the impact vectors of an element chain
+*
+*      \author         François Polack <francois.polack@synchroton-soleil.fr>
+*      \date        2024-10-24  Creation
+*      \date         Last update
+*
+
+*/
+///////////////////////////////////////////////////////////////////////////////////
+//
+//             REVISIONS
+//
+////////////////////////////////////////////////////////////////////////////////////
+
+#include "types.h"
+#include <vector>
+#include <memory>
+
+using namespace std;
+
+/** \brief A memory block shared by the impact vectors of an element chain
+ *
+ *  The block is allocated once, aligned on a cache line boundary (or on a 2 MB boundary when huge pages are requested), and freed
+ *  when the last ArenaSlice referring to it is destroyed.
+ */
+class ImpactArena
+{
+public:
+    /** \brief allocates the memory block
+     * \param size size of the block in bytes
+     * \param hugePages if true the block is aligned on 2 MB and, on Linux, the kernel is advised to back it with transparent huge pages
+     * \throw std::bad_alloc if the allocation fails
+     */
+    ImpactArena(size_t size, bool hugePages=false);
+    ~ImpactArena(); /**< \brief frees the memory block */
+    inline char* data(){return m_block;}    /**< \brief returns the address of the block */
+    inline size_t size(){return m_size;}    /**< \brief returns the size of the block in bytes */
+private:
+    ImpactArena(const ImpactArena&)=delete;
+    ImpactArena& operator=(const ImpactArena&)=delete;
+    char* m_block;
+    size_t m_size;
+};
+
+/** \brief a part of an ImpactArena reserved for the impact vector of one surface */
+struct ArenaSlice
+{
+    shared_ptr<ImpactArena> arena;  /**< \brief the arena holding the slice. Keeps the arena alive as long as the slice exists */
+    char* begin=NULL;               /**< \brief start address of the slice */
+    size_t capacity=0;              /**< \brief size of the slice in bytes */
+    bool inUse=false;               /**< \brief true when the slice is the current storage of a vector */
+};
+
+/** \brief Allocator serving the storage of a vector from an ArenaSlice
+ *
+ *  The first allocation which fits in the slice receives the slice; other allocations, or allocations exceeding the slice capacity,
+ *  fall back to the standard allocator. Hence a vector growing beyond its slice keeps working, at the cost of a reallocation.
+ *  \n Copies of a vector do not inherit the slice (see select_on_container_copy_construction()).
+ */
+template<class T>
+class ArenaAllocator
+{
+public:
+    typedef T value_type;
+    typedef std::true_type propagate_on_container_move_assignment;
+    typedef std::true_type propagate_on_container_swap;
+
+    ArenaAllocator(){}  /**< \brief default constructor; allocates from the heap */
+    explicit ArenaAllocator(shared_ptr<ArenaSlice> slice):m_slice(slice){} /**< \brief constructor from an arena slice */
+    template<class U> ArenaAllocator(const ArenaAllocator<U>& other):m_slice(other.m_slice){}   /**< \brief rebinding constructor */
+
+    /** \brief allocate storage for n objects, from the slice if it is free and large enough */
+    T* allocate(size_t n)
+    {
+        if(m_slice && !m_slice->inUse && n*sizeof(T) <= m_slice->capacity)
+        {
+            m_slice->inUse=true;
+            return reinterpret_cast<T*>(m_slice->begin);
+        }
+        return std::allocator<T>().allocate(n);
+    }
+
+    /** \brief release a storage; the slice is kept for a later allocation */
+    void deallocate(T* p, size_t n)
+    {
+        if(m_slice && reinterpret_cast<char*>(p)==m_slice->begin)
+            m_slice->inUse=false;
+        else
+            std::allocator<T>().deallocate(p, n);
+    }
+
+    /** \brief copied containers allocate from the heap, so that the slice is never shared by two vectors */
+    ArenaAllocator select_on_container_copy_construction() const {return ArenaAllocator();}
+
+    shared_ptr<ArenaSlice> m_slice; /**< \brief the slice used by this allocator, or NULL */
+};
+
+template<class T, class U>
+inline bool operator==(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b){return a.m_slice==b.m_slice;}   /**< \brief allocators are equal if they share the same slice */
+template<class T, class U>
+inline bool operator!=(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b){return a.m_slice!=b.m_slice;}   /**< \brief allocators are different if they don't share the same slice */
+
+typedef vector<RayType, ArenaAllocator<RayType> > ImpactVector;  /**< \brief the type of the impact vectors of the surfaces */
+
+#endif // IMPACTARENA_H_INCLUDED
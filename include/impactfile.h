@@ -0,0 +1,106 @@
+#ifndef IMPACTFILE_H_INCLUDED
+#define IMPACTFILE_H_INCLUDED
+
+////////////////////////////////////////////////////////////////////////////////
+/**
+*      \file           impactfile.h
+*
+*      \brief         Columnar binary export of the recorded impacts and memory mapped reading of the exported files
+*
+*      \author         François Polack <francois.polack@synchroton-soleil.fr>
+*      \date        2024-10-25  Creation
+*      \date         Last update
+*
+
+*/
+///////////////////////////////////////////////////////////////////////////////////
+//
+//             REVISIONS
+//
+////////////////////////////////////////////////////////////////////////////////////
+
+#include "types.h"
+#include <string>
+
+using std::string;
+
+class Surface;
+
+/** \brief Writes the impacts recorded by a surface to a columnar binary file
+ *
+ *  The file layout is described in ImpactFileHeader. All the recorded impacts, including the lost rays, are written
+ *  with their alive flag and diffraction order. The rays are converted by blocks in parallel, then each block of each column is written in a single call.
+ * \param surface the recording surface
+ * \param filename name or path of the file. If the file exists, it is overwritten
+ * \param frame the frame in which positions and directions are expressed
+ * \param fields a combination of \ref ImpactField flags selecting the columns to write
+ * \param precision Float32Precision or Float64Precision. LongDoublePrecision is written as Float64Precision
+ * \throw std::runtime_error if the file cannot be written
+ */
+void WriteImpactFile(Surface& surface, string filename, FrameID frame, uint32_t fields, ImpactPrecision precision);
+
+#ifdef HAS_HIGH5
+/** \brief Writes the impacts recorded by a surface to an HDF5 file
+ *
+ *  The columns are written as one dimensional datasets of the group "/impacts", named after the \ref ImpactColumn enum without the "Column" prefix
+ *  (X, Y, Z, Distance, DX, ..., Alive, Order). The frame, fields and element name are stored as attributes of the group.
+ * \param surface the recording surface
+ * \param filename name or path of the file. If the file exists, it is overwritten
+ * \param frame the frame in which positions and directions are expressed
+ * \param fields a combination of \ref ImpactField flags selecting the datasets to write
+ * \param precision Float32Precision or Float64Precision. LongDoublePrecision is written as Float64Precision
+ * \throw HighFive::Exception if the file cannot be written
+ */
+void WriteImpactHdf5(Surface& surface, string filename, FrameID frame, uint32_t fields, ImpactPrecision precision);
+#endif // HAS_HIGH5
+
+/** \brief Read-only memory mapping of an impact file written by WriteImpactFile()
+ *
+ *  The columns are accessed in place in the mapped file, without parsing or copying.
+ */
+class ImpactFileMap
+{
+public:
+    /** \brief maps the file and checks its header
+     * \param filename name or path of the file
+     * \throw std::runtime_error if the file cannot be mapped or is not a valid impact file
+     */
+    ImpactFileMap(string filename);
+    ~ImpactFileMap();   /**< \brief unmaps the file */
+
+    inline const ImpactFileHeader& header() const {return *m_header;}  /**< \brief returns the file header */
+    inline size_t size() const {return m_header->numRays;}  /**< \brief returns the number of impacts in the file */
+
+    /** \brief returns the address of a column in the mapped file
+     * \param columnID a value of the \ref ImpactColumn enum
+     * \return the address of the first value of the column, or NULL if the column is not stored in the file
+     */
+    const void* column(int columnID) const;
+
+    /** \brief rebuilds a ray from the file data
+     *
+     *  The fields not stored in the file receive the default values used by ImpactStore
+     * \param index index of the impact in the file
+     * \return the ray, in the frame recorded in the header
+     */
+    RayType getRay(size_t index) const;
+
+private:
+    ImpactFileMap(const ImpactFileMap&)=delete;
+    ImpactFileMap& operator=(const ImpactFileMap&)=delete;
+    template<typename Scalar> RayType readRay(size_t index) const;
+    void unmap();
+
+    const char* m_data=NULL;    /**< \brief start of the mapped file */
+    size_t m_length=0;          /**< \brief size of the mapped file */
+    const ImpactFileHeader* m_header=NULL;
+    const void* m_columns[ColumnOrder+1];  /**< \brief column addresses indexed by \ref ImpactColumn, NULL when not stored */
+#ifdef _WIN32
+    void* m_fileHandle=NULL;
+    void* m_mappingHandle=NULL;
+#else
+    int m_fd=-1;
+#endif
+};
+
+#endif // IMPACTFILE_H_INCLUDED
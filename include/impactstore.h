@@ -0,0 +1,86 @@
+#ifndef IMPACTSTORE_H_INCLUDED
+#define IMPACTSTORE_H_INCLUDED
+
+////////////////////////////////////////////////////////////////////////////////
+/**
+*      \file           impactstore.h
+*
+*      \brief         ImpactStore class declaration: compact columnar storage of the ray impacts recorded by a surface
+*
+*      \author         François Polack <francois.polack@synchroton-soleil.fr>
+*      \date        2024-10-23  Creation
+*      \date         Last update
+*
+
+*/
+///////////////////////////////////////////////////////////////////////////////////
+//
+//             REVISIONS
+//
+////////////////////////////////////////////////////////////////////////////////////
+
+#include "types.h"
+#include <vector>
+
+using namespace std;
+
+/** \brief Compact storage of ray impacts
+ *
+ *  Only the ray data selected by a combination of \ref ImpactField flags are kept, in a given floating point precision.
+ *  Each scalar component is stored in its own column, so that a spot diagram (position, direction and intensity) in float precision
+ *  uses 35 bytes per ray: 8 columns of 4 bytes, the 1 byte alive flag and the 2 byte diffraction order, instead of the size of a full RayType.
+ *  \n The rays read back from the store have default values for the fields which were not stored:
+ *  null position, direction along Z, null wavelength, unit S amplitude and null P amplitude.
+ *  A ray stored with ImpactIntensity only gets a real S amplitude equal to the square root of the intensity.
+ *  \n The alive flag and the diffraction order (RayType::m_order) are always stored, so that the impacts of a multi-order trace can be separated.
+ */
+class ImpactStore
+{
+public:
+    /** \brief column identifiers of the stored scalar components, in the order of the \ref ImpactColumn enum */
+    enum Column{ColX, ColY, ColZ, ColDistance, ColDX, ColDY, ColDZ, ColWavelength, ColIntensity,
+                ColReS, ColImS, ColReP, ColImP, ColSX, ColSY, ColSZ, NumColumns};
+
+    ImpactStore(){setFormat(0, LongDoublePrecision);} /**< \brief default constructor. The store is inactive */
+
+    /** \brief selects the stored fields and the precision. Stored impacts are cleared
+     * \param fields a combination of \ref ImpactField flags. If 0 the store is inactive
+     * \param precision the storage precision
+     */
+    void setFormat(uint32_t fields, ImpactPrecision precision);
+    inline uint32_t getFields(){return m_fields;}   /**< \brief returns the stored fields */
+    inline ImpactPrecision getPrecision(){return m_precision;}  /**< \brief returns the storage precision */
+    inline bool isActive(){return m_fields!=0;} /**< \brief returns true if a format was set */
+
+    /** \brief appends the selected fields of a ray at the end of the store */
+    void push_back(RayType& ray);
+
+    /** \brief rebuilds a ray from the stored data
+     * \param index index of the impact in the store
+     * \return a ray with the stored fields and default values for the other ones
+     */
+    RayType getRay(size_t index) const;
+
+    inline bool isAlive(size_t index) const {return m_alive[index];}  /**< \brief returns the alive flag of a stored impact */
+    inline int getOrder(size_t index) const {return m_orders[index];}  /**< \brief returns the diffraction order of a stored impact */
+    inline size_t size() const {return m_alive.size();}    /**< \brief returns the number of stored impacts */
+    void clear();   /**< \brief removes all impacts without changing the format */
+    void insert(const ImpactStore& other);  /**< \brief appends the impacts of another store, which must have the same format */
+    void reserve(size_t n); /**< \brief reserves storage space for n impacts */
+    size_t bytesPerImpact() const; /**< \brief returns the memory used by one impact */
+
+private:
+    template<typename Scalar> void append(vector<Scalar>* columns, RayType& ray);
+    template<typename Scalar> RayType read(const vector<Scalar>* columns, size_t index) const;
+
+    uint32_t m_fields;  /**< \brief the combination of \ref ImpactField flags defining the stored data*/
+    ImpactPrecision m_precision;    /**< \brief the storage precision */
+    bool m_activeColumn[NumColumns];    /**< \brief flags the columns in use according to m_fields*/
+    vector<char> m_alive;   /**< \brief the alive flags of the impacts */
+    vector<int16_t> m_orders;   /**< \brief the diffraction orders of the impacts */
+    vector<float> m_floatColumns[NumColumns];   /**< \brief the columns used in Float32Precision */
+    vector<double> m_doubleColumns[NumColumns]; /**< \brief the columns used in Float64Precision */
+    vector<FloatType> m_longColumns[NumColumns];    /**< \brief the columns used in LongDoublePrecision */
+};
+
+#endif // IMPACTSTORE_H_INCLUDED
@@ -211,6 +211,38 @@ extern "C"
      */
     DLL_EXPORT bool AlignGrating4Cff(size_t elementID, double Cff, double wavelength);
 
+    /** \brief Precomputes the alignment of an element chain at each wavelength of an energy scan
+     *
+     *  The alignments are computed on a copy of the chain, which is not modified. Each scan step is then aligned by ApplyAlignmentCache(),
+     *  which restores the cached space transforms instead of realigning the whole chain.
+     *  \n The cache becomes invalid if a parameter or a link of the chain elements is changed, except by ApplyAlignmentCache() itself.
+     * \param elementID first element of the chain to align
+     * \param numWavelengths number of wavelengths of the scan
+     * \param wavelengths array of the numWavelengths alignment wavelengths (m)
+     * \param gratingID if not 0, the ID of a grating of the chain which theta angle is set at each wavelength as by AlignGrating4Cff()
+     * \param Cff the Cff ratio to maintain if gratingID is not 0
+     * \param[out] cacheHandle address of a location which receives the handle of the cache. It must be released by ReleaseAlignmentCache()
+     * \return true if the cache was created ; false otherwise and OptiXLastError is set
+     */
+    DLL_EXPORT bool CreateAlignmentCache(size_t elementID, int32_t numWavelengths, const double* wavelengths, size_t gratingID, double Cff,
+                                         size_t* cacheHandle);
+
+    /** \brief Aligns the element chain of an alignment cache as computed at one of its wavelengths
+     *
+     *  If the cache was created with a grating, the theta parameter of this grating is updated
+     * \param cacheHandle a handle returned by CreateAlignmentCache()
+     * \param index the index of the wavelength in the array given to CreateAlignmentCache()
+     * \return true if the chain was aligned ; false if the handle or index is invalid, or if the chain was modified since the cache was created, and OptiXLastError is set
+     */
+    DLL_EXPORT bool ApplyAlignmentCache(size_t cacheHandle, int32_t index);
+
+    /** \brief Releases an alignment cache created by CreateAlignmentCache()
+     *
+     * \param cacheHandle the handle of the cache to release
+     * \return true if the cache was released ; false if the handle is invalid
+     */
+    DLL_EXPORT bool ReleaseAlignmentCache(size_t cacheHandle);
+
     /** \brief Chain two elements by their IDs
      *
      *  Links to element together. The upstream link of previous and downstream link of next will remain unchanged
@@ -277,6 +309,49 @@ extern "C"
      */
     DLL_EXPORT bool DiagramToFile(const char* filename, C_DiagramStruct* cdiagram);
 
+    /** \brief Write the impacts recorded by an element to a columnar binary file, or to an HDF5 file
+     *
+     *  All the recorded impacts are written, with their alive flag and diffraction order. The binary layout is described in ImpactFileHeader:
+     *  each selected field is written as contiguous, 64 byte aligned columns of float or double, so that the file can be memory mapped
+     *  by OpenImpactFile or by numpy.memmap without conversion.
+     *  \n The HDF5 format is only available if the library was compiled with HAS_HIGH5.
+     * \param elementID the Id of a recording element
+     * \param filename name of the file. If the file exists, it is overwritten
+     * \param frame the frame in which positions and directions are expressed
+     * \param fields a combination of \ref ImpactField flags selecting the written data
+     * \param precision Float32Precision or Float64Precision. LongDoublePrecision is written in double precision
+     * \param hdf5 if true the impacts are written in HDF5 format, in the group "/impacts"
+     * \return true if the file was written; false otherwise and OptiXLastError is set
+     */
+    DLL_EXPORT bool ExportImpacts(size_t elementID, const char* filename, enum FrameID frame, uint32_t fields, enum ImpactPrecision precision, bool hdf5);
+
+    /** \brief Memory map an impact file written by ExportImpacts in binary format
+     *
+     *  The file is mapped read-only; its columns are accessed in place with GetImpactFileColumn. The mapping must be released with CloseImpactFile
+     * \param filename name of the file
+     * \param[out] handle the address of a size_t which will receive the handle of the mapped file
+     * \param[out] header if not NULL, the address of an ImpactFileHeader which will receive a copy of the file header
+     * \return true if the file was mapped; false if it is not a valid impact file and OptiXLastError is set
+     */
+    DLL_EXPORT bool OpenImpactFile(const char* filename, size_t* handle, ImpactFileHeader* header);
+
+    /** \brief Get the address of a column in a mapped impact file
+     *
+     * \param handle the handle returned by OpenImpactFile
+     * \param column a value of the \ref ImpactColumn enum
+     * \param[out] data the address of a pointer which will receive the address of the column. Scalar columns contain header.numRays float or double
+     *      according to the header precision, the alive column numRays bytes and the order column numRays int16. The pointer is valid until CloseImpactFile is called
+     * \return true if the column is stored in the file; false otherwise and OptiXLastError is set
+     */
+    DLL_EXPORT bool GetImpactFileColumn(size_t handle, enum ImpactColumn column, const void** data);
+
+    /** \brief Unmap an impact file mapped by OpenImpactFile
+     *
+     * \param handle the handle of the mapped file
+     * \return true if the handle was valid; false otherwise and OptiXLastError is set
+     */
+    DLL_EXPORT bool CloseImpactFile(size_t handle);
+
     DLL_EXPORT void DumpArgParameter(Parameter* param); /**< debugging function */
 
     /** \brief dump and compare given parameter with stored data
@@ -312,6 +387,29 @@ extern "C"
     DLL_EXPORT bool EmulateUndulator(size_t elementID, double sigmaX, double sigmaY, double sigmaprimX, double sigmaprimY,
                                      double undulatorLength,  double SD_UndulatorDistance, double wavelength, double detuning);
 
+    /** \brief Sets the ray file of a Source<File> element
+     *
+     *  The file must have been written by ExportImpacts in binary format, or by another program following the ImpactFileHeader layout.
+     *  It is memory mapped and its rays are read by chunks at each Radiate call, without being stored in the source.
+     * \param elementID the ID of a Source<File> element
+     * \param filename name of the ray file
+     * \return true if the file was mapped; false otherwise and OptiXLastError is set
+     */
+    DLL_EXPORT bool SetSourceFile(size_t elementID, const char* filename);
+
+    /** \brief Sets the phase space density of a Source<PhaseSpace> element
+     *
+     *  The density is tabulated on a regular grid of (X, Y, X', Y') or of (X, Y, X', Y', E), E being the photon energy in eV.
+     *  Generated rays are drawn from the cells in proportion of their density by the alias method, and placed uniformly inside the cell.
+     * \param elementID the ID of a Source<PhaseSpace> element
+     * \param numDims the number of dimensions of the table, 4 or 5
+     * \param dims an array of numDims cell counts, in order X, Y, X', Y' [, E]
+     * \param bounds an array of 2*numDims values giving the lower and upper bound of each dimension in the same order. Distances in m, angles in rad, energy in eV
+     * \param density the array of the cell densities, X varying the fastest. The values need not be normalized
+     * \return true if the table is valid; false otherwise and OptiXLastError is set
+     */
+    DLL_EXPORT bool SetPhaseSpaceTable(size_t elementID, int32_t numDims, const int64_t* dims, const double* bounds, const double* density);
+
     /** \brief enumerates the element list of the current system
      *
      * \param[in,out] pHandle address of a location containing: \n on input, a handle to the current enumerator or 0 to get the first element of the system;
@@ -504,6 +602,31 @@ extern "C"
      */
     DLL_EXPORT bool GetArrayParameter(size_t elementID, const char* paramTag, Parameter* paramData, size_t maxsize);
 
+    /** \brief Computes the distance of the best focus from the moments of the impacts recorded on a surface
+     *
+     *  The RMS spot size as a function of the drift distance is a quadratic function whose coefficients depend on the first and second moments
+     *  of the ray positions and directions. The best focus is thus obtained in one pass over the impacts, without scanning the distance.
+     * \param elementID The ID of the surface. Impact recording must be active on this surface
+     * \param focus the address of a BestFocus structure which will receive the X, Y and combined waist positions and sizes
+     * \param intensityWeighted if true, the moments are weighted by the ray intensities
+     * \return true if successful; false, in case of an error and OptiX  LastError is set
+     */
+    DLL_EXPORT bool GetBestFocus(size_t elementID, BestFocus* focus, bool intensityWeighted);
+
+    /** \brief Returns the pixel image accumulated by a Detector element since the last ClearImpacts call
+     *
+     * \param elementID The ID of the detector element
+     * \param image C_ndArray* Address of a C_ndArray struct which must be initialized in order to receive a double table of size pixels_X*pixels_Y*lambda_bins*4
+     *      \n the ndims attribute will be set to 4 and the first 4 size_t elements of storage will be filled by the dimensions values {pixels_X, pixels_Y, lambda_bins, 4}
+     *      immediately followed by the image data. The 4 planes of the last dimension are the Stokes parameters S0 to S3 (see DetectorBase::getImage())
+     *      \n the total memory size of the image.storage area must be larger than (pixels_X*pixels_Y*lambda_bins*4+4)*8 bytes and documented in the allocatedStorage attribute \see note in C_ndArray
+     * \param outsideCount if not NULL, will receive the number of alive rays which fell outside the image
+     * \param droppedCount if not NULL, will receive the number of alive rays which could not be deposited in the image
+     *      (invalid image geometry, or thread count increased without a ClearImpacts call). Their intensity is missing from the image
+     * \return true if successful; false, in case of an error and OptiX  LastError is set
+     */
+    DLL_EXPORT bool GetDetectorImage(size_t elementID, C_ndArray * image, int64_t * outsideCount, int64_t * droppedCount);
+
 
     /** \brief retrieves the name of an element from its ID
      *
@@ -548,6 +671,21 @@ extern "C"
      */
     DLL_EXPORT bool GetHologramPatternInfo(size_t elementID,  GratingPatternInfo *gratInfo, double halfLength, double halfWidth );
 
+    /** \brief defines the map of the grating vector used to propagate the rays on a grating
+     *
+     *  The X and Y components of the line density vector are fitted with 2D Legendre polynomials over a rectangle of the grating surface,
+     *  with the lowest degree reaching the tolerance. In high volume traces the map is evaluated instead of the exact pattern.
+     *  If the grating is not aligned, the map is built at the next alignment. It is rebuilt at alignment whenever a parameter of the grating has changed.
+     * \param elementID ID of the element which must be a grating
+     * \param halfLength the 1/2 length (X) of the mapped area. If 0 the map is removed
+     * \param halfWidth the 1/2 width (Y) of the mapped area
+     * \param tolerance maximum error of the map, relative to the maximum line density over the mapped area
+     * \param maxDegree maximum degree of the fitted polynomials [1, 15]
+     * \param[out] fitError if not NULL, receives the relative error of the map, or 0 if it is not yet built
+     * \return false (and sets OptiXLastError) if elementID is not a grating, or if the map cannot reach the tolerance; otherwise true
+     */
+    DLL_EXPORT bool SetGratingVectorMap(size_t elementID, double halfLength, double halfWidth, double tolerance, int32_t maxDegree, double* fitError);
+
     /** \brief Evaluates the impacts stored in the given element in the chosen reference frame  returns it in a C_DiagramStruct of dimension m_dim >= 6.
      *
      * According to the m_dim value, wavelength and stokes parameter are returned or not. Wavelength is returned before Stokes parameters for compatibility.
@@ -578,6 +716,20 @@ extern "C"
     DLL_EXPORT bool GetFocalDiagram(size_t elementID, const int dims[3], const double zbound[2], int32_t *focdg,
                                     double* xbound, double * ybound);
 
+    /** \brief Get a 3d map of the intensity when the intercepting surface is move along the local Z axis
+     *
+     *  Same as GetFocalDiagram() but each impact is weighted by the ray intensity
+     * \param[in] elementID ID of the element defining the Z=0 position (it should be a plane)
+     * \param[in] dims Number of computed points along x, y and Z axis (in this order)
+     * \param[in] zbound Min and max z position (0 is the surface(elemID) reference position.
+     * \param[out] focdg a double array able to store the complete diagram
+     * \param[out] xbound The limits (xmin, xmax)  of the spot diagram in X
+     * \param[out] ybound The limits (ymin, ymax)  of the spot diagram in Y
+     * \return true if the function succeeds; false if it fails and has set OptiXError
+     */
+    DLL_EXPORT bool GetIntensityFocalDiagram(size_t elementID, const int dims[3], const double zbound[2], double *focdg,
+                                    double* xbound, double * ybound);
+
 
     /** \brief Gets the element immediately downstream of the given one in the link chain
      *    previousID
@@ -668,6 +820,23 @@ extern "C"
       */
     DLL_EXPORT bool GetRecording(size_t elementID, enum RecordMode *recordingMode);
 
+    /** \brief Retrieves the ray fields and precision recorded by an element
+     *
+     * \param[in] elementID the Id of the element to inquire of
+     * \param[out] fields a location to return the recorded fields, as a combination of \ref ImpactField flags
+     * \param[out] precision a location to return the precision of the recorded impacts
+     * \return true if the function succeeds, false otherwise
+     */
+    DLL_EXPORT bool GetRecordingFormat(size_t elementID, uint32_t *fields, enum ImpactPrecision *precision);
+
+    /** \brief Retrieves the filter applied to the impacts recorded by an element
+     *
+     * \param[in] elementID the Id of the element to inquire of
+     * \param[out] filter a RecordingFilter struct to receive the filter definition
+     * \return true if the function succeeds, false otherwise
+     */
+    DLL_EXPORT bool GetRecordingFilter(size_t elementID, RecordingFilter *filter);
+
 
     /** \brief Finds the most upstream source in the element chain starting from the given element
      *
@@ -697,6 +866,17 @@ extern "C"
     DLL_EXPORT bool GetSpotDiagram(size_t elementID, C_DiagramStruct * diagram, double distance);
 
 
+    /** \brief Returns the spot statistics accumulated by a surface since the last ClearImpacts call
+     *
+     *  The surface recording mode must be RecordInputStatistics or RecordOutputStatistics. In these modes the impacts are not stored,
+     *  so that the memory used does not depend on the number of propagated rays.
+     * \param elementID The ID of the surface
+     * \param stats the address of a C_SpotStatistics structure which will receive the statistics
+     * \return a boolean value, true for success, false for failure and OptixLastError is set.
+     */
+    DLL_EXPORT bool GetSpotStatistics(size_t elementID, C_SpotStatistics * stats);
+
+
      /** \brief  return the surface frame orientation and position of the given element in the absolute frame
      *
      *  The function return an array of four vectors of size 3, in the location pointed by frame_vectors.
@@ -818,6 +998,79 @@ extern "C"
     DLL_EXPORT bool RadiateAt(size_t elementID, double wavelength);
 
 
+    /** \brief Propagates the rays generated in a source at several wavelengths, in a single parallel pass
+     *
+     *  Each wavelength is traced on an independent copy of the system, in parallel. The impacts of all wavelengths are appended
+     *  to the recording surfaces in the order of the list, each impact carrying its wavelength, and statistics recording surfaces
+     *  accumulate all the wavelengths. The impacts previously recorded downstream of the source are cleared; the source rays are not modified.
+     * \param sourceID ID of the element which must be of source type. Rays must have been generated
+     * \param numWavelengths number of wavelengths
+     * \param wavelengths array of numWavelengths wavelengths <b> in m </b> (must be >0)
+     * \param weights array of numWavelengths relative intensities of the wavelengths, or NULL for equal intensities.
+     *          The ray amplitudes are multiplied by the square root of the weight
+     * \param alignmentWavelength if >0 the system is aligned once at this wavelength for all the traces; if 0 it is aligned at each wavelength.
+     *          In the latter case the impacts of the wavelengths would not share the same frames, and only statistics recording modes are accepted
+     * \param targetID 0, or the ID of a surface recording impacts or statistics, where the statistics at each wavelength are computed
+     * \param[out] statistics if targetID is not 0, an array of numWavelengths C_SpotStatistics structures receiving the spot statistics of the target at each wavelength
+     * \return true if all rays were propagated without loss; false otherwise and OptiXLastError is set, either to an error or to a warning giving the number of lost rays
+     *  \see RadiateAt, GetSpotStatistics
+     */
+    DLL_EXPORT bool RadiateSpectrum(size_t sourceID, int32_t numWavelengths, const double* wavelengths, const double* weights,
+                                    double alignmentWavelength, size_t targetID, C_SpotStatistics* statistics);
+
+
+    /** \brief Allocates the impact storage of the element chain starting at a source in a single memory block
+     *
+     *  The source and each following surface recording full impacts (RecordInput or RecordOutput mode set by SetRecording) receive
+     *  a slice of numRays impacts in the block. Repeated Generate / Radiate cycles then reuse this memory without reallocation, ClearImpacts keeping the slices.
+     *  \n The recording modes must be set before the call. The allocation must be renewed if the number of generated rays changes,
+     *  an impact vector growing beyond its slice falling back to individual allocation.
+     * \param sourceID ID of the element at the head of the chain, usually a source
+     * \param numRays number of impacts reserved per element
+     * \param hugePages if true the block is aligned on 2 MB and, on Linux, advised to be backed by transparent huge pages
+     * \return true if the allocation succeeded; false otherwise and OptiXLastError is set
+     *  \see ReleaseImpactArena
+     */
+    DLL_EXPORT bool AllocateImpactArena(size_t sourceID, size_t numRays, bool hugePages);
+
+    /** \brief Returns the impact storage of the element chain starting at the given element to individual allocations
+     *
+     *  The recorded impacts are kept. The memory block allocated by AllocateImpactArena is freed.
+     * \param sourceID ID of the element at the head of the chain
+     * \return true if the element is valid; false otherwise and OptiXLastError is set
+     */
+    DLL_EXPORT bool ReleaseImpactArena(size_t sourceID);
+
+
+    /** \brief Runs a Monte Carlo tolerance analysis over parameter deviations and surface errors
+     *
+     *  Each realization is computed in parallel on a copy of the element chain, so that the current system is not modified.
+     *  The toleranced parameters are randomly offset from their current values, new surface errors are generated on the listed surfaces,
+     *  then the copy is aligned, the source generates its rays, they are propagated and the spot statistics are computed on the target surface.
+     * \param sourceID ID of the source element at the head of the chain
+     * \param targetID ID of a recording surface of the chain where the figures of merit are computed
+     * \param wavelength wavelength of alignment and ray generation (must be >0)
+     * \param distance distance from the target surface of the observation plane
+     * \param numParams number of toleranced parameters
+     * \param params array of numParams ToleranceParameter structures
+     * \param numErrorSurfaces number of surfaces where surface errors are generated at each realization
+     * \param errorSurfaceIDs array of numErrorSurfaces element IDs. The surface error generator of these elements must be set
+     * \param random_zernike if true the low order Legendre coefficients of the generated errors are also randomized
+     * \param numRealizations number of realizations to compute
+     * \param[in,out] seed the address of the base seed of the random draws. If *seed is 0 a random seed is drawn and returned here.
+     *          Reusing a returned seed reproduces the same deviations and error maps
+     * \param[out] results an array of numRealizations ToleranceResult structures receiving the figures of merit of each realization
+     * \param[out] meanResult mean values of the figures of merit over the valid realizations; the status member is set to the number of valid realizations
+     * \param[out] sigmaResult standard deviations of the figures of merit over the valid realizations
+     * \return true if at least one realization is valid; false otherwise, or if the arguments are invalid, and the OptiX_last_error is set
+     */
+    DLL_EXPORT bool RunToleranceMonteCarlo(size_t sourceID, size_t targetID, double wavelength, double distance,
+                                           int32_t numParams, const ToleranceParameter* params,
+                                           int32_t numErrorSurfaces, const size_t* errorSurfaceIDs, bool random_zernike,
+                                           int32_t numRealizations, uint64_t* seed, ToleranceResult* results,
+                                           ToleranceResult* meanResult, ToleranceResult* sigmaResult);
+
+
     /** \brief **Deprecated** Save all the elements of the current system to a file
      *
      * \deprecated Use SaveSystemAsXml() instead
@@ -853,6 +1106,45 @@ extern "C"
     DLL_EXPORT bool SetCoating(size_t elementID,const char* coatingTable, const char* coatingName);
 #endif // HAS_REFLEX
 
+    /** \brief Sets the complex reflectance table of a surface, which is applied to the ray amplitudes when reflectivity is enabled
+     *
+     *  The reflectance is tabulated on a regular grid of photon energy and grazing angle, and interpolated bilinearly at the wavelength
+     *  and grazing angle of each ray. It multiplies the S and P amplitudes in the polarization frame of the surface.
+     *  On a transmissive surface the table holds the transmittance. The table is not saved with the system.
+     * \param elementID The Identifier of the optical element
+     * \param energyMin smallest tabulated energy (eV)
+     * \param energyMax largest tabulated energy (eV)
+     * \param numEnergies number of tabulated energies, including first and last (>= 2)
+     * \param logSpacing true if the energies are logarithmically spaced, false if linearly
+     * \param angleMin smallest tabulated grazing angle (rad)
+     * \param angleMax largest tabulated grazing angle (rad)
+     * \param numAngles number of tabulated angles, including first and last (>= 2)
+     * \param rs array of numEnergies*numAngles complex S reflectances, stored as (real, imaginary) pairs, the angle varying the fastest
+     * \param rp array of numEnergies*numAngles complex P reflectances, same layout as rs
+     * \return true if the table was set; false otherwise and OptiXLastError is set
+     * \see ReflectivityEnable()
+     */
+    DLL_EXPORT bool SetReflectanceTable(size_t elementID, double energyMin, double energyMax, int64_t numEnergies, bool logSpacing,
+                                        double angleMin, double angleMax, int64_t numAngles, const double* rs, const double* rp);
+
+    /** \brief Removes the reflectance table of a surface. A reflectance of 1 is then assumed for both polarizations
+     * \param elementID The Identifier of the optical element
+     * \return true if the table was removed or the surface has no table; false otherwise and OptiXLastError is set
+     */
+    DLL_EXPORT bool RemoveReflectanceTable(size_t elementID);
+
+    /** \brief Interpolates the reflectance table of a surface for a set of rays
+     *
+     * \param elementID The Identifier of the optical element
+     * \param numValues the number of values to compute
+     * \param wavelengths array of numValues ray wavelengths (m)
+     * \param angles array of numValues grazing angles (rad)
+     * \param[out] rs array of 2*numValues doubles receiving the complex S reflectances as (real, imaginary) pairs
+     * \param[out] rp array of 2*numValues doubles receiving the complex P reflectances as (real, imaginary) pairs
+     * \return true if the values were computed; false if the element has no reflectance table or an error occurred, and OptiXLastError is set
+     */
+    DLL_EXPORT bool GetReflectance(size_t elementID, int64_t numValues, const double* wavelengths, const double* angles, double* rs, double* rp);
+
 
     /** \brief Modifies an element parameter
      *
@@ -875,6 +1167,42 @@ extern "C"
      */
     DLL_EXPORT bool SetRecording(size_t elementID, enum RecordMode recordingMode);
 
+    /** \brief sets the impact recording mode of an element, together with the recorded ray fields and their precision
+     *
+     *  When only a subset of the ray data is needed, as for spot diagrams, the impacts are stored in a compact columnar format,
+     *  using much less memory than the full rays recorded by SetRecording. The impact extraction functions return default values for the fields which are not recorded.
+     *  Recording ImpactAllFields in LongDoublePrecision is equivalent to SetRecording.
+     *  \n Sources always store their rays in full, and only accept this last combination.
+     * \param elementID the Id of the element to modify
+     * \param recordingMode the  new recording mode which must be a value of the RecordMode enumeration
+     * \param fields a combination of \ref ImpactField flags selecting the recorded data
+     * \param precision the floating point precision of the recorded data
+     * \return true if the element can record and the parameters are valid; false otherwise and OptiXLastError is set
+     */
+    DLL_EXPORT bool SetRecordingFormat(size_t elementID, enum RecordMode recordingMode, uint32_t fields, enum ImpactPrecision precision);
+
+    /** \brief sets the filter applied to the impacts of an element before they are recorded
+     *
+     *  Impacts can be restricted to a rectangular or elliptical region of interest, decimated by a stride or a seeded probability,
+     *  the lost rays can be discarded, and a single diffraction order of a multi-order grating can be selected.
+     *  The filter is applied in all recording modes, including the statistics modes.
+     * \param elementID the Id of the element to modify
+     * \param filter the address of a RecordingFilter struct defining the filter. If NULL, the filtering is removed
+     * \return true if the element can record and the filter is valid; false otherwise and OptiXLastError is set
+     */
+    DLL_EXPORT bool SetRecordingFilter(size_t elementID, RecordingFilter *filter);
+
+    /** \brief restricts the impacts returned by the extraction functions of an element to a single diffraction order
+     *
+     *  All the impacts stay recorded, and the selection can be changed to extract in turn each order propagated by a multi-order grating
+     *  (see GratingBase). The selection applies to spot diagrams, impact data, caustics, wavefronts, PSF, focal diagrams and statistics computed from the impacts.
+     * \param elementID the Id of a recording element
+     * \param active if true only the impacts of the given order are extracted; if false all the impacts are extracted
+     * \param order the diffraction order, of the last grating met by the rays, to extract
+     * \return true if the element is a surface; false otherwise and OptiXLastError is set
+     */
+    DLL_EXPORT bool SetImpactOrderSelection(size_t elementID, bool active, int32_t order);
+
 
    /** \brief Set the transmission or reflexion mode of the element. (only available for gratings)
      *
@@ -1024,6 +1352,21 @@ extern "C"
      */
     DLL_EXPORT bool SurfaceErrorsGetState(bool *activityFlag);
 
+    /** \brief Sets at global level whether the reflectance of the surfaces is applied or not to the ray amplitudes in the ray tracing computation.
+     *
+     * Only the surfaces to which a reflectance table was given are affected \see SetReflectanceTable()
+     * \param activity true if the reflectance is to be applied, false if not.
+     * \return always true
+     */
+    DLL_EXPORT bool ReflectivityEnable(const bool activity);
+
+    /** \brief retrieve the global flag defining whether the reflectance of the surfaces is applied or not in the ray tracing computation.
+     *
+     * \param activityFlag a pointer to a boolean location where the state flag can be returned
+     * \return true if the flag was retrieved, false if the activityFlag pointer is invalid (the OptXerror will be set)
+     */
+    DLL_EXPORT bool ReflectivityGetState(bool *activityFlag);
+
 /** \} */  //end of surferrorAPI group
   //  DLL_EXPORT bool AddElementsFromXml(const char * filename);  la gestion des nom en double doit être testée
 
@@ -0,0 +1,64 @@
+#ifndef LOWDISCREPANCY_H_INCLUDED
+#define LOWDISCREPANCY_H_INCLUDED
+
+////////////////////////////////////////////////////////////////////////////////
+/**
+*      \file           lowdiscrepancy.h
+*
+*      \brief         Quasi Monte Carlo point sets for the sampling of the sources
+*
+*      \author         François Polack <francois.polack@synchroton-soleil.fr>
+*      \date        2024-10-29  Creation
+*      \date         Last update
+*
+
+*/
+///////////////////////////////////////////////////////////////////////////////////
+//
+//             REVISIONS
+//
+////////////////////////////////////////////////////////////////////////////////////
+
+#include "ctypes.h"
+
+/** \brief Generator of randomized low discrepancy points in the unit hypercube
+ *
+ *  The Sobol points are Owen scrambled with the hash based nested uniform scrambling of B. Burley (JCGT 2020), the Halton points are randomized by
+ *  a Cranley-Patterson rotation. Both keep the low discrepancy of the sequence, while making the estimates unbiased.
+ *  The error of a mean value then decreases nearly as 1/N instead of \f$ 1/\sqrt N \f$ for independent draws, so that the statistical estimates
+ *  of a source (RMS spot sizes, PSF) reach the same accuracy with 10 to 100 times less rays than with pseudo-random draws.
+ *  Sobol points are best used in numbers which are powers of 2.
+ *  \n The points are computed independently from their index, and can be generated in parallel.
+ */
+class LowDiscrepancySampler
+{
+public:
+    static const int MaxDimensions=5;   /**< \brief number of dimensions available */
+
+    /** \brief constructor
+     * \param mode SobolSampling or HaltonSampling
+     * \param seed the seed of the randomization. Different seeds give independent randomized point sets
+     */
+    LowDiscrepancySampler(SamplingMode mode, uint64_t seed);
+
+    /** \brief computes a point of the set
+     * \param index index of the point
+     * \param[out] u an array of MaxDimensions values which receives the point coordinates, in the open interval (0,1)
+     */
+    void point(uint64_t index, double u[MaxDimensions]) const;
+
+private:
+    SamplingMode m_mode;
+    uint32_t m_scramble[MaxDimensions+1];   /**< \brief scrambling seeds of the index and of each dimension (Sobol) */
+    double m_shift[MaxDimensions];          /**< \brief random shift of each dimension (Halton) */
+};
+
+/** \brief inverse of the cumulative distribution function of the standard normal law
+ *
+ *  Algorithm AS241 of M. J. Wichura (1988), with a relative accuracy of about 1e-16
+ * \param p a probability in the open interval (0,1)
+ * \return the value x such that \f$ P(X < x) = p \f$ for X normal with zero mean and unit variance
+ */
+double InverseNormalCDF(double p);
+
+#endif // LOWDISCREPANCY_H_INCLUDED
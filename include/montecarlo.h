@@ -0,0 +1,64 @@
+#ifndef MONTECARLO_H_INCLUDED
+#define MONTECARLO_H_INCLUDED
+
+////////////////////////////////////////////////////////////////////////////////
+/**
+*      \file           montecarlo.h
+*
+*      \brief         Monte Carlo tolerancing of an optical system over parameter misalignments and surface errors
+*
+*      \author         François Polack <francois.polack@synchroton-soleil.fr>
+*      \date        2024-10-18  Creation
+*      \date         Last update
+*
+
+*/
+///////////////////////////////////////////////////////////////////////////////////
+//
+//             REVISIONS
+//
+////////////////////////////////////////////////////////////////////////////////////
+
+#include "sourcebase.h"
+#include <vector>
+
+/** \brief Computes the figures of merit of the impacts recorded on a surface
+ *  \ingroup GlobalCpp
+ *
+ * \param surface the surface where impacts were recorded
+ * \param distance the distance from the surface, along the chief ray, of the observation plane
+ * \param[out] result the structure which will receive the spot statistics in the AlignedLocalFrame of the surface
+ */
+void GetToleranceFigures(Surface* surface, double distance, ToleranceResult& result);
+
+/** \brief Runs a Monte Carlo tolerance analysis of an optical system
+ *  \ingroup GlobalCpp
+ *
+ *  Each realization is computed on an independent copy of the element chain (see DuplicateChain()). The selected parameters of the copy
+ *  are randomly offset from their nominal values, new surface errors are generated on the selected surfaces, then the system is aligned,
+ *  rays are generated and radiated, and the spot statistics at the target surface are returned as figures of merit.
+ *  Realizations are distributed over the available OpenMP threads.
+ *
+ *  Each realization uses its own random generator seeded from (seed, realization index), so that a given seed reproduces the same
+ *  misalignments and error maps whatever the number of threads. The ray sampling of the source is not part of the seeded draw.
+ * \param source the source element at the head of the chain
+ * \param target the surface where the figures of merit are computed. It must record impacts
+ * \param wavelength the wavelength of alignment and ray generation
+ * \param distance distance from the target surface of the observation plane
+ * \param parameters the list of toleranced parameters. Element IDs must be elements of the source chain
+ * \param errorSurfaces the list of surfaces of the chain where surface errors are generated at each realization. The error generator of these surfaces must be set
+ * \param randomLegendre if true the low order Legendre coefficients of the error maps are also randomized (see Surface::generateSurfaceErrors())
+ * \param numRealizations the number of realizations
+ * \param seed the base seed of the random draws. If 0 a seed is drawn from std::random_device. The effectively used seed is returned
+ * \param[out] results an array of numRealizations ToleranceResult structures receiving the figures of merit of each realization
+ * \param[out] mean the mean values over the valid realizations. Its status member is set to the number of valid realizations
+ * \param[out] sigma the standard deviation over the valid realizations
+ * \return the number of valid realizations. Failed realizations have a status of -1 and the OptiX error reports the first failure
+ * \throw ParameterException if a toleranced parameter or an error surface is invalid
+ */
+int ToleranceMonteCarlo(SourceBase* source, Surface* target, double wavelength, double distance,
+                        const std::vector<ToleranceParameter>& parameters, const std::vector<Surface*>& errorSurfaces,
+                        bool randomLegendre, int numRealizations, uint64_t& seed,
+                        ToleranceResult* results, ToleranceResult& mean, ToleranceResult& sigma);
+
+#endif // MONTECARLO_H_INCLUDED
@@ -34,6 +34,7 @@
 #include "legendrepolynomial.h"
 #include "polynomialsurface.h"
 #include "cone.h"
+#include "detector.h"
 
 #ifdef HAS_REFLEX
   #include "Coating.h"
@@ -163,6 +164,54 @@ typedef Film<LegendrePolynomialSurface> LegendrePolynomialFilm; /**< \brief Impl
 
 /** \} */  //end of group
 
+/** \class Detector
+ *  \brief  Detector template class
+ *  \tparam SShape a shape class derived from surface mainly  providing the intercept() function, with  specific definitions of the surface shape
+ *
+ *  Detector implements a transmissive virtual surface (no optical properties) of given shape, which accumulates a pixel image of the intensity
+ *  and Stokes parameters of the rays during propagation (see DetectorBase). By default impacts are not recorded.
+ */
+template<class SShape>
+class Detector: public DetectorBase, public SShape
+{
+public:
+    /** \brief Constructor and default constructor
+     * \param name name of the new element (empty name by default)
+     * \param previous pointer to the previous element (NULL by default)
+     */
+    Detector(string name="" ,Surface * previous=NULL):Surface(true,name, previous){}
+    virtual ~Detector(){}   /**< \brief destructor */
+    virtual inline string  getOptixClass(){return string("Detector<")+SShape::getOptixClass()+">"; }/**< \brief reimplemented from ElementBase
+            * retrieves the class of the template implementation namely Detector<SShape>  */
+
+    /** \brief reimplemented from ElementBase
+     *
+     *  align the element by setting the associated space transforms, then defining the appropriate surface equation of SShape class.
+     *  The image is reset to the geometry defined by the detector parameters
+     * \param wavelength the alignment wavelength
+     * \return int 0 if successful; an error code otherwise
+     */
+    inline int align(double wavelength)
+    {
+        int rcode= SShape::setFrameTransforms(wavelength);  // this call defines the space transforms
+        if(!rcode)
+            rcode=DetectorBase::setImageGeometry();
+        if(!rcode)
+          return SShape::align(wavelength); // this call transforms the surface equation
+        else return rcode;
+    }
+} ;
+
+/** \ingroup elemClasses
+* \{
+*/
+
+typedef Detector<Plane> PlaneDetector;           /**<  \brief Implements a Detector, the Surface of which has a Plane shape */
+typedef Detector<Sphere> SphericalDetector ;     /**<  \brief Implements a Detector, the Surface of which has a Sphere shape */
+typedef Detector<Cylinder> CylindricalDetector;  /**<  \brief Implements a Detector, the Surface of which has a Cylinder shape with generatrix in the Y direction*/
+
+/** \} */  //end of group
+
 /** \class Grating
  *  \brief  Grating template class
  *  \tparam PatternType a class derived from class Pattern providing the grating line density vector at any point of the surface,  together with specific definition parameters
@@ -182,8 +231,10 @@ public:
     {
         int rcode= GratingBase::setFrameTransforms(wavelength);  // this call defines the space transforms and should call PatternType::GratingVector()
         if(rcode==0)
-          return SShape::align(wavelength); // this call transforms the surface equation
-        else return rcode;
+            rcode=SShape::align(wavelength); // this call transforms the surface equation
+        if(rcode==0)
+            rcode=GratingBase::updateGratingMap(); // needs the aligned surface to compute the normals
+        return rcode;
     }
     /** \brief Change the parameter and modifies the SShape or Pattern internal parameters if needed
      *
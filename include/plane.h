@@ -48,6 +48,21 @@ class Plane : virtual public Surface
         }
 //        virtual int align(double wavelength=0)=0;/**< \brief Pure virtual function <b> must be implemented </b> in derived class*/
 
+        /** \brief saves the coefficients of the aligned plane (reimplemented from ElementBase) */
+        virtual inline void saveShapeState(vector<FloatType>& shapeState)
+        {
+            shapeState.assign(m_hyperplane.coeffs().data(), m_hyperplane.coeffs().data()+4);
+        }
+
+        /** \brief restores the coefficients of the aligned plane (reimplemented from ElementBase) */
+        virtual inline int restoreShapeState(const vector<FloatType>& shapeState)
+        {
+            if(shapeState.size()!=4)
+                return -1;
+            m_hyperplane.coeffs()=Map<const Matrix<FloatType,4,1> >(shapeState.data());
+            return 0;
+        }
+
         virtual inline string getOptixClass(){return "Plane";}/**< return the derived class name ie. Plane */
 
         virtual inline string getSurfaceClass(){return "Plane";}/**< \brief return the most derived shape class name of this object */
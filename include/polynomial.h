@@ -136,6 +136,19 @@ using namespace Eigen;
      */
     double fitHeights(Index Nx, Index Ny, const Ref<ArrayX3d>& heightdata);
 
+    /** \brief fits height data sampled on a regular grid by a polynomial of specified order
+     *
+     *  The fit is separable in X and Y and is solved by two 1D projections, without building the full design matrix.
+     *  fitHeights() switches to this function when its input points form a grid.
+     * \param Nx the polynomial order in the X parameter
+     * \param Ny the polynomial order in the Y parameter
+     * \param Xpos the X coordinates of the grid
+     * \param Ypos the Y coordinates of the grid
+     * \param heights the (Xpos.size(), Ypos.size()) array of heights to fit
+     * \return the rms of fit residuals
+     */
+    double fitGridHeights(Index Nx, Index Ny, const Ref<ArrayXd>& Xpos, const Ref<ArrayXd>& Ypos, const Ref<ArrayXXd>& heights);
+
     /** \brief fits the surface whose slopes are given in input by a polynomial of specified order
      *
      *  This function is common to all polynomial types
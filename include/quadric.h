@@ -47,6 +47,21 @@ class Quadric : virtual public Surface
 
 //        virtual int align(double wavelength=0)=0;/**< \brief  align <b> must be implemented </b> in derived class*/
 
+        /** \brief saves the aligned quadric matrix (reimplemented from ElementBase) */
+        virtual inline void saveShapeState(vector<FloatType>& shapeState)
+        {
+            shapeState.assign(m_alignedQuadric.data(), m_alignedQuadric.data()+16);
+        }
+
+        /** \brief restores the aligned quadric matrix (reimplemented from ElementBase) */
+        virtual inline int restoreShapeState(const vector<FloatType>& shapeState)
+        {
+            if(shapeState.size()!=16)
+                return -1;
+            m_alignedQuadric=Map<const RayType::QuadricType>(shapeState.data());
+            return 0;
+        }
+
         virtual inline string getOptixClass(){return "Quadric";}/**< return the derived class name ie. Quadric */
 
         virtual inline string getSurfaceClass(){return "Quadric";}/**< \brief return the most derived shape class name of this object */
@@ -33,7 +33,7 @@ public:
     typedef std::complex<double> ComplexType;
     typedef Matrix<scalar,3,1> VectorType;
 
-    inline Ray():m_vector_S(VectorType::UnitX()), m_wavelength(0), m_amplitude_S(1.), m_amplitude_P(0){}    /**< \brief default constructor */
+    inline Ray():m_vector_S(VectorType::UnitX()), m_wavelength(0), m_amplitude_S(1.), m_amplitude_P(0), m_order(0){}    /**< \brief default constructor */
 
     /** \brief  constructor from a RayBase object of same type and metaparameters
      *
@@ -46,7 +46,7 @@ public:
      */
     Ray(RayBase<scalar>&& base,  double wavelength=0, ComplexType amplitudeS=1., ComplexType amplitudeP=0,
         VectorType Splane_normal=VectorType::UnitY()) :
-        RayBase<scalar>(base), m_wavelength(wavelength), m_amplitude_S(amplitudeS), m_amplitude_P(amplitudeP)
+        RayBase<scalar>(base), m_wavelength(wavelength), m_amplitude_S(amplitudeS), m_amplitude_P(amplitudeP), m_order(0)
         {
             m_vector_S=Splane_normal.cross(this->direction()).normalized();
         }
@@ -54,13 +54,13 @@ public:
     template<typename otherScalar>
     inline Ray(RayBase<otherScalar>&& base, double wavelength=0, ComplexType amplitudeS=1., ComplexType amplitudeP=0):
         //  ;VectorType Splane_normal=VectorType::UnitZ()) :
-        RayBase<scalar>(base), m_wavelength(wavelength), m_amplitude_S(amplitudeS), m_amplitude_P(amplitudeP)/**<  \brief   type conversion constructor with meta parameters    */
+        RayBase<scalar>(base), m_wavelength(wavelength), m_amplitude_S(amplitudeS), m_amplitude_P(amplitudeP), m_order(0)/**<  \brief   type conversion constructor with meta parameters    */
        { } // {m_vector_S=base.direction().cross(Splane_normal).normalized();}
 
     template<typename otherScalar>
     inline Ray(Ray<otherScalar> && ray) :
         RayBase<scalar>(ray),m_vector_S(ray.m_vector_S), m_wavelength(ray.m_wavelength), m_amplitude_S(ray.m_amplitude_S),
-                m_amplitude_P(ray.m_amplitude_P){} /**<  \brief    copy constructor with type conversion */
+                m_amplitude_P(ray.m_amplitude_P), m_order(ray.m_order){} /**<  \brief    copy constructor with type conversion */
 
 
     virtual ~Ray(){}    /**< \brief virtual destructor */
@@ -91,6 +91,7 @@ public:
     ComplexType m_amplitude_S, m_amplitude_P; /**< \brief Complex amplitude of polarization components
                   *   If  amplitudes are set to 0, but ray is alive, the ray is nevertheless propagated to enable wavefront interpolation
                   */
+    int m_order; /**< \brief diffraction order of the last grating met by the ray (0 if none). Not saved in binary streams */
 };
 
 #endif // RAY_H_INCLUDED
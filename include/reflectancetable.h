@@ -0,0 +1,131 @@
+#ifndef REFLECTANCETABLE_H_INCLUDED
+#define REFLECTANCETABLE_H_INCLUDED
+
+////////////////////////////////////////////////////////////////////////////////
+/**
+*      \file           reflectancetable.h
+*
+*      \brief         Tabulated complex reflectance of a surface coating
+*
+*      \author         François Polack <francois.polack@synchroton-soleil.fr>
+*      \date        2024-11-04  Creation
+*      \date         Last update
+*
+
+*/
+///////////////////////////////////////////////////////////////////////////////////
+//
+//             REVISIONS
+//
+////////////////////////////////////////////////////////////////////////////////////
+
+#include "EigenSafeInclude.h"
+#include <complex>
+#include <vector>
+
+using Eigen::ArrayXd, Eigen::ArrayXcd, Eigen::Ref;
+
+/** \brief Complex S and P reflectance of a coating tabulated on a regular grid of photon energy and grazing angle
+ *
+ *  The table is interpolated bilinearly on the real and imaginary parts of the reflectance. The S and P values of the grid nodes
+ *  are interleaved, the angle varying the fastest, so that an interpolation reads 2 pairs of adjacent memory locations.
+ *  \n Values outside the grid are those of the nearest edge of the grid.
+ *  \n A table is not modified after creation, and can be shared by the copies of a surface (see Surface::setReflectanceTable()).
+ */
+class ReflectanceTable
+{
+public:
+    typedef std::complex<double> ComplexType;
+
+    /** \brief constructs the table from the reflectance values of the grid nodes
+     * \param energyMin smallest tabulated photon energy (eV)
+     * \param energyMax largest tabulated photon energy (eV)
+     * \param numEnergies number of tabulated energies, including first and last (>= 2)
+     * \param logSpacing if true the energies are logarithmically spaced, otherwise linearly
+     * \param angleMin smallest tabulated grazing angle (rad)
+     * \param angleMax largest tabulated grazing angle (rad)
+     * \param numAngles number of tabulated angles, including first and last (>= 2)
+     * \param rs array of numEnergies*numAngles complex reflectances in S polarization, the angle varying the fastest
+     * \param rp array of numEnergies*numAngles complex reflectances in P polarization, the angle varying the fastest
+     * \throw ParameterException if the grids are invalid
+     */
+    ReflectanceTable(double energyMin, double energyMax, int64_t numEnergies, bool logSpacing,
+                     double angleMin, double angleMax, int64_t numAngles, const ComplexType* rs, const ComplexType* rp);
+
+    /** \brief interpolates the reflectance of the coating
+     * \param wavelength the ray wavelength (m)
+     * \param grazingAngle the grazing angle of the ray on the surface (rad)
+     * \param[out] rs the complex reflectance in S polarization
+     * \param[out] rp the complex reflectance in P polarization
+     */
+    inline void getReflectance(double wavelength, double grazingAngle, ComplexType& rs, ComplexType& rp) const
+    {
+        double u= m_logSpacing ? (log(hc/wavelength)-m_energyOrigin)*m_energyScale : (hc/wavelength-m_energyOrigin)*m_energyScale;
+        double v=(grazingAngle-m_angleMin)*m_angleScale;
+        int64_t i, j;
+        cellIndex(u, m_numEnergies, i);
+        cellIndex(v, m_numAngles, j);
+        const ComplexType* p=&m_values[2*(i*m_numAngles+j)];
+        const ComplexType* q=p+2*m_numAngles;
+        rs=(1.-u)*((1.-v)*p[0]+v*p[2]) + u*((1.-v)*q[0]+v*q[2]);
+        rp=(1.-u)*((1.-v)*p[1]+v*p[3]) + u*((1.-v)*q[1]+v*q[3]);
+    }
+
+    /** \brief interpolates the reflectance of the coating for a set of rays
+     * \param wavelengths the ray wavelengths (m)
+     * \param grazingAngles the grazing angles of the rays (rad), of same size as wavelengths
+     * \param[out] rs array receiving the S reflectances, of same size as wavelengths
+     * \param[out] rp array receiving the P reflectances, of same size as wavelengths
+     */
+    void getReflectances(const Ref<const ArrayXd>& wavelengths, const Ref<const ArrayXd>& grazingAngles,
+                         Ref<ArrayXcd> rs, Ref<ArrayXcd> rp) const;
+
+    /** \brief retrieves the energy grid
+     * \param[out] energyMin smallest tabulated energy (eV)
+     * \param[out] energyMax largest tabulated energy (eV)
+     * \param[out] numEnergies number of tabulated energies
+     * \param[out] logSpacing true if the energies are logarithmically spaced
+     */
+    void getEnergyRange(double* energyMin, double* energyMax, int64_t* numEnergies, bool* logSpacing) const;
+
+    /** \brief retrieves the angle grid
+     * \param[out] angleMin smallest tabulated grazing angle (rad)
+     * \param[out] angleMax largest tabulated grazing angle (rad)
+     * \param[out] numAngles number of tabulated angles
+     */
+    void getAngleRange(double* angleMin, double* angleMax, int64_t* numAngles) const;
+
+    static constexpr double hc=1.239841984e-6;  /**< \brief photon wavelength (m) times energy (eV) */
+
+private:
+    /** \brief splits a grid coordinate into the index of the lower node of its cell and the fractional position in the cell, clamped to the grid */
+    static inline void cellIndex(double& u, int64_t numNodes, int64_t& index)
+    {
+        if(!(u > 0))    // also catches NaN
+        {
+            index=0;
+            u=0;
+        }
+        else if(u >= numNodes-1)
+        {
+            index=numNodes-2;
+            u=1.;
+        }
+        else
+        {
+            index=int64_t(u);
+            u-=index;
+        }
+    }
+
+    double m_energyMin, m_energyMax;    /**< \brief energy bounds of the grid (eV) */
+    double m_energyOrigin;  /**< \brief energy (or log of energy) of the first grid node */
+    double m_energyScale;   /**< \brief inverse of the energy (or log of energy) step */
+    double m_angleMin, m_angleMax;  /**< \brief grazing angle bounds of the grid (rad) */
+    double m_angleScale;    /**< \brief inverse of the angle step */
+    int64_t m_numEnergies, m_numAngles; /**< \brief grid sizes */
+    bool m_logSpacing;      /**< \brief true if the energies are logarithmically spaced */
+    std::vector<ComplexType> m_values;  /**< \brief the interleaved S and P reflectances of the grid nodes, the angle varying the fastest */
+};
+
+#endif // REFLECTANCETABLE_H_INCLUDED
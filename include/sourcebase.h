@@ -80,26 +80,41 @@ class SourceBase : public virtual Surface
          */
         inline void setWavelength(double wavelength)
         {
-            vector<RayType>::iterator it;
+            ImpactVector::iterator it;
             for(it=m_impacts.begin(); it!= m_impacts.end(); ++it)
                 it->m_wavelength=wavelength;
         }
 
+        /** \brief  multiply the amplitudes of all the generated rays stored in impacts
+         *
+         * \param factor the amplitude factor. The ray intensities are multiplied by its square
+         */
+        inline void scaleAmplitudes(double factor)
+        {
+            ImpactVector::iterator it;
+            for(it=m_impacts.begin(); it!= m_impacts.end(); ++it)
+            {
+                it->m_amplitude_S*=factor;
+                it->m_amplitude_P*=factor;
+            }
+        }
+
         /** \brief propagate all generated rays stored in impacts
+         *
+         *  Sources which do not store their rays in impacts (see FileSource) override this function
+         * \return the number of rays lost in propagation. A ray split by a multi-order grating counts once per lost order
          * \todo This function needs to be parallelized. it would need to create system clones for thread safety
          */
-        inline int radiate()
+        virtual int radiate()
         {
             int losses=0;
             if(m_next==0)
                 return 0;
-            vector<RayType>::iterator it;
+            ImpactVector::iterator it;
             RayType propRay;
             for(it=m_impacts.begin(); it != m_impacts.end(); ++it)
             {
-                m_next->propagate(propRay=*it);   // on propage une cope de *it. La propagation modifie directement le rayon propagé
-                if(! propRay.m_alive)
-                    ++losses;
+                losses+=m_next->propagate(propRay=*it);   // on propage une cope de *it. La propagation modifie directement le rayon propagé
             }
             return losses;
         }
@@ -116,6 +131,16 @@ class SourceBase : public virtual Surface
         virtual void waveRadiate(double wavelength, double Xaperture, double Yaperture, size_t Xsize, size_t Ysize, char polar='S'); // will be specialized for computed source like undulators
 
     protected:
+        /** \brief gets the aperture of the next element, for sampling the emitted rays inside its acceptance
+         *
+         *  Seen from a point of the source plane, the returned corners bound the slopes X/Z and Y/Z of the rays which can reach the clear aperture
+         *  of the next element (see Surface::getApertureCorners()). Sources with an "acceptance" parameter draw their directions inside
+         *  these bounds and give each ray a weight equal to the probability of the drawn interval.
+         * \param[out] corners receives the corners of the 3D box enclosing the clear aperture on the surface, in the source frame
+         * \return true if the next element has an active and bounded aperture; false if the acceptance is not limited
+         * \throw ParameterException if the next element is not aligned, or if its aperture is not entirely downstream of the source
+         */
+        bool getAcceptanceCorners(Matrix<FloatType,3,8> &corners);
 
     private:
 };
@@ -21,6 +21,8 @@
 
 
 #include "sourcebase.h"
+#include "impactfile.h"
+#include <memory>
 
 
 /** \ingroup elemClasses
@@ -90,7 +92,7 @@ public:
 /** \ingroup elemClasses
  *  \brief alias Source<Gaussian> \n Implements an extended source radiating gaussian distributed rays in source size and aperture
  *
- *    The class has five specific parameters belonging to the SourceGroup
+ *    The class has seven specific parameters belonging to the SourceGroup
  *     -----------------------------------------
  *
  *   Name of parameter | UnitType | Description
@@ -100,8 +102,13 @@ public:
  *   \b sigmaY | Distance | RMS source size in Y direction
  *   \b sigmaXdiv | Angle | RMS source divergence in X direction
  *   \b sigmaYdiv | Angle | RMS source divergence in Y direction
+ *   \b sampling | Dimensionless | 0 pseudo-random draws, 1 scrambled Sobol points, 2 randomized Halton points (see \ref LowDiscrepancySampler)
+ *   \b acceptance | Dimensionless | 1 to emit only inside the acceptance of the aperture of the next element, 0 for the full emission
  *  \note
- *  All parameters are defined and stored as doubles. nRays will be rounded to the nearest integer
+ *  All parameters are defined and stored as doubles. nRays, sampling and acceptance will be rounded to the nearest integer
+ *  \n When \b acceptance is set and the next element has an active aperture, the ray directions are drawn only inside the slopes which,
+ *  from the ray origin, reach the box enclosing the aperture (see SourceBase::getAcceptanceCorners()). The amplitudes of each ray are scaled
+ *  by the square root of the probability of these slopes, so that the intensities remain those of the full emission. The system must be aligned before generating.
  *  \warning
  *  The gaussian generator uses  \b std::random_device \b as a source of random number.
  *  It might not be available on non Windows system and could be replaced by \b default_random_engine \b
@@ -127,7 +134,7 @@ public:
  *
  *  The gaussian source has  different positions along the radiation axis according to X and Y directions
  *
- *    The class has five specific parameters belonging to the SourceGroup
+ *    The class has eight specific parameters belonging to the SourceGroup
  *     -----------------------------------------
  *
  *   Name of parameter | UnitType | Description
@@ -139,8 +146,9 @@ public:
  *   \b sigmaYdiv | Angle | RMS source divergence in Y direction
  *   \b waistX | Distance | distance of X waist to the "source plane"
  *   \b waistY | Distance | distance of Y waist to the "source plane"
+ *   \b sampling | Dimensionless | 0 pseudo-random draws, 1 scrambled Sobol points, 2 randomized Halton points (see \ref LowDiscrepancySampler)
  *  \note
- *  All parameters are defined and store as double. nRays will be rounded to the nearest integer
+ *  All parameters are defined and store as double. nRays and sampling will be rounded to the nearest integer
  *  \warning
  *  The gaussian generator uses  \b std::random_device \b as a source of random number.
  *  It might not be available on non Windows system and could be replaced by \b default_random_engine \b
@@ -217,7 +225,7 @@ public:
     virtual ~SecondarySource(){}
     virtual inline string getOptixClass(){return "Source<Secondary>";}   /**< return the derived class name ie. Source<Secondary> */
 
-    inline virtual void propagate(RayType& ray) /**< the propagated ray */
+    inline virtual int propagate(RayType& ray) /**< the propagated ray */
     {
         try{
             transmit(ray); // a secondary source cannot be combined with a mirror' This all will fill the impact vector
@@ -230,6 +238,7 @@ public:
             throw (EigenException(excpt.what()+ " in element " + getName() +"\nre-thrown from",__FILE__, __func__, __LINE__));
         }
         // do not propagate any furtherc
+        return !ray.m_alive;
     }
 
     /** \brief implementation of generate for a SecondarySource calls the generator of the corresponding primary source
@@ -248,7 +257,7 @@ protected:
 
 /** \ingroup elemClasses
  *  \brief alias Source<UniformGaussian> \n this class describes a source with  gaussian spatial and uniform angular distribution
- *    The class has five specific parameters belonging to the SourceGroup
+ *    The class has seven specific parameters belonging to the SourceGroup
  *     -----------------------------------------
  *
  *   Name of parameter | UnitType | Description
@@ -259,9 +268,14 @@ protected:
  *   \b sigmaY | Distance | RMS source size in the Y direction
  *   \b semiXdiv | Angle | 1/2 source divergence in X direction
  *   \b semiXdiv | Angle | 1/2 source divergence in  in Y direction
+ *   \b sampling | Dimensionless | 0 pseudo-random draws, 1 scrambled Sobol points, 2 randomized Halton points (see \ref LowDiscrepancySampler)
+ *   \b acceptance | Dimensionless | 1 to emit only inside the acceptance of the aperture of the next element, 0 for the full emission
  *
  *  \note
- *  All parameters are defined and stored as doubles. nRays will be rounded to the nearest integer
+ *  All parameters are defined and stored as doubles. nRays, sampling and acceptance will be rounded to the nearest integer
+ *  \n When \b acceptance is set and the next element has an active aperture, the ray directions are drawn only inside the slopes which,
+ *  from the ray origin, reach the box enclosing the aperture (see SourceBase::getAcceptanceCorners()). The amplitudes of each ray are scaled
+ *  by the square root of the probability of these slopes, so that the intensities remain those of the full emission. The system must be aligned before generating.
  *  \warning
  *  The gaussian generator uses  \b std::random_device \b as a source of random number.
  *  It might not be available on non Windows system and could be replaced by \b default_random_engine \b
@@ -279,6 +293,119 @@ public:
 
 };
 
+/** \ingroup elemClasses
+ *  \brief alias Source<File> \n a source streaming rays from an impact file written by ExportImpacts (see ImpactFileHeader)
+ *
+ *  The file is memory mapped and the rays are read by chunks in radiate(), so that they are never stored in the impact vector of the source.
+ *  This source can be used to restart the ray tracing from an intermediate plane saved from an upstream segment of a beamline,
+ *  or to propagate rays computed by another program and written in the same format.
+ *  \n The positions and directions read from the file are converted to the local frame of the source, if they were exported in the AlignedLocalFrame
+ *  or in the GeneralFrame. The rays flagged as lost in the file are skipped.
+ *  When the file does not contain the wavelength, the rays receive the wavelength given to generate(); when it does not contain the polarization,
+ *  the amplitudes are defined by the polarization given to generate() and scaled by the square root of the intensity if this one was stored.
+ *    The class has two specific parameters belonging to the SourceGroup
+ *     -----------------------------------------
+ *
+ *   Name of parameter | UnitType | Description
+ *   ----------------- | -------- | --------------
+ *   \b firstRay | Dimensionless | index in the file of the first ray to propagate
+ *   \b nRays | Dimensionless | number of rays to propagate; 0 to propagate the rays up to the end of the file
+ *
+ *  \note The name of the ray file is not a parameter and is not saved with the system. It must be set by setFile()
+ */
+class FileSource: public virtual SourceBase
+{
+public:
+    /** Default constructor */
+    FileSource(string name="" ,Surface * previous=NULL);
+    /** Default destructor */
+    virtual ~FileSource(){}
+    virtual inline string getOptixClass(){return "Source<File>";}   /**< return the derived class name ie. Source<File> */
+
+    /** \brief maps the ray file
+     * \param filename name or path of a binary impact file
+     * \throw std::runtime_error if the file is not a valid impact file
+     * \throw ParameterException if the rays were recorded in the SurfaceFrame
+     */
+    void setFile(string filename);
+    inline string getFile(){return m_filename;} /**< \brief returns the name of the mapped ray file */
+
+    /** \brief implementation of SourceBase::generate for FileSource. No ray is generated; the default wavelength and polarization are recorded
+     *
+     * \param wavelength the wavelength given to the rays if the file has no wavelength column
+     * \param polar the polarization given to the rays if the file has no polarization column
+     * \return the number of rays which will be read from the file by radiate()
+     * \throw ParameterException if no file is mapped or the polarization is invalid
+     */
+    virtual int generate(const double wavelength, const char polar='S');
+
+    /** \brief reads the rays from the file by chunks and propagates them
+     * \return the number of rays lost in propagation
+     */
+    virtual int radiate();
+
+protected:
+    void getRange(size_t& first, size_t& count); /**< \brief computes the range of rays to read from the parameters, clipped to the file size */
+
+    string m_filename;  /**< \brief name of the mapped file */
+    shared_ptr<ImpactFileMap> m_file;   /**< \brief the mapped ray file, shared by the copies of the source */
+    double m_wavelength=0;  /**< \brief the default wavelength */
+    RayType::ComplexType m_amplitudeS=1., m_amplitudeP=0;   /**< \brief the default amplitudes */
+};
+
+/** \ingroup elemClasses
+ *  \brief alias Source<PhaseSpace> \n a source drawing its rays from a tabulated phase space density, for instance the brightness of an undulator
+ *
+ *  The density is tabulated on a regular grid of the 4 dimensional space (X, Y, X', Y'), or of the 5 dimensional space (X, Y, X', Y', E)
+ *  where E is the photon energy in eV (see setTable()). An alias table is built once when the density is set, so that a cell is drawn in constant time;
+ *  the ray is then placed uniformly in the cell. The draws of each ray come from a counter based generator (CounterRNG) indexed by the ray number,
+ *  hence the generation is parallel and, for a non null seed, reproducible.
+ *  \n With a 4 dimensional table the rays receive the wavelength given to generate(), with a 5 dimensional table the wavelength of the photon energy.
+ *    The class has two specific parameters belonging to the SourceGroup
+ *     -----------------------------------------
+ *
+ *   Name of parameter | UnitType | Description
+ *   ----------------- | -------- | --------------
+ *   \b nRays | Dimensionless | number of rays to be generated
+ *   \b seed | Dimensionless | seed of the random generator; 0 to draw a new seed at each generate() call
+ *
+ *  \note The density table is not a parameter and is not saved with the system. It must be set by setTable()
+ */
+class PhaseSpaceSource: public virtual SourceBase
+{
+public:
+    /** Default constructor */
+    PhaseSpaceSource(string name="" ,Surface * previous=NULL);
+    /** Default destructor */
+    virtual ~PhaseSpaceSource(){}
+    virtual inline string getOptixClass(){return "Source<PhaseSpace>";}   /**< return the derived class name ie. Source<PhaseSpace> */
+
+    /** \brief defines the phase space density and builds the alias table
+     *
+     * \param numDims number of dimensions of the table, 4 or 5
+     * \param dims number of cells along each dimension, in order X, Y, X', Y' [, E]
+     * \param bounds lower and upper bounds of each dimension, in the same order (min X, max X, min Y, max Y, ...).
+     *      Positions are in m, angles in rad and the energy in eV
+     * \param density the numDims dimensional array of the cell densities; X varies the fastest and E the slowest. The values need not be normalized
+     * \throw ParameterException if the arguments are invalid or the density is null everywhere
+     */
+    void setTable(int numDims, const int64_t* dims, const double* bounds, const double* density);
+
+    virtual int generate(const double wavelength, const char polar='S');    /**< implementation of SourceBase::generate for PhaseSpaceSource() */
+
+protected:
+    /** \brief the sampling table, shared by the copies of the source */
+    struct Table
+    {
+        int numDims;            /**< \brief number of dimensions (4 or 5) */
+        int64_t dims[5];        /**< \brief number of cells along each dimension */
+        double lower[5];        /**< \brief lower bound of each dimension */
+        double width[5];        /**< \brief cell width along each dimension */
+        vector<double> prob;    /**< \brief alias method acceptance probability of each cell */
+        vector<uint32_t> alias; /**< \brief alias method alternate cell of each cell */
+    };
+    shared_ptr<const Table> m_table;    /**< \brief the sampling table; NULL until setTable() is called */
+};
 
 #endif // SOURCES_H
 
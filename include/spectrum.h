@@ -0,0 +1,49 @@
+#ifndef SPECTRUM_H_INCLUDED
+#define SPECTRUM_H_INCLUDED
+
+////////////////////////////////////////////////////////////////////////////////
+/**
+*      \file           spectrum.h
+*
+*      \brief         Ray tracing of a source at several wavelengths in a single parallel pass
+*
+*      \author         François Polack <francois.polack@synchroton-soleil.fr>
+*      \date        2024-10-30  Creation
+*      \date         Last update
+*
+
+*/
+///////////////////////////////////////////////////////////////////////////////////
+//
+//             REVISIONS
+//
+////////////////////////////////////////////////////////////////////////////////////
+
+#include "sourcebase.h"
+#include <vector>
+
+/** \brief Propagates the rays generated in a source at each wavelength of a list, in a single parallel pass
+ *  \ingroup GlobalCpp
+ *
+ *  Each wavelength is traced on an independent copy of the element chain (see DuplicateChain()), the copies being distributed over
+ *  the available OpenMP threads. The rays of the source copy receive the wavelength, and their amplitudes are scaled by the square root
+ *  of its weight. The impacts recorded by the copies are then appended to the recording surfaces of the original chain
+ *  in the order of the list, each impact being tagged by its wavelength, and the statistics of statistics recording surfaces are merged.
+ *  \n The impacts previously recorded downstream of the source are cleared. The rays stored in the source are not modified.
+ *  \n When the alignment is not fixed, each copy is aligned at its own wavelength. Since the merged impacts must be read in the frames
+ *  of the original chain, no surface can then record impacts: only statistics recording modes are allowed, each wavelength
+ *  contributing its statistics in the local frame of its own alignment.
+ * \param source the source element at the head of the chain. Its rays must have been generated
+ * \param wavelengths the list of wavelengths to trace (must be > 0)
+ * \param weights the relative intensities of the wavelengths, or an empty vector for equal intensities
+ * \param alignmentWavelength if > 0 the wavelength at which the original chain and all copies are aligned; if 0 each copy is aligned at its own wavelength,
+ *          and the surfaces of the chain cannot be in RecordInput or RecordOutput mode
+ * \param target a surface of the chain where per wavelength statistics are computed, or NULL. It must record impacts or statistics
+ * \param[out] statistics if target is not NULL, an array of wavelengths.size() SpotStatistics receiving the statistics of the target at each wavelength
+ * \return the total number of rays lost in propagation
+ * \throw ParameterException if the arguments are invalid or impacts are recorded without fixed alignment, RayException if the propagation failed at some wavelength
+ */
+int64_t RadiateSpectrum(SourceBase* source, const std::vector<double>& wavelengths, const std::vector<double>& weights,
+                        double alignmentWavelength, Surface* target, SpotStatistics* statistics);
+
+#endif // SPECTRUM_H_INCLUDED
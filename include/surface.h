@@ -20,8 +20,12 @@
 #include "elementbase.h"  // include many basic headers
 #include "ApertureStop.h"
 #include "bidimspline.h"  // Needed for surface errors
+#include "impactstore.h"
+#include "impactarena.h"
+#include "reflectancetable.h"
 
 #include <unsupported/Eigen/CXX11/Tensor>
+#include <omp.h>
 
 #ifdef HAS_REFLEX
     #include "CoatingTable.h"
@@ -42,6 +46,7 @@ using std::cout, std::endl, std::complex ;
 
 extern bool enableApertureLimit; // global flag defined in interfac.cpp
 extern bool enableSurfaceErrors;
+extern bool enableReflectivity;
 
 // using namespace std; no longer valid in recent c++ releases
 
@@ -78,11 +83,35 @@ public:
     /** \brief default  constructor (Film) with explicit chaining to previous
     */
     Surface(bool transparent=true, string name="", Surface * previous=NULL):ElementBase(transparent,name,previous),m_recording(RecordNone),
-             , m_pCoating(NULL), m_lostCount(0), m_apertureActive(false){}
+             m_pCoating(NULL), m_lostCount(0), m_apertureActive(false){}
 #else
     Surface(bool transparent=true, string name="", Surface * previous=NULL):ElementBase(transparent,name,previous),m_recording(RecordNone),
               m_lostCount(0), m_apertureActive(false){}
 #endif // HAS_REFLEX
+
+    /** \brief copy constructor
+     *
+     *  The surface error interpolator is owned by each surface and is deep copied, so that duplicated chains (see DuplicateChain())
+     *  can be modified and destroyed independently of the original elements
+     */
+    Surface(const Surface& surf):ElementBase(surf), m_aperture(surf.m_aperture), m_impacts(surf.m_impacts), m_recording(surf.m_recording),
+            m_statistics(surf.m_statistics), m_overflowStatistics(surf.m_overflowStatistics), m_recordFilter(surf.m_recordFilter), m_filterActive(surf.m_filterActive),
+            m_filterCount(surf.m_filterCount), m_impactStore(surf.m_impactStore),
+            m_orderSelected(surf.m_orderSelected), m_selectedOrder(surf.m_selectedOrder),
+#ifdef HAS_REFLEX
+            m_pCoating(surf.m_pCoating),
+#endif // HAS_REFLEX
+            m_reflectance(surf.m_reflectance), m_lostCount(surf.m_lostCount), m_apertureActive(surf.m_apertureActive),
+            m_errorMap(surf.m_errorMap ? new BidimSpline(*surf.m_errorMap) : NULL), m_errorMethod(surf.m_errorMethod),
+            m_ErrorGeneratorValid(surf.m_ErrorGeneratorValid), m_OPDvalid(surf.m_OPDvalid), m_NxOPD(surf.m_NxOPD), m_NyOPD(surf.m_NyOPD),
+            m_XYbounds(surf.m_XYbounds), m_OPDrefDist(surf.m_OPDrefDist), m_OPDdata(surf.m_OPDdata), m_amplitudes(surf.m_amplitudes)
+    {
+#ifdef HAS_REFLEX
+        if(m_pCoating)
+            ++(*m_pCoating);
+#endif // HAS_REFLEX
+    }
+
     /** \brief virtual destructor
      *   clean the surface error  generator id any
      */
@@ -138,9 +167,10 @@ public:
      *
      *  If no intercept can be found with the surface the ray will be marked as dead (m_alive=false)
      *  The ray is propagated even though it could be dead in order to keep the same ray index in all impact vectors
+     *  \return the number of rays lost downstream of this surface, counting each order propagated by a grating as a separate ray
      *  \throw an intercept or ray exception is thrown in case of computation error only
      */
-    inline virtual void propagate(RayType& ray) /**< the propagated ray */
+    inline virtual int propagate(RayType& ray) /**< the propagated ray */
     {
         try {
             if(m_transmissive)
@@ -158,23 +188,85 @@ public:
         }
 
         // the ray is propagated even though it could be dead in order to keep the same ray index in all impact vectors
-        if(m_next!=NULL )  // FP
-            m_next->propagate(ray);
-        if(! ray.m_alive)
-            ++m_lostCount;
+        int losses= (m_next!=NULL) ? m_next->propagate(ray) : !ray.m_alive;
+        m_lostCount+=losses;
            // cout << m_name << " ray lost : " << "(" << ray.position().transpose() << ") (" << ray.direction().transpose() << ")\n";
-
+        return losses;
     }
 
-    inline void setRecording(RecordMode rflag){m_recording=rflag;} /**< \brief Sets the impact recording mode for the surface */
+    /** \brief Sets the impact recording mode for the surface
+     *
+     *  In RecordInputStatistics and RecordOutputStatistics modes the impacts are not stored, only one SpotStatistics accumulator per thread is updated
+     *  \n In RecordInput and RecordOutput modes, if fields is not ImpactAllFields or the precision is not LongDoublePrecision, the impacts are kept
+     *  in a compact columnar ImpactStore instead of a vector of RayType. The impact getters return default values for the fields which are not stored
+     * \param rflag the recording mode
+     * \param fields a combination of \ref ImpactField flags selecting the recorded ray data
+     * \param precision the floating point precision of the recorded data
+     */
+    inline void setRecording(RecordMode rflag, uint32_t fields=ImpactAllFields, ImpactPrecision precision=LongDoublePrecision)
+    {
+        m_recording=rflag;
+        if(m_recording >= RecordInputStatistics)
+            m_statistics.assign(omp_get_max_threads(), SpotStatistics());
+        else
+            m_statistics.clear();
+        m_overflowStatistics=SpotStatistics();
+        if((fields & ImpactAllFields)==ImpactAllFields && precision==LongDoublePrecision)
+            m_impactStore.setFormat(0, LongDoublePrecision);   // full rays are stored in m_impacts
+        else
+            m_impactStore.setFormat(fields, precision);
+    }
     inline RecordMode getRecording(){return m_recording;} /**< \brief Gets the impact recording mode of the surface */
 
+    /** \brief Sets the filter applied to the impacts before they are recorded or accumulated in the statistics
+     *
+     *  The filter can select the impacts falling inside a region of interest, decimate the rays by a fixed stride or a seeded random draw,
+     *  discard the lost rays, or keep only one diffraction order of a multi-order grating. It applies to all recording modes.
+     * \param filter the filter definition. A filter without any active criterion removes the filtering
+     * \throw ParameterException if the filter definition is invalid
+     */
+    void setRecordingFilter(const RecordingFilter& filter);
+    inline RecordingFilter getRecordingFilter(){return m_recordFilter;} /**< \brief Gets the impact recording filter of the surface */
+
+    /** \brief Restricts the extraction of the recorded impacts to a single diffraction order
+     *
+     *  Unlike the order criterion of the recording filter, the selection does not discard any impact. All the extraction functions
+     *  (spot diagrams, impacts, caustics, wavefronts, statistics...) only consider the impacts of the selected order, so that the orders
+     *  of a multi-order trace (see GratingBase) can be studied one after the other on the same recording
+     * \param active if true only the impacts tagged with order are extracted; if false all the impacts are extracted
+     * \param order the selected diffraction order of the last grating met by the rays
+     */
+    inline void setOrderSelection(bool active, int order){m_orderSelected=active; m_selectedOrder=order; m_OPDvalid=false;}
+    inline bool isOrderSelected(){return m_orderSelected;}  /**< \brief returns true if the impact extraction is restricted to one order */
+    inline int getSelectedOrder(){return m_selectedOrder;}  /**< \brief returns the diffraction order selected for extraction */
+    inline uint32_t getRecordingFields(){return m_impactStore.isActive() ? m_impactStore.getFields() : uint32_t(ImpactAllFields);} /**< \brief Gets the ray fields recorded by the surface */
+    inline ImpactPrecision getRecordingPrecision(){return m_impactStore.isActive() ? m_impactStore.getPrecision() : LongDoublePrecision;} /**< \brief Gets the precision of the recorded impacts */
 
-    void clearImpacts();    /**< \brief  clear the impact vector of all elements of the surface chain starting from this element*/
+
+    virtual void clearImpacts();    /**< \brief  clear the impact vector of all elements of the surface chain starting from this element*/
 
     void reserveImpacts(int n); /**< \brief  reserve space for élements in the impact vector of all elements of the surface chain starting from this element to avoid reallocations
                                 *    \param  n the  number of elements to reserve t*/
-    inline int sizeImpacts(){return m_impacts.size();}  /**< \brief returns the number of recorded impacts  */
+    /** \brief allocates in a single memory block the impact vectors of the chain starting from this element
+     *
+     *  The block is divided into one slice of nRays impacts for this element, which holds the generated rays when it is a source,
+     *  and for each following surface recording full impacts in RecordInput or RecordOutput mode.
+     *  Surfaces in compact recording (see ImpactStore) keep their own storage. The impacts already stored are kept.
+     *  \n The slices are kept by clearImpacts(), so that repeated traces do not reallocate. A vector growing beyond its slice falls back to the heap.
+     * \param nRays the number of impacts reserved per element
+     * \param hugePages if true, the block is aligned for huge pages and, on Linux, advised to be backed by transparent huge pages
+     * \return the size of the allocated block in bytes
+     * \throw ElementException if the chain contains elements which are not surfaces
+     */
+    size_t allocateImpactArena(size_t nRays, bool hugePages=false);
+
+    /** \brief moves the impact vectors of the chain starting from this element back to individual heap allocations
+     *
+     *  The arena is freed when no surface uses it any longer
+     */
+    void releaseImpactArena();
+
+    inline int sizeImpacts(){return m_impactStore.isActive() ? m_impactStore.size() : m_impacts.size();}  /**< \brief returns the number of recorded impacts  */
 
     /** \brief get the impacts and directions of the set of of rays propagated from the source
      *
@@ -184,6 +276,38 @@ public:
      */
     int getImpacts(vector<RayType> &impacts, FrameID frame);
 
+    /** \brief get the positions in the impact vector of the rays which were not lost
+     *
+     *  The extraction functions use this index list to read the alive impacts directly from the internal storage, without copying them.
+     *  If an order is selected (see setOrderSelection()), the impacts of the other orders are neither returned nor counted
+     * \param[out] aliveIndexes a vector which will receive the indexes of the alive rays in the impact vector
+     * \return   The number of lost rays in propagation from source
+     */
+    int getAliveImpacts(vector<size_t> &aliveIndexes);
+
+    /** \brief get a copy of a recorded impact, referred to the requested frame
+     *
+     * \param index the index of the impact in the impact vector
+     * \param frame  The type of frame where the impact must be referred to. Can be: AlignedLocalFrame, SurfaceFrame, GeneralFrame or LocalAbsoluteFrame
+     * \return the ray transformed into the requested frame. Its position is the ray intercept with the surface
+     */
+    RayType getImpactInFrame(size_t index, FrameID frame);
+
+    /** \brief get the spot statistics accumulated since the last clearImpacts() call, when the surface records statistics
+     *
+     *  When the surface records impacts (RecordInput or RecordOutput mode) the statistics are computed from the recorded impacts
+     * \return the merge of the statistics accumulated by all threads. The spot vectors are in the AlignedLocalFrame, on the plane Z=0.
+     *  The returned object is empty if the surface does not record
+     */
+    SpotStatistics getSpotStatistics();
+
+    /** \brief appends the impacts or merges the statistics recorded by a copy of this surface (see DuplicateChain())
+     *
+     *  The copy must have the same recording mode and format
+     * \param copy the surface whose recording is added to the recording of this surface
+     */
+    void mergeRecording(Surface& copy);
+
     /** \brief get the 3D impacts as internally stored in a convenient shape for file output
      *
      * \param impactData a DiagramType object to fill with the internally stored data
@@ -202,6 +326,8 @@ public:
 
     /** \brief compute the 3D impact density on a 3d volume
      *
+     *  The X and Y limits of the volume are the extrema of the ray positions at zmin and zmax. The first and last sample of each axis are centered on these limits.
+     *  \n The z planes are distributed over the OpenMP threads, each thread filling its own planes of the diagram, so that no copy of the volume is needed.
      * \param dims the number of requested points in the x, y, z directions
      * \param zbound the limits [zmin, zmax] of the computation volume along the chief ray
      * \param xbound an array of 2 doubles where the array limits in the x direction will be returned, if not NULL
@@ -211,6 +337,28 @@ public:
      */
     Tensor<int32_t,3> getFocalDiagram(const int dims[3], const double zbound[2], double* xbound=NULL, double * ybound=NULL);
 
+    /** \brief compute the 3D intensity density on a 3d volume
+     *
+     *  Same as getFocalDiagram() but each impact is weighted by the ray intensity \f$ |A_S|^2+|A_P|^2 \f$
+     * \param dims the number of requested points in the x, y, z directions
+     * \param zbound the limits [zmin, zmax] of the computation volume along the chief ray
+     * \param xbound an array of 2 doubles where the array limits in the x direction will be returned, if not NULL
+     * \param ybound an array of 2 doubles where the array limits in the y direction will be returned, if not NULL
+     * \return a tensor of size (dims[0], dims[1], dims[2]) containing the 3D intensity
+     */
+    Tensor<double,3> getIntensityFocalDiagram(const int dims[3], const double zbound[2], double* xbound=NULL, double * ybound=NULL);
+
+    /** \brief computes the position of the best focus from the first and second moments of the recorded impacts
+     *
+     *  In free space the variance of the spot size is a quadratic function of the drift distance z, \f$ \sigma_x^2(z)= \sigma_{x_0}^2 + 2z\,cov(x_0,x') + z^2\sigma_{x'}^2 \f$,
+     *  so that the minimum is reached at \f$ z=-cov(x_0,x')/\sigma_{x'}^2 \f$. The moments are accumulated in a single parallel pass over the impacts,
+     *  in the AlignedLocalFrame.
+     * \param[out] focus a BestFocus struct receiving the distances and sizes of the X, Y and combined waists
+     * \param intensityWeighted if true each ray is weighted by its intensity \f$ |A_S|^2+|A_P|^2 \f$
+     * \return the number of alive impacts used, or 0 if there is no alive impact or their total weight is zero. The distances and sizes of focus are then set to NaN
+     */
+    int getBestFocus(BestFocus& focus, bool intensityWeighted=false);
+
     /** \brief Computes and fills-up a CausticDiagram object from the internally stored impact collection
      *
      * The CausticDiagram consists in the point of each ray wich is the closest to the central alignment ray
@@ -308,6 +456,16 @@ public:
         return 1.;
     }
 
+    /** \brief computes the corners of a 3D box enclosing the clear aperture on the surface, in the local absolute frame of the previous element
+     *
+     *  The box is the bounding box of the transparent regions (see ApertureStop::getBoundingBox()) in the surface frame, extended along the surface normal
+     *  from the lowest to the highest surface height sampled on a grid of this bounding box. At grazing incidence a small sag shifts the footprint
+     *  by a large amount along the beam, and the 3D box keeps it enclosed. The surface must be aligned.
+     * \param[out] corners a matrix whose eight columns receive the positions of the box corners, relative to the origin of the previous element
+     * \return true if the aperture is active and bounded, false otherwise
+     */
+    bool getApertureCorners(Matrix<FloatType,3,8> &corners);
+
     inline bool isOPDvalid(){return m_OPDvalid;}/**< \brief check validity  of OPD data before computing a PSF \return true if OPD data are valid*/
 
     void operator>>(xmlNodePtr elemnode);
@@ -400,10 +558,12 @@ public:
      * \param[out] normLegendre A matrix of normalized Legendre coefficients
      * \param[in] random_zernike if true the zernike coefficients are assigned randomly in the -abs(low_zernike), +abs(low_zernike) interval
      *              Otherwise, the values passed in the low_zernike parameters are kept
+     * \param[in] seed seed of the random generators. If 0 (default) a random seed is drawn from std::random_device.
+     *              A given non-zero seed always reproduces the same error map
      * \return true if the surface errors were generated; false in case of invalid configuration.
      *          The OptiXError describes the issue.
      */
-    virtual bool generateSurfaceErrors(int dims[2], double* total_sigma, MatrixXd& normLegendre, bool random_zernike=false );  //
+    virtual bool generateSurfaceErrors(int dims[2], double* total_sigma, MatrixXd& normLegendre, bool random_zernike=false, uint64_t seed=0 );  //
 
     /** \brief Checks the set of error defining parameters and signals configuration errors
      *
@@ -486,6 +646,16 @@ public:
     inline string getCoatingName(){return m_pCoating->getParentTable()->getName()+':'+m_pCoating->getName() ;} /**< \brief returns the qualified name of the coating, that is CoatingTable name and Coating name separated by a colon ':' */
     inline Coating* getCoating(){return m_pCoating;} /**< \brief returns a pointer to the coating used by the optical element */
 #endif // HAS_REFLEX
+
+    /** \brief sets or replaces the reflectance table applied to the ray amplitudes when reflectivity is enabled \see enableReflectivity
+     *
+     *  The S and P amplitudes of the rays are multiplied by the reflectance interpolated at their wavelength and grazing angle,
+     *  in the polarization frame of the surface. On a transmissive surface the table holds the transmittance.
+     *  \n The table is shared with the copies of the surface (see DuplicateChain()) and is not saved with the system
+     * \param table the reflectance table, or NULL to remove the table; a reflectance of 1. is then assumed for both polarizations
+     */
+    inline void setReflectanceTable(shared_ptr<const ReflectanceTable> table){m_reflectance=table;}
+    inline shared_ptr<const ReflectanceTable> getReflectanceTable(){return m_reflectance;} /**< \brief returns the reflectance table of the surface, or NULL */
 //    friend TextFile& operator<<(TextFile& file,  Surface& surface);  /**< \brief Duf this Surface object to a TextFile, in a human readable format  */
 //
 //    friend TextFile& operator >>(TextFile& file,  Surface& surface);  /**< \brief Retrieves a Surface object from a TextFile  */
@@ -497,15 +667,109 @@ protected:
        * \param[in,out] normal input: The normal after a call to intercept; output: the modified normal
        */
       void applyPerturbation(Vector2d& spos, RayType& ray, VectorType& normal);
+
+      /** \brief Helper function used by reflect & transmit. Multiplies the amplitudes by the reflectance of the surface, if reflectivity is enabled
+       * \param ray the ray at the intercept
+       * \param sinGrazing the sine of the grazing angle of the ray on the surface (its sign is ignored)
+       * \param[in,out] A the S and P amplitudes in the polarization frame of the surface
+       */
+      inline void applyReflectance(RayType& ray, double sinGrazing, Vector2cd& A)
+      {
+          if(!enableReflectivity || !m_reflectance)
+              return;
+          complex<double> rs, rp;
+          m_reflectance->getReflectance(ray.m_wavelength, asin(fmin(fabs(sinGrazing), 1.)), rs, rp);
+          A(0)*=rs;
+          A(1)*=rp;
+      }
+
+      /** \brief records an alive ray, if the surface records impacts or statistics in the given space
+       *
+       *  This function must be called by transmit() and reflect() implementations in place of a direct storage into m_impacts
+       * \param ray the ray to record
+       * \param space RecordInput if the ray is in entrance space, RecordOutput if it is in exit space
+       */
+      inline void recordImpact(RayType& ray, RecordMode space)
+      {
+          if(m_recording!=space && m_recording!=space+2)
+              return;
+          if(m_filterActive && !acceptImpact(ray, space))
+              return;
+          if(m_recording==space)
+          {
+              if(m_impactStore.isActive())
+                  m_impactStore.push_back(ray);
+              else
+                  m_impacts.push_back(ray);
+          }
+          else    // the statistics mode of the same space
+              accumulateStatistics(ray, space);
+      }
+
+      /** \brief records a ray which was not intercepted by the surface */
+      inline void recordLostRay(RayType& ray)
+      {
+          if(m_filterActive && !acceptImpact(ray, RecordInput))
+              return;
+          if(m_recording==RecordInput || m_recording==RecordOutput)
+          {
+              if(m_impactStore.isActive())
+                  m_impactStore.push_back(ray);
+              else
+                  m_impacts.push_back(ray);
+          }
+          else if(m_recording)
+              addToStatistics(NULL);
+      }
+
+      /** \brief updates the statistics accumulator of the calling thread with the spot of the ray in the AlignedLocalFrame
+       * \param ray the ray to accumulate
+       * \param space RecordInput if the ray is in entrance space, RecordOutput if it is in exit space
+       */
+      void accumulateStatistics(RayType& ray, RecordMode space);
+
+      /** \brief adds a spot to the statistics accumulator of the calling thread, or counts a lost ray
+       *
+       *  Threads whose number exceeds the size of m_statistics (thread count raised or nested team after setRecording())
+       *  accumulate in m_overflowStatistics inside a critical section
+       * \param spot the spot vector to accumulate, or NULL to count a lost ray
+       */
+      void addToStatistics(const Vector4d* spot);
+
+      /** \brief applies the recording filter to a ray
+       * \param ray the ray to be recorded
+       * \param space RecordInput if the ray is in entrance space, RecordOutput if it is in exit space
+       * \return true if the ray must be recorded
+       */
+      bool acceptImpact(RayType& ray, RecordMode space);
+
+      /** \brief fills a focal diagram with the alive impacts. Helper of getFocalDiagram() and getIntensityFocalDiagram()
+       * \param[in,out] diagram a tensor sized to the requested dimensions
+       * \param zbound the limits [zmin, zmax] of the computation volume along the chief ray
+       * \param xbound an array of 2 doubles where the array limits in the x direction will be returned, if not NULL
+       * \param ybound an array of 2 doubles where the array limits in the y direction will be returned, if not NULL
+       * \param weighted if true the ray intensity is accumulated, otherwise the ray count
+       */
+      template<typename Scalar>
+      void fillFocalDiagram(Tensor<Scalar,3>& diagram, const double zbound[2], double* xbound, double * ybound, bool weighted);
 public:
     ApertureStop m_aperture;  /**< \brief The active area of the surface   */
 
 protected:
-    vector<RayType> m_impacts; /**<  \brief the ray impacts on the surfaces in absolute local element space before or after reflection/transmission */
+    ImpactVector m_impacts; /**<  \brief the ray impacts on the surfaces in absolute local element space before or after reflection/transmission */
     RecordMode m_recording; /**<  \brief flag defining whether or not the ray impacts on this surface are recorded and before or after reflection/transmission   */
+    vector<SpotStatistics> m_statistics; /**< \brief one spot statistics accumulator per thread, used in the statistics recording modes */
+    SpotStatistics m_overflowStatistics; /**< \brief shared accumulator of the threads which have no slot in m_statistics */
+    RecordingFilter m_recordFilter={RoiNone, AlignedLocalFrame, {0,0}, {0,0}, 1, 1., 0, 0, 0, 0}; /**< \brief the filter applied to the impacts before recording */
+    bool m_filterActive=false; /**< \brief true if m_recordFilter has at least one active criterion */
+    uint64_t m_filterCount=0; /**< \brief count of the rays submitted to decimation since the last clearImpacts() call */
+    ImpactStore m_impactStore; /**< \brief compact storage of the impacts, used in place of m_impacts when a restricted set of fields or a lower precision is recorded */
+    bool m_orderSelected=false; /**< \brief true if the impact extraction is restricted to m_selectedOrder */
+    int m_selectedOrder=0;      /**< \brief the diffraction order extracted when m_orderSelected is true */
 #ifdef HAS_REFLEX
     Coating *m_pCoating=NULL; /**< \brief a pointer to a instance of Coating class to be used in reflectivity (or to be done transmittance) computations */
 #endif // HAS_REFLEX
+    shared_ptr<const ReflectanceTable> m_reflectance; /**< \brief the reflectance table applied in reflectivity computations, or NULL */
     int m_lostCount=0;        /**<  \brief Count of rays lost in this surface at transmission or reflexion */
     bool m_apertureActive;  /**<  \brief boolean flag for taking the aperture active area into account */
     BidimSpline* m_errorMap=NULL; /**< \brief A bidimensionnal spline interpolator of local height and slope deviation from ideal surface */
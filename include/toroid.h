@@ -83,6 +83,23 @@ class Toroid : virtual public Surface
             return 0;
         }
 
+        /** \brief saves the two aligned definition matrices (reimplemented from ElementBase) */
+        virtual inline void saveShapeState(vector<FloatType>& shapeState)
+        {
+            shapeState.assign(m_alignedMat1.data(), m_alignedMat1.data()+25);
+            shapeState.insert(shapeState.end(), m_alignedMat2.data(), m_alignedMat2.data()+25);
+        }
+
+        /** \brief restores the two aligned definition matrices (reimplemented from ElementBase) */
+        virtual inline int restoreShapeState(const vector<FloatType>& shapeState)
+        {
+            if(shapeState.size()!=50)
+                return -1;
+            m_alignedMat1=Map<const Matrix<FloatType,5,5> >(shapeState.data());
+            m_alignedMat2=Map<const Matrix<FloatType,5,5> >(shapeState.data()+25);
+            return 0;
+        }
+
         /** \brief computes the intercept of ray with this plane surface  in the surface local absolute frame and sets the new origin at the intercept
         *
         *   Ray must be expressed in **this** surface frame, in input as in output
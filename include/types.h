@@ -21,6 +21,7 @@
 #include "ctypes.h"
 #include "ray.h"
 #include <cstdarg>
+#include <limits>
 //#include <stdexcept>
 
 typedef Ray<FloatType>  RayType;/**< \brief Complete ray with wavelength and metadata (photometric and polar weights) */
@@ -106,6 +107,50 @@ public:
     }
 };
 
+/** \brief Running statistics of the spot vectors (X, Y and the X, Y direction cosines) of the rays crossing a surface
+ *
+ *  The mean and covariance are updated by the Welford algorithm, so that they can be accumulated during propagation without storing the rays.
+ *  Partial accumulators, filled by different threads, are combined with merge().
+ */
+struct SpotStatistics
+{
+    int64_t m_count=0;  /**< \brief number of accumulated spots */
+    int64_t m_lost=0;   /**< \brief number of dead rays */
+    Vector4d m_mean=Vector4d::Zero();   /**< \brief running mean of the spot vectors */
+    Matrix4d m_comoment=Matrix4d::Zero();   /**< \brief running sum of the products of deviations from the mean */
+    Vector4d m_min=Vector4d::Constant(std::numeric_limits<double>::infinity());  /**< \brief component minimums */
+    Vector4d m_max=Vector4d::Constant(-std::numeric_limits<double>::infinity()); /**< \brief component maximums */
+
+    /** \brief accumulates a new spot vector */
+    inline void add(const Vector4d& spot)
+    {
+        ++m_count;
+        Vector4d delta=spot-m_mean;
+        m_mean+=delta/m_count;
+        m_comoment+=delta*(spot-m_mean).transpose();
+        m_min=m_min.cwiseMin(spot);
+        m_max=m_max.cwiseMax(spot);
+    }
+
+    /** \brief combines the statistics accumulated in another object with this one */
+    inline void merge(const SpotStatistics& other)
+    {
+        m_lost+=other.m_lost;
+        if(other.m_count==0)
+            return;
+        int64_t n=m_count+other.m_count;
+        Vector4d delta=other.m_mean-m_mean;
+        m_comoment+=other.m_comoment + delta*delta.transpose()*(double(m_count)*other.m_count/n);
+        m_mean+=delta*(double(other.m_count)/n);
+        m_count=n;
+        m_min=m_min.cwiseMin(other.m_min);
+        m_max=m_max.cwiseMax(other.m_max);
+    }
+
+    /** \brief returns the (population) covariance matrix of the spot vectors */
+    inline Matrix4d covariance() const {return m_count ? Matrix4d(m_comoment/m_count) : Matrix4d::Zero();}
+};
+
 /** \brief Structure containing a wavefront map
  *  \see see also C_WFtype
  */
@@ -57,6 +57,18 @@ ArrayXXd Legendre(int Norder, const Ref<ArrayXd>& Xpos, ArrayXXd& derivative );
 ArrayXXd LegendreIntegrateSlopes(int Nx, int Ny, const Ref<ArrayX4d>& WFdata,
                                 const Ref<Array2d>& Xaperture, const Ref<Array2d>& Yaperture);
 
+/** \brief Checks whether a list of (X,Y) sample points is a regular tensor grid and returns the grid abscissas and ordinates
+ * \ingroup GlobalCpp
+ *
+ *  The points must be stored in column major order (X varying first), each X row being exactly repeated for every Y value.
+ * \param[in] Xdata the X coordinates of the points
+ * \param[in] Ydata the Y coordinates of the points
+ * \param[out] Xgrid on return the Nx X values of the grid, if the function returns true
+ * \param[out] Ygrid on return the Ny Y values of the grid, if the function returns true
+ * \return true if the points form a Nx x Ny grid, false otherwise
+ */
+bool GridFromXYZ(const Ref<const ArrayXd>& Xdata, const Ref<const ArrayXd>& Ydata, ArrayXd& Xgrid, ArrayXd& Ygrid);
+
 /** \brief Computes the interpolation of a surface by 2D legendre polynomials on the given aperture from the surface heights (Z) at a set of aperture points (X,Y)
  * \ingroup GlobalCpp
  * \param Nx number of polynomials of the X basis (degree <Nx)
@@ -65,6 +77,8 @@ ArrayXXd LegendreIntegrateSlopes(int Nx, int Ny, const Ref<ArrayX4d>& WFdata,
  * \param Xaperture Bounds (Min, Max) of X aperture angle for Legendre definition along X
  * \param Yaperture Bounds of Y aperture angle for Legendre definition along Y
  * \return The Nx x Ny (row,col) array of coefficients of Legendre polynomials describing the wavefront error to the given degrees and best fitting  the transverse aberration data
+ *
+ *  If the samples lie on a regular grid (see GridFromXYZ) the fit is computed as two separable 1D projections instead of the full design matrix.
  */
 ArrayXXd LegendreFitXYZ(int Nx, int Ny, const Ref<ArrayX3d>& XYZdata,
                                 const Ref<Array2d>& Xaperture, const Ref<Array2d>& Yaperture);
@@ -74,6 +88,8 @@ ArrayXXd LegendreFitXYZ(int Nx, int Ny, const Ref<ArrayX3d>& XYZdata,
  * \param Nx number of polynomials of the X basis (degree <Nx)
  * \param Ny number of polynomials of the Y basis (degree <Ny)
  * \param griddata Array reference to the gridded data
+ *
+ *  The fit is computed by separating the X and Y normal equations, in \f$ O(N_{data} (N_x+N_y)) \f$ operations.
  * \return The Nx x Ny (row,col) array of coefficients of Legendre polynomials describing the wavefront error to the given degrees and best fitting  the transverse aberration data
  */
 ArrayXXd LegendreFitGrid(int Nx, int Ny, const Ref<ArrayXXd>& griddata);
@@ -103,6 +119,8 @@ ArrayXXd LegendreSurfaceGrid(int Nx, int Ny, const Ref<MatrixXd>& legendreCoefs
  * \ingroup GlobalCpp
  *
  * All coordinate points must fall inside the bounds. The Xpos and Ypos arrays must have the same s ize.
+ * Each point is evaluated with nested Clenshaw recurrences (OpenMP parallel loop over the points), so no basis matrix is built
+ * and the cost is linear in the number of points.
  * \param Xpos reference to a linear array containing the X coordinates of the points
  * \param Ypos reference to a linear array containing the Y coordinates of the points
  * \param bounds const Array of the X and Y bounds on which the Legendre are computed. All (Xpos, Ypos) points must fall inside this rectangle
@@ -127,4 +145,26 @@ ArrayXXd  LegendreNormalize(const Ref<ArrayXXd>& coefs);
  */
  ArrayXXd  LegendreFromNormal(const Ref<ArrayXXd>& coefs);
 
+/** \brief Evaluates a Legendre series at one point with the Clenshaw recurrence
+ * \ingroup GlobalCpp
+ *
+ *  With \f$ P_{k+1}= \alpha_k P_k + \beta_k P_{k-1} \f$,  \f$ \alpha_k =(2k+1)x/(k+1) \f$ and \f$ \beta_k = -k/(k+1) \f$ the series is
+ *  computed backward as \f$ b_k = a_k + \alpha_k b_{k+1} + \beta_{k+1} b_{k+2} \f$ and \f$ f = a_0 + x b_1 - b_2/2 \f$
+ * \param coefs pointer to the first coefficient \f$ a_0 \f$
+ * \param N number of coefficients
+ * \param x  the normalized abscissa [-1, 1]
+ * \return the value of the series at x
+ */
+inline double LegendreClenshaw(const double* coefs, Index N, double x)
+{
+    double b1=0, b2=0, b0;
+    for(Index k=N-1; k > 0; --k)
+    {
+        b0=coefs[k] + (2.*k+1.)/(k+1.)*x*b1 - (k+1.)/(k+2.)*b2;
+        b2=b1;
+        b1=b0;
+    }
+    return coefs[0] + x*b1 - 0.5*b2;
+}
+
 #endif // WAVEFRONT_H_INCLUDED
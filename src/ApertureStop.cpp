@@ -16,6 +16,20 @@
 #include "Polygon.h"
 
 
+ApertureStop::ApertureStop(const ApertureStop& aperture)
+{
+    vector<Region*>::const_iterator it;
+    for (it=aperture.m_regions.begin(); it != aperture.m_regions.end(); ++it)
+    {
+        if((*it)->getOptixClass()=="Polygon")
+            m_regions.push_back(new Polygon(*dynamic_cast<Polygon*>(*it)));
+        else if((*it)->getOptixClass()=="Ellipse")
+            m_regions.push_back(new Ellipse(*dynamic_cast<Ellipse*>(*it)));
+        else
+            throw ElementException(string("Unknown region class ")+(*it)->getOptixClass(), __FILE__, __func__, __LINE__);
+    }
+}
+
 ApertureStop::~ApertureStop()
 {
   vector<Region*>::iterator it;
@@ -96,6 +110,23 @@ double ApertureStop::getTransmissionAt(const Ref<Vector2d> &point)
     return m_regions[0]->isTransparent() ? 0 : 1. ;
 }
 
+bool ApertureStop::getBoundingBox(Vector2d &lower, Vector2d &upper)
+{
+    if(m_regions.size()==0 || !m_regions[0]->isTransparent())
+        return false;
+    Vector2d regionLower, regionUpper;
+    m_regions[0]->getBoundingBox(lower, upper);
+    for(size_t i=1; i < m_regions.size(); ++i)
+    {
+        if(!m_regions[i]->isTransparent()) // opaque regions can only reduce the transmitting area
+            continue;
+        m_regions[i]->getBoundingBox(regionLower, regionUpper);
+        lower=lower.cwiseMin(regionLower);
+        upper=upper.cwiseMax(regionUpper);
+    }
+    return true;
+}
+
 #define XMLSTR (xmlChar*)
 //xmlNodePtr operator<<(xmlNodePtr surfnode, const ApertureStop & aperture)
 void ApertureStop::operator>>(xmlNodePtr surfnode)
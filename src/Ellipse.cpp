@@ -95,6 +95,17 @@ void Ellipse::setSymmetric(const Ref<Vector2d> &point, const Ref<Vector2d> &dir)
     m_Mat=trans.transpose()*m_Mat*trans;
 }
 
+void Ellipse::getBoundingBox(Vector2d &lower, Vector2d &upper)
+{
+    // with m_Mat = [A g; g' f], the ellipse is (P-C)' A (P-C) = r  with C=-inv(A) g and r= g' inv(A) g - f
+    Matrix2d inverse=m_Mat.topLeftCorner(2,2).inverse();
+    Vector2d center=-inverse*m_Mat.col(2).head(2);
+    double r=-m_Mat.col(2).head(2).dot(center)-m_Mat(2,2);
+    Vector2d halfWidth=(r*inverse.diagonal()).cwiseSqrt();
+    lower=center-halfWidth;
+    upper=center+halfWidth;
+}
+
 void Ellipse::getParameters(double* a, double* b, double* xcenter, double* ycenter, double *angle)
 {
     Vector2d trans= m_Mat.topLeftCorner(2,2).inverse()* m_Mat.col(2).head(2);
@@ -159,3 +159,15 @@ Surface::VectorType Poly1D::gratingVector(const Surface::VectorType &position, c
   return G;
 }
 
+void Poly1D::gratingVectors(const Ref<const Matrix3Xd>& positions, const Ref<const Matrix3Xd>& normals, Ref<Matrix3Xd> G)
+{
+    // normal x UnitY = (-Nz, 0, Nx), normalized, times the line density computed by Horner's scheme along X
+    ArrayXd x=positions.row(0).transpose().array();
+    ArrayXd density=ArrayXd::Constant(x.size(), m_coeffs(m_degree));
+    for(int n=m_degree-1; n >= 0; --n)
+        density=density*x+m_coeffs(n);
+    density/=(normals.row(0).array().square()+normals.row(2).array().square()).sqrt().transpose();
+    G.row(0)=(-normals.row(2).array()*density.transpose()).matrix();
+    G.row(1).setZero();
+    G.row(2)=(normals.row(0).array()*density.transpose()).matrix();
+}
@@ -162,6 +162,18 @@ void Polygon::setSymmetric(const Ref<Vector2d> &point)
     m_refPoint=(rot*m_refPoint).eval().colwise()+2*point;
 }
 
+void Polygon::getBoundingBox(Vector2d &lower, Vector2d &upper)
+{
+    if(m_size==0)
+    {
+        lower.setZero();
+        upper.setZero();
+        return;
+    }
+    lower=m_vertices.leftCols(m_size).rowwise().minCoeff();
+    upper=m_vertices.leftCols(m_size).rowwise().maxCoeff();
+}
+
 bool Polygon::checkConvex()
 {
     if(m_size<3)
@@ -17,6 +17,10 @@
 #include "elementBase.h"
 #include <fstream>
 #include <iostream>
+#include <atomic>
+#include <set>
+
+static std::atomic<int32_t> coatingTablesDone(0), coatingTablesTotal(0);  /**< \brief progress of the current coating table computation */
 
 /****************************   DataBases    ******************************************/
 
@@ -835,14 +839,79 @@ DLL_EXPORT bool CoatingTableCompute(const char* coatingTable)
         return false;
     }
   //  cout << " Coating table status ="<< hex << ctabit->second.getStatus() << dec <<endl;
+    coatingTablesDone=0;
+    coatingTablesTotal=1;
     try{
         ctabit->second.computeReflectivity();
     }
     catch(runtime_error &rte)
     {
+        coatingTablesDone=1;
         SetOptiXLastError(string("CoatingTable  ")+ coatingTable + " cannot compute the reflectivity; reason: "+rte.what(), __FILE__, __func__);
         return false;
     }
+    coatingTablesDone=1;
+    return true;
+}
+
+DLL_EXPORT bool CoatingTablesCompute(int32_t numTables, const char** tableNames)
+{
+    ClearOptiXError();
+    if(numTables <= 0 || !tableNames)
+    {
+        SetOptiXLastError("Invalid list of coating tables", __FILE__, __func__);
+        return false;
+    }
+    // all tables are checked before starting the computation
+    vector<CoatingTable*> tables;
+    set<CoatingTable*> listed;
+    for(int32_t i=0; i < numTables; ++i)
+    {
+        map<string,CoatingTable>::iterator ctabit = coatingTables.find(tableNames[i]);
+        if(ctabit==coatingTables.end())
+        {
+            SetOptiXLastError(string("CoatingTable  ")+ tableNames[i] + " is not currently defined" , __FILE__, __func__);
+            return false;
+        }
+        if(!listed.insert(&ctabit->second).second)
+        {
+            SetOptiXLastError(string("CoatingTable  ")+ tableNames[i] + " is listed twice" , __FILE__, __func__);
+            return false;
+        }
+        tables.push_back(&ctabit->second);
+    }
+
+    coatingTablesDone=0;
+    coatingTablesTotal=numTables;
+    string firstError;
+    // sequential: the tables share the material databases, whose concurrent use is not known to be safe in RefleX
+    for(int32_t i=0; i < numTables; ++i)
+    {
+        try{
+            tables[i]->computeReflectivity();
+        }
+        catch(std::exception &excpt)
+        {
+            if(firstError.empty())
+                firstError=string("CoatingTable  ")+ tableNames[i] + " cannot compute the reflectivity; reason: "+excpt.what();
+        }
+        ++coatingTablesDone;
+    }
+    if(!firstError.empty())
+    {
+        SetOptiXLastError(firstError, __FILE__, __func__);
+        return false;
+    }
+    return true;
+}
+
+DLL_EXPORT bool GetCoatingComputeProgress(int32_t* tablesDone, int32_t* tablesTotal)
+{
+    // the OptiX error string is not touched, since this function can run concurrently with the computation
+    if(!tablesDone || !tablesTotal)
+        return false;
+    *tablesDone=coatingTablesDone;
+    *tablesTotal=coatingTablesTotal;
     return true;
 }
 
@@ -0,0 +1,115 @@
+////////////////////////////////////////////////////////////////////////////////
+/**
+*      \file           alignmentcache.cpp
+*
+*      \brief         AlignmentCache implementation
+*
+*      \author         François Polack <francois.polack@synchroton-soleil.fr>
+*      \date        2024-10-31  Creation
+*      \date         Last update
+*
+
+*/
+///////////////////////////////////////////////////////////////////////////////////
+//
+//             REVISIONS
+//
+////////////////////////////////////////////////////////////////////////////////////
+
+#include "alignmentcache.h"
+#include "opticalelements.h"
+
+using namespace std;
+
+void AlignmentCache::build(ElementBase* first, const vector<double>& wavelengths, GratingBase* grating, double Cff)
+{
+    if(!first)
+        throw ParameterException("the first element of the chain is not defined", __FILE__, __func__, __LINE__);
+    if(wavelengths.empty())
+        throw ParameterException("the wavelength list is empty", __FILE__, __func__, __LINE__);
+    for(double wavelength : wavelengths)
+        if(wavelength <= 0)
+            throw ParameterException("wavelengths must be positive", __FILE__, __func__, __LINE__);
+    if(grating && Cff <= 0)
+        throw ParameterException("Invalid negative or null Cff value", __FILE__, __func__, __LINE__);
+
+    vector<ElementBase*> elements;
+    size_t gratingIndex=0;
+    for(ElementBase* pElem=first; pElem; pElem=pElem->getNext())
+    {
+        if(pElem==grating)
+            gratingIndex=elements.size();
+        elements.push_back(pElem);
+    }
+    if(grating && elements[gratingIndex]!=grating)
+        throw ParameterException(grating->getName()+" is not in the chain starting at "+first->getName(), __FILE__, __func__, __LINE__);
+
+    vector<double> thetas;
+    if(grating)
+        for(double wavelength : wavelengths)
+            thetas.push_back(grating->getCffTheta(Cff, wavelength));
+
+    // the alignments are computed on a copy, so that the original chain keeps its current alignment
+    // Alignment only involves a few small matrix products per element and is done sequentially; the copy is made once for the whole list
+    ChainCopy chain;
+    if(!DuplicateChain(first, chain))
+        throw ElementException("Failed to duplicate the element chain", __FILE__, __func__, __LINE__);
+
+    vector<vector<ElementBase::AlignmentState> > states(wavelengths.size(), vector<ElementBase::AlignmentState>(elements.size()));
+    for(size_t i=0; i < wavelengths.size(); ++i)
+    {
+        if(grating)
+        {
+            Parameter theta;
+            ElementBase* gratingCopy=chain.copyMap.at(grating);
+            gratingCopy->getParameter("theta", theta);
+            theta.value=thetas[i];
+            gratingCopy->setParameter("theta", theta);
+        }
+        if(chain.First->alignFromHere(wavelengths[i]) || !chain.First->isAligned())
+            throw ElementException(string("alignment failed at wavelength ")+to_string(wavelengths[i])+": "+LastError, __FILE__, __func__, __LINE__);
+        for(size_t k=0; k < elements.size(); ++k)
+            chain.copyMap.at(elements[k])->saveAlignment(states[i][k]);
+    }
+
+    m_first=first;
+    m_grating=grating;
+    m_elements.swap(elements);
+    m_changeCounts.clear();
+    for(ElementBase* pElem : m_elements)
+        m_changeCounts.push_back(pElem->getChangeCount());
+    m_wavelengths=wavelengths;
+    m_thetas.swap(thetas);
+    m_states.swap(states);
+}
+
+void AlignmentCache::apply(size_t index)
+{
+    if(index >= m_wavelengths.size())
+        throw ParameterException("alignment cache index out of range", __FILE__, __func__, __LINE__);
+    ElementBase* pElem=m_first;
+    for(size_t k=0; k < m_elements.size(); ++k, pElem=pElem->getNext())
+    {
+        if(pElem!=m_elements[k])
+            throw ParameterException("the element chain was modified after the alignment cache was built", __FILE__, __func__, __LINE__);
+        if(pElem->getChangeCount()!=m_changeCounts[k])
+            throw ParameterException(string("parameters of ")+pElem->getName()+" were changed after the alignment cache was built",
+                                     __FILE__, __func__, __LINE__);
+    }
+    if(pElem)
+        throw ParameterException("the element chain was modified after the alignment cache was built", __FILE__, __func__, __LINE__);
+
+    if(m_grating)
+    {
+        Parameter theta;
+        m_grating->getParameter("theta", theta);
+        theta.value=m_thetas[index];
+        m_grating->setParameter("theta", theta);
+        for(size_t k=0; k < m_elements.size(); ++k)
+            if(m_elements[k]==m_grating)
+                m_changeCounts[k]=m_grating->getChangeCount();
+    }
+    for(size_t k=0; k < m_elements.size(); ++k)
+        if(m_elements[k]->restoreAlignment(m_states[index][k], m_wavelengths[index]))
+            throw ElementException(string("failed to restore the alignment of ")+m_elements[k]->getName(), __FILE__, __func__, __LINE__);
+}
@@ -13,7 +13,10 @@
 
 #include "bidimspline.h"
 #include "wavefront.h"
+#include "fractalsurface.h"
 #include<Eigen/SparseQR>
+#include <mutex>
+#include <fftw3.h>
 
 bool SplineSolve(SparseMatrix<double,ColMajor> &A,const Ref<VectorXd> &B, Ref<VectorXd> C)
 {
@@ -314,14 +317,18 @@ void BidimSpline::buildControlPoints(const Ref<ArrayXd> &Xvalues, const Ref<Arra
 
  }
 
- ArrayXXd BidimSpline::uniformSpaced1DSolveT(const Ref<ArrayXXd>& input)
+ /** \brief solves the uniform cubic spline system for each row of a panel of input rows
+  *
+  * The coefficients of the i-th row of input are returned in the i-th row of Coeffs, which must be sized input.rows() x input.cols()+2.
+  * All accesses are made along columns, which are contiguous in memory for both arrays
+  */
+ static void uniformSpacedPanelSolve(const Ref<const ArrayXXd>& input, Ref<ArrayXXd> Coeffs)
  {
      int N= input.cols()-1;  // this is the number of spline intervals
      // define auxiliary vectors
      ArrayXd D(input.cols()); // the new first diagonal after substitution
      ArrayXXd Phi(input.rows(), input.cols());  //The new right hand side  after substitution
-     ArrayXXd Coeffs(N+3, input.rows()); // the array of computed spline coefficients (transposed)
-     Block<ArrayXXd> C=Coeffs.middleRows(1, N+1);
+     Block<Ref<ArrayXXd>, Dynamic, Dynamic, true> C=Coeffs.middleCols(1, N+1);
 
      // Iteration loop to compute the 1st diagonal
      D(0)=-1./3.;
@@ -338,20 +345,36 @@ void BidimSpline::buildControlPoints(const Ref<ArrayXd> &Xvalues, const Ref<Arra
      D(N-1)=3./cc;
      Phi.col(N-1)=2./cc*(6.*input.col(N-1)-Phi.col(N-2));
 
-     C.row(N)=(Phi.col(N-1)+2.*input.col(N))/(3.+D(N-1));
-    // beware Eigen doen't like algebra on 1D arrays of different orientation
-     C.row(N-1)=3.*C.row(N)-2.*input.col(N).transpose();
-
+     C.col(N)=(Phi.col(N-1)+2.*input.col(N))/(3.+D(N-1));
+     C.col(N-1)=3.*C.col(N)-2.*input.col(N);
 
      for(int i=N-2; i >=0; --i)
-        C.row(i)=Phi.col(i).transpose()-D(i)*C.row(i+1);
+        C.col(i)=Phi.col(i)-D(i)*C.col(i+1);
 
-     // in Coefs we have to set the rows 0 and N+2 respectively with rows 0 and N of the input
-     Coeffs.row(0)= input.col(0);
-     Coeffs.row(N+2)=input.col(N);
+     // in Coefs we have to set the columns 0 and N+2 respectively with columns 0 and N of the input
+     Coeffs.col(0)= input.col(0);
+     Coeffs.col(N+2)=input.col(N);
+ }
 
-     return Coeffs;
+ ArrayXXd BidimSpline::uniformSpaced1DSolveT(const Ref<ArrayXXd>& input)
+ {
+     const Index panelSize=64;   // number of input rows solved together, small enough to keep the panel in cache
+     Index nrows=input.rows(), ncols=input.cols(), numPanels=(nrows+panelSize-1)/panelSize;
+     if(ncols < 4)
+        throw ParameterException("Uniform spline solve needs at least 4 data points along each axis", __FILE__, __func__, __LINE__);
+
+     ArrayXXd Coeffs(ncols+2, nrows); // the array of computed spline coefficients (transposed)
 
+     // the rows are independent systems sharing the same matrix. They are solved by panels in parallel
+     #pragma omp parallel for schedule(static)
+     for(Index ipanel=0; ipanel < numPanels; ++ipanel)
+     {
+         Index first=ipanel*panelSize, size=std::min(panelSize, nrows-first);
+         ArrayXXd panelCoeffs(size, ncols+2);
+         uniformSpacedPanelSolve(input.middleRows(first, size), panelCoeffs);
+         Coeffs.middleCols(first, size)=panelCoeffs.transpose();
+     }
+     return Coeffs;
  }
 
 
@@ -364,12 +387,13 @@ void BidimSpline::setFromGridData(const Array22d& limits, const Ref<ArrayXXd>& g
 
     setUniformKnotBase(Y,gridData.cols()-1,limits(0,1), limits(1,1));
 
+    // the tensor product system is separable: solve along X for every Y sample, then along Y for every X control value
     ArrayXXd temp=uniformSpaced1DSolveT(gridData);
     m_controlValues=uniformSpaced1DSolveT(temp);
 
 }
 
-void BidimSpline::setFromGradient(const Array22d& limits, const Ref<ArrayXXd> & gradx, const Ref<ArrayXXd> & grady)
+void BidimSpline::setFromGradient(const Array22d& limits, const Ref<ArrayXXd> & gradx, const Ref<ArrayXXd> & grady, bool spectral)
 {
     if(degree!=3)
         throw ParameterException("This function is only available for cubic B-spline interpolation. Degree MUST BE 3 ",
@@ -378,12 +402,20 @@ void BidimSpline::setFromGradient(const Array22d& limits, const Ref<ArrayXXd> &
         throw ParameterException("Arrays  gradx  and grady must have the same size", __FILE__, __func__, __LINE__);
 
     Index Nx=gradx.rows()-1, Ny = gradx.cols()-1;  // nombres de segments dans  les intervalles de définition
+    if(spectral)
+    {
+        ArrayXXd heights=SpectralIntegrateGradient(gradx, grady, (limits(1,0)-limits(0,0))/Nx, (limits(1,1)-limits(0,1))/Ny);
+        setFromGridData(limits, heights);
+        return;
+    }
     Index Nx3=Nx+3, Ny3=Ny+3;
     setUniformKnotBase(X,Nx,limits(0,0), limits(1,0));
     setUniformKnotBase(Y,Ny,limits(0,1), limits(1,1));
 
     Index problemSize=2*(Nx3)*(Ny3)+1;  // number of partial derivatives + integration constant
+#ifdef DEBUG_SPLINE_
     std::cout << "The sise of the problem is " << problemSize << std::endl;
+#endif
 
     ArrayXXd fprim(7,3);
     fprim << -3,       3,       0,
@@ -410,10 +442,14 @@ void BidimSpline::setFromGradient(const Array22d& limits, const Ref<ArrayXXd> &
 
  typedef Triplet<double> Trp;
  std::vector<Trp>  tripletList;
+#ifdef DEBUG_SPLINE_
  Index estTriplSize= (Nx+6)*(Ny+6)*12; // en moyenne 6 valeur par equation
  std::cout << "entry number max size:" << problemSize*9 <<  "  estimated: " << estTriplSize  <<  std::endl;
+#endif
  tripletList.reserve(problemSize*9);
+#ifdef DEBUG_SPLINE_
  std::cout << "triplet list reserved\n";
+#endif
  Index ity,ieqx,ieqy, maxic=0;
  for (ity=0, ieqx=0, ieqy=Nx3*Ny3; ity <Ny3; ++ity)
  {                          // ity = indice dans la matrice de données bordée (condition aux limite)
@@ -485,16 +521,20 @@ void BidimSpline::setFromGradient(const Array22d& limits, const Ref<ArrayXXd> &
 
     tripletList.push_back(Trp(2*Nx3*Ny3,Nx3*(Ny3/2)+(Nx3/2),1.));
 
+#ifdef DEBUG_SPLINE_
     std::cout <<"triplet list filled\n";
     std::cout << "triplet size: used: " <<tripletList.size() << " allocated: " << tripletList.capacity() <<
                 "  estimated: " << estTriplSize << std::endl;
     std::cout << " coeffs num " << Nx3*Ny3 << std::endl;
     std::cout << " max col:" << maxic << "  num row Dx=" << ieqx  <<  "num row Dy=" << ieqy << std::endl;
+#endif
 // Fill-up the RHS
     VectorXd Rhs(problemSize);
     Map<MatrixXd> mderivx(Rhs.data(), Nx3, Ny3);
     Map<MatrixXd> mderivy(Rhs.data()+Nx3*Ny3, Nx3, Ny3);
+#ifdef DEBUG_SPLINE_
     std::cout << "Rhs & matrices allocated\n";
+#endif
     mderivx.block(1,1, gradx.rows(), gradx.cols())= gradx;
     mderivx.col(0)=mderivx.col(1);
     mderivx.col(Ny3-1)=mderivx.col(Ny3-2);
@@ -515,9 +555,80 @@ void BidimSpline::setFromGradient(const Array22d& limits, const Ref<ArrayXXd> &
   //  solver.compute(Smat);
   //  m_controlValues=C
     solver.analyzePattern(Smat);
-    std::cout << "pattern analyzed OK\n";
     solver.factorize(Smat);
-    std::cout << "factorized\n";
+    if(solver.info()!=Success)
+        throw EigenException(string("Factorization of the gradient integration system failed: ")+solver.lastErrorMessage(),
+                             __FILE__, __func__, __LINE__);
+    VectorXd C=solver.solve(Rhs);
+    if(solver.info()!=Success)
+        throw EigenException("Resolution of the gradient integration system failed", __FILE__, __func__, __LINE__);
+    m_controlValues=C.reshaped(Nx3, Ny3);
+}
+
+ArrayXXd SpectralIntegrateGradient(const Ref<const ArrayXXd>& gradx, const Ref<const ArrayXXd>& grady, double xStep, double yStep)
+{
+    if(gradx.rows() != grady.rows() || gradx.cols() != grady.cols())
+        throw ParameterException("Arrays  gradx  and grady must have the same size", __FILE__, __func__, __LINE__);
+    Index nx=gradx.rows(), ny=gradx.cols();
+    // The gradient maps are mirrored (half sample symmetry) on a grid of double size, so that the periodic extension has no step at the borders
+    // Eigen is column major, so X is the fastest varying index, i.e. the last dimension for FFTW
+    Index Mx=2*nx, My=2*ny, nfx=nx+1;
+    double * realx=(double*) fftw_malloc(sizeof(double)*Mx*My);
+    double * realy=(double*) fftw_malloc(sizeof(double)*Mx*My);
+    fftw_complex* specx=(fftw_complex*) fftw_malloc(sizeof(fftw_complex)*nfx*My);
+    fftw_complex* specy=(fftw_complex*) fftw_malloc(sizeof(fftw_complex)*nfx*My);
+    fftw_plan forward, backward;
+    {
+        std::lock_guard<std::mutex> lock(FFTWPlannerMutex());
+        forward=fftw_plan_dft_r2c_2d(My, Mx, realx, specx, FFTW_ESTIMATE);
+        backward=fftw_plan_dft_c2r_2d(My, Mx, specx, realx, FFTW_ESTIMATE);
+    }
+
+    Map<ArrayXXd> Gx(realx, Mx, My), Gy(realy, Mx, My);
+    // dz/dx is odd in x and even in y; dz/dy is even in x and odd in y
+    Gx.topLeftCorner(nx,ny)=gradx;
+    Gx.bottomLeftCorner(nx,ny)=-gradx.colwise().reverse();
+    Gx.rightCols(ny)=Gx.leftCols(ny).rowwise().reverse();
+    Gy.topLeftCorner(nx,ny)=grady;
+    Gy.bottomLeftCorner(nx,ny)=grady.colwise().reverse();
+    Gy.rightCols(ny)=-Gy.leftCols(ny).rowwise().reverse();
+
+    fftw_execute_dft_r2c(forward, realx, specx);
+    fftw_execute_dft_r2c(forward, realy, specy);
+
+    // Frankot-Chellappa projection  Z = -i (wx Gx + wy Gy) / (wx^2 + wy^2)
+    double ux=2.*M_PI/(Mx*xStep), uy=2.*M_PI/(My*yStep);
+    for(Index ky=0; ky < My; ++ky)
+    {
+        double wy= uy*(ky <= My/2 ? ky : ky-My);
+        for(Index kx=0; kx < nfx; ++kx)
+        {
+            double wx= ux*kx, w2=wx*wx+wy*wy;
+            fftw_complex &zx=specx[ky*nfx+kx], &zy=specy[ky*nfx+kx];
+            if(w2==0)
+            {
+                zx[0]=zx[1]=0;  // the integration constant is set so that the mean height is zero
+                continue;
+            }
+            double re= (wx*zx[0]+wy*zy[0])/w2, im=(wx*zx[1]+wy*zy[1])/w2;
+            zx[0]=im;
+            zx[1]=-re;
+        }
+    }
+
+    fftw_execute_dft_c2r(backward, specx, realx);
+    ArrayXXd heights=Gx.topLeftCorner(nx,ny)/double(Mx*My);
+
+    {
+        std::lock_guard<std::mutex> lock(FFTWPlannerMutex());
+        fftw_destroy_plan(forward);
+        fftw_destroy_plan(backward);
+    }
+    fftw_free(specy);
+    fftw_free(specx);
+    fftw_free(realy);
+    fftw_free(realx);
+    return heights;
 }
 
 Array22d BidimSpline::getSampling(int *nx, int* ny)
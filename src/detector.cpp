@@ -0,0 +1,151 @@
+////////////////////////////////////////////////////////////////////////////////
+/**
+*      \file           detector.cpp
+*
+*      \brief         DetectorBase class implementation
+*
+*      \author         François Polack <francois.polack@synchroton-soleil.fr>
+*      \date        2024-10-21  Creation
+*      \date        Last update
+*
+*/
+///////////////////////////////////////////////////////////////////////////////////
+//
+//             REVISIONS
+//
+////////////////////////////////////////////////////////////////////////////////////
+#include "detector.h"
+#include <omp.h>
+
+
+DetectorBase::DetectorBase(string name ,Surface * previous):Surface(true,name, previous)
+{
+    Parameter param;
+    param.group=BasicGroup;
+    param.flags=NotOptimizable;
+    param.type=Dimensionless;
+    param.value=100;
+    defineParameter("pixels_X", param);
+    defineParameter("pixels_Y", param);
+    param.value=1;
+    defineParameter("lambda_bins", param);
+    param.type=Distance;
+    param.value=1.e-5;
+    defineParameter("pixel_size_X", param);
+    defineParameter("pixel_size_Y", param);
+    param.value=0;
+    defineParameter("lambda_min", param);
+    defineParameter("lambda_max", param);
+    param.flags=0;
+    defineParameter("image_distance", param);
+    setHelpstring("pixels_X", "Number of detector pixels along X");  // complete la liste de infobulles de la classe
+    setHelpstring("pixels_Y", "Number of detector pixels along Y");
+    setHelpstring("pixel_size_X", "Size of the detector pixels along X");
+    setHelpstring("pixel_size_Y", "Size of the detector pixels along Y");
+    setHelpstring("image_distance", "Distance of the image plane from the surface");
+    setHelpstring("lambda_bins", "Number of bins of the wavelength axis; 1 for no spectral resolution");
+    setHelpstring("lambda_min", "Lower bound of the wavelength axis");
+    setHelpstring("lambda_max", "Upper bound of the wavelength axis");
+    setImageGeometry();
+}
+
+int DetectorBase::setImageGeometry()
+{
+    Parameter param;
+    getParameter("pixels_X",param);
+    m_nx=param.value;
+    getParameter("pixels_Y",param);
+    m_ny=param.value;
+    getParameter("lambda_bins",param);
+    m_nl=param.value;
+    getParameter("pixel_size_X",param);
+    m_pixelX=param.value;
+    getParameter("pixel_size_Y",param);
+    m_pixelY=param.value;
+    getParameter("lambda_min",param);
+    m_lambdaMin=param.value;
+    getParameter("lambda_max",param);
+    m_lambdaMax=param.value;
+    getParameter("image_distance",param);
+    m_imageDistance=param.value;
+
+    m_images.clear();
+    m_outsideCount.setZero(omp_get_max_threads());
+    m_droppedCount=0;
+    if(m_nx < 1 || m_ny < 1 || m_nl < 1 || m_pixelX <= 0 || m_pixelY <= 0 || (m_nl > 1 && m_lambdaMax <= m_lambdaMin))
+    {
+        SetOptiXLastError(string("Invalid image geometry in detector ")+m_name, __FILE__, __func__, __LINE__);
+        return -1;
+    }
+    m_images.assign(omp_get_max_threads(), ArrayXd::Zero(4*m_nx*m_ny*m_nl));
+    return 0;
+}
+
+RayType& DetectorBase::transmit(RayType& ray)
+{
+    Surface::transmit(ray);
+    if(ray.m_alive)
+        depositRay(ray);
+    return ray;
+}
+
+void DetectorBase::depositRay(RayType& ray)
+{
+    int thread=omp_get_thread_num();
+    if(size_t(thread) >= m_images.size())   // no valid geometry, or more threads than at the last clearImpacts
+    {
+        #pragma omp atomic
+        ++m_droppedCount;
+        return;
+    }
+
+    RotationType& toAligned= m_previous ? m_previous->exitFrameInverse() : m_frameInverse;
+    RayType alignedRay(ray);
+    alignedRay.origin()=toAligned*ray.origin();
+    alignedRay.direction()=toAligned*ray.direction();
+    alignedRay.moveToPlane(RayType::PlaneType(VectorType::UnitZ(), -m_imageDistance));
+
+    double ix=floor(double(alignedRay.position()(0))/m_pixelX + 0.5*m_nx);
+    double iy=floor(double(alignedRay.position()(1))/m_pixelY + 0.5*m_ny);
+    double il= m_nl==1 ? 0 : floor((ray.m_wavelength-m_lambdaMin)/(m_lambdaMax-m_lambdaMin)*m_nl);
+    // the comparisons are made in double so that rays far away do not overflow the index type
+    if(ix < 0 || ix >= m_nx || iy < 0 || iy >= m_ny || il < 0 || il >= m_nl)
+    {
+        ++m_outsideCount(thread);
+        return;
+    }
+
+    Index planeSize=m_nx*m_ny*m_nl;
+    double* pixel=m_images[thread].data()+ Index(ix) + m_nx*(Index(iy) + m_ny*Index(il));
+    double Is=norm(ray.m_amplitude_S);
+    double Ip=norm(ray.m_amplitude_P);
+    complex<double> prod=conj(ray.m_amplitude_S)*ray.m_amplitude_P;
+    pixel[0]+=Is+Ip;
+    pixel[planeSize]+=Is-Ip;
+    pixel[2*planeSize]+=prod.real();
+    pixel[3*planeSize]+=prod.imag();
+}
+
+void DetectorBase::clearImpacts()
+{
+    size_t numThreads=omp_get_max_threads();
+    if(!m_images.empty() && m_images.size()!=numThreads)
+        m_images.resize(numThreads, ArrayXd::Zero(4*m_nx*m_ny*m_nl));
+    for(vector<ArrayXd>::iterator it=m_images.begin(); it!=m_images.end(); ++it)
+        it->setZero();
+    m_outsideCount.setZero(numThreads);
+    m_droppedCount=0;
+    Surface::clearImpacts();
+}
+
+ArrayXd DetectorBase::getImage(size_t dims[4])
+{
+    dims[0]=m_nx;
+    dims[1]=m_ny;
+    dims[2]=m_nl;
+    dims[3]=4;
+    ArrayXd image=ArrayXd::Zero(4*m_nx*m_ny*m_nl);
+    for(vector<ArrayXd>::iterator it=m_images.begin(); it!=m_images.end(); ++it)
+        image+=*it;
+    return image;
+}
@@ -33,7 +33,7 @@ bool OptiXError=false;
 
 
 ElementBase::ElementBase(bool transparent, string name, ElementBase* previous):m_name(name), m_previous(previous), m_next(NULL),
-                    m_parent(NULL), m_transmissive(transparent), m_isaligned(false)
+                    m_parent(NULL), m_transmissive(transparent), m_isaligned(false), m_changeCount(0)
 {
     Parameter param;
     param.type=Angle;
@@ -179,6 +179,29 @@ int ElementBase::alignFromHere(double wavelength)
     return 0;
 }
 
+void ElementBase::saveAlignment(AlignmentState& state)
+{
+    state.exitFrame=m_exitFrame;
+    state.surfaceDirect=m_surfaceDirect;
+    state.surfaceInverse=m_surfaceInverse;
+    state.translationFromPrevious=m_translationFromPrevious;
+    state.frameDirect=m_frameDirect;
+    state.frameInverse=m_frameInverse;
+    saveShapeState(state.shapeState);
+}
+
+int ElementBase::restoreAlignment(const AlignmentState& state, double wavelength)
+{
+    m_exitFrame=state.exitFrame;
+    m_surfaceDirect=state.surfaceDirect;
+    m_surfaceInverse=state.surfaceInverse;
+    m_translationFromPrevious=state.translationFromPrevious;
+    m_frameDirect=state.frameDirect;
+    m_frameInverse=state.frameInverse;
+    m_isaligned=true;
+    return restoreShapeState(state.shapeState);
+}
+
 bool ElementBase::isAligned()/**< Eventuellement retourner le pointeur du 1er élément non aligné et NULL si OK */
 {
     if(! m_isaligned )
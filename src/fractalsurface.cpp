@@ -14,8 +14,9 @@
 #include "wavefront.h"
 #include <random>
 #include <cstring>
-#define NFFT_PRECISION_DOUBLE
-#include <nfft3mp.h>
+#include <map>
+#include <mutex>
+#include <fftw3.h>
 
 extern void Init_Threads();
 
@@ -114,7 +115,51 @@ void FractalSurface::setXYfractalParams(const char* axe, const int N, const doub
         throw ParameterWarning("One at least of the exponents is  > 0 in ", __FILE__, __func__, __LINE__);
 }
 
-ArrayXXd FractalSurface::generate(int32_t xSize, double xStep, int32_t ySize, double yStep)
+/** \brief  cache of the FFTW plans used by FractalSurface::generate, indexed by the (ftNx, ftNy) transform size
+ *
+ *  Plans are created once per transform size and reused by all the subsequent realizations. They are executed on
+ *  new arrays with the fftw_execute_dft_xxx functions, which is thread safe, but their creation must be serialized
+ */
+struct FFTplanPair
+{
+    fftw_plan forward=NULL;     /**< real to complex plan */
+    fftw_plan backward=NULL;    /**< complex to real plan */
+};
+
+static std::map<std::pair<int,int>, FFTplanPair> fractalPlans;
+
+std::mutex& FFTWPlannerMutex()
+{
+    static std::mutex plannerMutex;
+    return plannerMutex;
+}
+
+static const FFTplanPair& getFractalPlans(int ftNx, int ftNy)
+{
+    std::lock_guard<std::mutex> lock(FFTWPlannerMutex());
+    FFTplanPair& plans=fractalPlans[std::make_pair(ftNx,ftNy)];
+    if(!plans.forward)
+    {
+        // FFTW arrays are row major: the X dimension, which is contiguous in the Eigen arrays, is the last one
+        int nfreq=(ftNx/2+1)*ftNy;
+        double * real=(double*) fftw_malloc(sizeof(double)*ftNx*ftNy);
+        fftw_complex* spectrum=(fftw_complex*) fftw_malloc(sizeof(fftw_complex)*nfreq);
+        plans.forward=fftw_plan_dft_r2c_2d(ftNy, ftNx, real, spectrum, FFTW_MEASURE);
+        plans.backward=fftw_plan_dft_c2r_2d(ftNy, ftNx, spectrum, real, FFTW_MEASURE);
+        fftw_free(spectrum);
+        fftw_free(real);
+    }
+    return plans;
+}
+
+/** \brief returns the index in a centered filter vector of the frequency stored at index k of an FFTW output array of size N
+ */
+static inline int centeredIndex(int k, int N)
+{
+    return N/2 + (k <= (N-1)/2 ? k : k-N);
+}
+
+ArrayXXd FractalSurface::generate(int32_t xSize, double xStep, int32_t ySize, double yStep, uint64_t seed)
 {
 
     //frequency steps unit =1 /distance unit= 1/(N*step)
@@ -131,60 +176,45 @@ ArrayXXd FractalSurface::generate(int32_t xSize, double xStep, int32_t ySize, do
 
     double sig=1./(xFilter.norm()*yFilter.norm()*sqrt(ftNx*ftNy));
     std::normal_distribution<double> normalrnd(0.,sig); //mean=0, sigma=1. après filtrage
-    std::random_device rdsource;
-    auto gauss = [&]() {return normalrnd(rdsource);};
-
-
-    //NFFT a besoin de la matrice X des positions x,y des echantillons ( ici réguliers) dans [-1/2 ,  1/2 [
-    ArrayXd xpos= ArrayXd::LinSpaced(ftNx+1,-0.5,0.5); // for convenience but the last point must not be used
-    ArrayXd ypos= ArrayXd::LinSpaced(ftNy+1,-0.5,0.5);
-
-//    std::cout << "ready to FT\n";
-
-    nfft_plan plan;
-    nfft_init_2d(&plan,ftNy,ftNx,ftNx*ftNy);
-
-//    std::cout << "Fourier plan initialized\n";
-
-    // we map here the x and y reduced coordinates of the datapoints
-    Map<ArrayXXd,0, InnerStride<2> > mapX(plan.x, ftNx,ftNy) ;  //fixed inner stride=2 for the interlaced X and Y values
-    Map<ArrayXXd,0, InnerStride<2> > mapY(plan.x+1, ftNx,ftNy) ;
-    mapX.colwise()=xpos.segment(0,ftNx);
-    mapY.rowwise()=ypos.segment(0,ftNy).transpose();
-
-    // compute psi for the given x values
-    if(plan.flags & PRE_ONE_PSI)
-        nfft_precompute_one_psi(&plan);
+    if(!seed)
+    {
+        std::random_device rdsource;   // random_device is only used for seeding, it is much too slow for the whole map
+        seed=(uint64_t(rdsource()) << 32) | rdsource();
+    }
+    std::mt19937_64 generator(seed);
+    auto gauss = [&]() {return normalrnd(generator);};
 
-    // then we map the surface and Fourier arrays
-    Map<ArrayXXd, 0, InnerStride<2> > mapSurf((double*)plan.f, ftNx, ftNy);  //this is the real part of the complex f array
-    Map<ArrayXXd, 0, InnerStride<2> > mapSurfIm((double*)plan.f +1, ftNx, ftNy);
-    mapSurf=ArrayXXd::NullaryExpr(ftNx, ftNy, gauss); // initialise the real part with a random gaussian distribution
-    mapSurfIm.setZero();        //set the imaginary part to 0
+    // The samples are on a regular grid, so a real to complex FFT is used instead of the general NFFT transform.
+    // Both transforms are unnormalized, hence the scaling sig is the same as in the former NFFT implementation
+    const FFTplanPair& plans=getFractalPlans(ftNx, ftNy);
+    int nfx=ftNx/2+1;      // the r2c transform only stores the non negative X frequencies
+    double * real=(double*) fftw_malloc(sizeof(double)*ftNx*ftNy);
+    fftw_complex* spectrum=(fftw_complex*) fftw_malloc(sizeof(fftw_complex)*nfx*ftNy);
 
-    Map<ArrayXXcd> mapFT((std::complex<double>*)plan.f_hat,ftNx,ftNy);  // map the complex Fourier array
+    Map<ArrayXXd> mapSurf(real, ftNx, ftNy);
+    mapSurf=ArrayXXd::NullaryExpr(ftNx, ftNy, gauss); // initialise the surface with a random gaussian distribution
 
     // compute the Fourier coefficient of the initial random surface
-//    std::cout << "compute spectrum\n";
-    nfft_adjoint(&plan);
-
-//    std::cout << "filter spectrum\n";
-
-    mapFT.colwise()*=xFilter.array();
-    mapFT.rowwise()*=yFilter.array();
+    fftw_execute_dft_r2c(plans.forward, real, spectrum);
 
-//    std::cout << "compute height map\n";
+    // apply the filter; frequencies are in FFTW order while the filters are centered on the zero frequency
+    Map<ArrayXXcd> mapFT((std::complex<double>*)spectrum, nfx, ftNy);
+    ArrayXd xFilt(nfx);
+    for(int k=0; k < nfx; ++k)
+        xFilt(k)=xFilter(centeredIndex(k, ftNx));
+    for(int k=0; k < ftNy; ++k)
+        mapFT.col(k)*= xFilt*yFilter(centeredIndex(k, ftNy));
 
-    nfft_trafo(&plan);
+    // compute height map
+    fftw_execute_dft_c2r(plans.backward, spectrum, real);
 
     // clip to requested size and return
     Index xorg=(ftNx-xSize)/2, yorg=(ftNy-ySize)/2;
     ArrayXXd surface=mapSurf.block(xorg,yorg, xSize, ySize);
 
-    nfft_finalize(&plan);  // ceci desalloue toute la structure plan
+    fftw_free(spectrum);
+    fftw_free(real);
 //    std::cout << "sigma=" << sqrt(surface.square().matrix().sum()/(surface.rows()*surface.cols()) )<< std::endl;
-//    std::cout << "sigma2=" << sqrt(surface.square().sum()/(surface.rows()*surface.cols()) )<< std::endl;
-//    std::cout << "sigma=" << surface.matrix().norm()/sqrt(surface.rows()*surface.cols()) << std::endl;
     return surface;
 }
 
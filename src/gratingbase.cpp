@@ -15,6 +15,7 @@
 //
 ////////////////////////////////////////////////////////////////////////////////////
 #include "gratingbase.h"
+#include "wavefront.h"
 //
 //EIGEN_DEVICE_FUNC  Surface::VectorType Pattern::gratingVector(const Surface::VectorType &position, const  Surface::VectorType &normal)
 //{
@@ -23,7 +24,24 @@
 //}
 
 
-GratingBase::GratingBase(bool transparent, string name ,Surface * previous):Surface(transparent,name, previous)
+void Pattern::gratingVectors(const Ref<const Matrix3Xd>& positions, const Ref<const Matrix3Xd>& normals, Ref<Matrix3Xd> G)
+{
+    for(Index i=0; i < positions.cols(); ++i)
+        G.col(i)=gratingVector(positions.col(i).cast<FloatType>(), normals.col(i).cast<FloatType>()).cast<double>();
+}
+
+/** \brief value of a 2D Legendre series at a normalized point, by nested Clenshaw recurrences (see Legendre2DInterpolate())
+ *  \param coefs the Nx x Ny coefficient matrix. Ny must not exceed 16 */
+static inline double LegendreValue2D(const MatrixXd& coefs, double x, double y)
+{
+    double colValues[16];
+    for(Index j=0; j < coefs.cols(); ++j)
+        colValues[j]=LegendreClenshaw(coefs.data()+j*coefs.rows(), coefs.rows(), x);
+    return LegendreClenshaw(colValues, coefs.cols(), y);
+}
+
+GratingBase::GratingBase(bool transparent, string name ,Surface * previous):Surface(transparent,name, previous),
+                m_mapHalfLength(0), m_mapHalfWidth(0), m_mapTolerance(0), m_mapMaxDegree(0), m_mapValid(false), m_mapError(0)
 {
     Parameter param;
     param.group=GratingGroup;
@@ -34,6 +52,12 @@ GratingBase::GratingBase(bool transparent, string name ,Surface * previous):Surf
     defineParameter("order_use", param);
     setHelpstring("order_align", "The grating order used for alignment ");  // complete la liste de infobulles de la classe
     setHelpstring("order_use", "The grating order used for work ");
+
+    param.flags=NotOptimizable | ArrayData;
+    param.value=0;
+    param.paramArray=new ArrayParameter; // empty array: single order mode. The ArrayParameter will be deleted with param
+    defineParameter("orders", param);
+    setHelpstring("orders", "The grating orders propagated together in multi-order mode");
 }
 
 GratingBase::~GratingBase()
@@ -42,16 +66,37 @@ GratingBase::~GratingBase()
 }
 
 
-// wavelength is the alignment wavelength
-int GratingBase::setFrameTransforms(double alWavelength)         /**< \todo to be validated */
+void GratingBase::updateOrders()
 {
-
-    //mise à jour des ordres d'alignement et d'usage
     Parameter param;
     getParameter("order_align",param);
     m_alignmentOrder=param.value;
     getParameter("order_use",param);
     m_useOrder=param.value;
+    getParameter("orders",param);
+    m_orders.clear();
+    if(param.paramArray)
+        for(int64_t i=0; i < param.paramArray->dims[0]*param.paramArray->dims[1]; ++i)
+            m_orders.push_back(int(lround(param.paramArray->data[i])));
+}
+
+int GratingBase::restoreAlignment(const AlignmentState& state, double wavelength)
+{
+    // the orders and the map are not part of the saved state, they may have changed since the last alignment
+    updateOrders();
+    int rcode=ElementBase::restoreAlignment(state, wavelength);
+    if(rcode==0)
+        rcode=updateGratingMap(); // needs the restored surface equation to compute the normals
+    return rcode;
+}
+
+// wavelength is the alignment wavelength
+int GratingBase::setFrameTransforms(double alWavelength)         /**< \todo to be validated */
+{
+
+    //mise à jour des ordres d'alignement et d'usage
+    updateOrders();
+    Parameter param;
 
     // retrouve ou définit l'orientation absolue du trièdre d'entrée
     RotationType inputFrameRot; // rotation part
@@ -167,16 +212,216 @@ int GratingBase::setFrameTransforms(double alWavelength)         /**< \todo to b
     return 0;
 }
 
+double GratingBase::getCffTheta(double Cff, double wavelength)
+{
+    double lineDensity=gratingVector(VectorType::Zero()).norm();
+    double alpha, beta, LLD=wavelength*lineDensity, C2=Cff*Cff;
+    double X,DC2=1-C2;
+    X=(sqrt(LLD*LLD*C2+DC2*DC2) -LLD)/DC2;
+    alpha=acos(X);
+   // beta=asin(Cff*sin(alpha));
+    beta=acos(X+LLD);
+    if(std::isnan(alpha) || std::isnan(beta))
+        throw ParameterException(getName()+" cannot satisfy the given Cff at wavelength "+to_string(wavelength), __FILE__, __func__, __LINE__);
+    return (alpha+beta)/2.;
+}
+
+double GratingBase::setGratingMap(double halfLength, double halfWidth, double tolerance, int maxDegree)
+{
+    m_mapValid=false;
+    if(halfLength==0)
+    {
+        m_mapHalfLength=0;
+        m_mapGx.resize(0,0);
+        m_mapGy.resize(0,0);
+        return 0;
+    }
+    if(halfLength < 0 || halfWidth <= 0)
+        throw ParameterException("the sizes of the mapped area must be positive", __FILE__, __func__, __LINE__);
+    if(tolerance <= 0)
+        throw ParameterException("the map tolerance must be positive", __FILE__, __func__, __LINE__);
+    if(maxDegree < 1 || maxDegree > 15)
+        throw ParameterException("the maximum degree of the map must be in the range [1, 15]", __FILE__, __func__, __LINE__);
+    m_mapHalfLength=halfLength;
+    m_mapHalfWidth=halfWidth;
+    m_mapTolerance=tolerance;
+    m_mapMaxDegree=maxDegree;
+    if(!m_isaligned)
+        return 0;
+    try
+    {
+        buildGratingMap();
+    }
+    catch(...)
+    {
+        m_mapHalfLength=0;  // a map which cannot be built is removed, so that the next alignments do not fail
+        throw;
+    }
+    return m_mapError;
+}
+
+int GratingBase::updateGratingMap()
+{
+    if(m_mapHalfLength <= 0 || (m_mapValid && m_mapParameters==mapParameterValues()))
+        return 0;
+    try
+    {
+        buildGratingMap();
+    }
+    catch(OptixException& ex)
+    {
+        SetOptiXLastError(getName()+" grating vector map cannot be built: "+ex.what(), __FILE__, __func__);
+        return -1;
+    }
+    return 0;
+}
+
+void GratingBase::buildGratingMap()
+{
+    m_mapValid=false;
+    // the exact vectors are computed on a grid of n x n points. The fit uses the m x m points of even indexes, the other points check the accuracy
+    int m=2*m_mapMaxDegree+3, n=2*m-1;
+    ArrayXd X=ArrayXd::LinSpaced(n, -m_mapHalfLength, m_mapHalfLength);
+    ArrayXd Y=ArrayXd::LinSpaced(n, -m_mapHalfWidth, m_mapHalfWidth);
+    Matrix3Xd positions(3, n*n), normals(3, n*n), G(3, n*n);
+    VectorType dir=m_surfaceDirect.linear()*VectorType::UnitZ(), org=VectorType::Zero(), normal;
+    for(int j=0; j < n; ++j)
+        for(int i=0; i < n; ++i)
+        {
+            org << X(i), Y(j), 0;
+            RayBaseType ray(m_surfaceDirect*org, dir);
+            positions.col(i+n*j)=(m_surfaceInverse*intercept(ray, &normal)).cast<double>();
+            if(!ray.m_alive)
+                throw ParameterException("the mapped area is not entirely on the surface", __FILE__, __func__, __LINE__);
+            normals.col(i+n*j)=(m_surfaceInverse.linear()*normal).cast<double>();
+        }
+    gratingVectors(positions, normals, G);
+    double scale=G.colwise().norm().maxCoeff();
+
+    ArrayXXd gridX(m, m), gridY(m, m);
+    for(int j=0; j < m; ++j)
+        for(int i=0; i < m; ++i)
+        {
+            gridX(i,j)=G(0, 2*i+2*n*j);
+            gridY(i,j)=G(1, 2*i+2*n*j);
+        }
+    for(int degree=1; degree <= m_mapMaxDegree; ++degree)
+    {
+        m_mapGx=LegendreFitGrid(degree+1, degree+1, gridX).matrix();
+        m_mapGy=LegendreFitGrid(degree+1, degree+1, gridY).matrix();
+        double error=0;
+        for(int j=0; j < n; ++j)
+            for(int i=0; i < n; ++i)
+            {
+                double x=-1.+2.*i/(n-1), y=-1.+2.*j/(n-1);
+                Vector3d N=normals.col(i+n*j), Gmap;
+                Gmap(0)=LegendreValue2D(m_mapGx, x, y);
+                Gmap(1)=LegendreValue2D(m_mapGy, x, y);
+                Gmap(2)=-(Gmap(0)*N(0)+Gmap(1)*N(1))/N(2);
+                error=max(error, (Gmap-G.col(i+n*j)).norm());
+            }
+        m_mapError= scale > 0 ? error/scale : error;
+        if(m_mapError <= m_mapTolerance)
+        {
+            m_mapValid=true;
+            m_mapParameters=mapParameterValues();
+            return;
+        }
+    }
+    throw ParameterException(string("the grating vector map cannot reach the tolerance with the maximum degree (relative error ")
+                             +to_string(m_mapError)+")", __FILE__, __func__, __LINE__);
+}
+
+vector<double> GratingBase::mapParameterValues()
+{
+    vector<double> values;
+    for(ParamIterator it=parameterBegin(); it!=parameterEnd(); ++it)
+    {
+        Parameter& param=it->second;
+        if(param.group!=ShapeGroup && param.group!=GratingGroup)
+            continue;
+        if(param.flags & ArrayData)
+        {
+            ArrayParameter& array=*param.paramArray;
+            values.push_back(array.dims[0]);
+            values.push_back(array.dims[1]);
+            values.insert(values.end(), array.data, array.data+array.dims[0]*array.dims[1]);
+        }
+        else
+            values.push_back(param.value);
+    }
+    return values;
+}
+
+GratingBase::VectorType GratingBase::mappedGratingVector(const VectorType& position, const VectorType& normal)
+{
+    if(m_mapValid)
+    {
+        double x=position(0)/m_mapHalfLength, y=position(1)/m_mapHalfWidth;
+        if(abs(x) <= 1. && abs(y) <= 1. && normal(2)!=0)
+        {
+            VectorType G;
+            G(0)=LegendreValue2D(m_mapGx, x, y);
+            G(1)=LegendreValue2D(m_mapGy, x, y);
+            G(2)=-(G(0)*normal(0)+G(1)*normal(1))/normal(2);   // G is tangent to the surface
+            return G;
+        }
+    }
+    return gratingVector(position, normal);
+}
+
 RayType& GratingBase::transmit(RayType& ray)
+{
+    return transmitOrder(ray, m_useOrder);
+}
+
+RayType& GratingBase::reflect(RayType& ray)
+{
+    return reflectOrder(ray, m_useOrder);
+}
+
+int GratingBase::propagate(RayType& ray)
+{
+    if(m_orders.empty())
+        return Surface::propagate(ray);
+
+    int losses=0;
+    RayType incident(ray);
+    for(int order : m_orders)
+    {
+        ray=incident;
+        try {
+            if(m_transmissive)
+                 transmitOrder(ray, order);
+            else
+                reflectOrder(ray, order);
+        } // propagation stopped by rethrowing the exception
+        catch (InterceptException & excpt){
+            throw excpt;
+        } catch(RayException &excpt) {
+            throw excpt;
+        }
+        catch(...){
+            throw RayException(string("Unexpected exception in surface ")+ m_name, __FILE__, __func__, __LINE__);
+        }
+        // each child is propagated even though it could be dead in order to keep the same ray index in all impact vectors
+        int childLosses= (m_next!=NULL) ? m_next->propagate(ray) : !ray.m_alive;
+        m_lostCount+=childLosses;
+        losses+=childLosses;
+    }
+    return losses;
+}
+
+RayType& GratingBase::transmitOrder(RayType& ray, int order)
 {
 
     VectorType normal;
     ray-=m_translationFromPrevious;
+    ray.m_order=order;
     intercept(ray, &normal);    // intercept n'effectue plus le changement de repère entrée/sortie
     if(ray.m_alive) // (update seulement si alive)
     {
-        if(m_recording==RecordInput)
-            m_impacts.push_back(ray);
+        recordImpact(ray, RecordInput);
 
         Vector2d pos=(m_surfaceInverse*ray.position()).head(2).cast<double>();
 
@@ -198,7 +443,7 @@ RayType& GratingBase::transmit(RayType& ray)
             ray.m_amplitude_S*=T;
         }
 
-        VectorType G=m_surfaceDirect*gratingVector(m_surfaceInverse*ray.position(), m_surfaceInverse*normal)*m_useOrder*ray.m_wavelength; // le vecteur réseau exprimé dans le repère de calcul (absolu local)
+        VectorType G=m_surfaceDirect*mappedGratingVector(m_surfaceInverse*ray.position(), m_surfaceInverse*normal)*order*ray.m_wavelength; // le vecteur réseau exprimé dans le repère de calcul (absolu local)
         // G par  construction est dans le plan tangent G. Normal=0
 
             FloatType KinPerp=normal.dot(ray.direction());
@@ -219,6 +464,7 @@ RayType& GratingBase::transmit(RayType& ray)
                 Vector2cd A0, A;
                 A0 << ray.m_amplitude_S, ray.m_amplitude_P;
                 A=pol.transpose()*pol0 *A0; // les matrices pol sont unitaires
+                applyReflectance(ray, KinPerp, A);
                 ray.m_amplitude_S=A(0);
                 ray.m_amplitude_P=A(1);
                 ray.m_vector_S=ray.direction().cross(normal).normalized(); // new S direction for this element in  output space)
@@ -227,11 +473,10 @@ RayType& GratingBase::transmit(RayType& ray)
                 ray.m_alive=false; // evanescent
 
 
-        if(m_recording==RecordOutput)
-            m_impacts.push_back(ray);
+        recordImpact(ray, RecordOutput);
     }
     else if(m_recording)
-            m_impacts.push_back(ray);
+            recordLostRay(ray);
 
     if(m_OPDvalid && m_recording)
             m_OPDvalid=false;
@@ -239,16 +484,16 @@ RayType& GratingBase::transmit(RayType& ray)
     return ray;
 }
 
-RayType& GratingBase::reflect(RayType& ray)
+RayType& GratingBase::reflectOrder(RayType& ray, int order)
 {
     VectorType normal;
     ray-=m_translationFromPrevious;
+    ray.m_order=order;
     intercept(ray, &normal);    // intercept n'effectue plus le changement de repère entrée/sortie
     if(ray.m_alive)
     {
 
-        if(m_recording==RecordInput)
-            m_impacts.push_back(ray);
+        recordImpact(ray, RecordInput);
 
         Vector2d pos=(m_surfaceInverse*ray.position()).head(2).cast<double>();
 
@@ -277,7 +522,7 @@ RayType& GratingBase::reflect(RayType& ray)
 //        VectorType G=m_surfaceDirect*G0*m_useOrder*ray.m_wavelength;
 //        // le vecteur réseau exprimé dans le repère de calcul (absolu local)
 //    #else
-        VectorType G=m_surfaceDirect*gratingVector(m_surfaceInverse*ray.position(), m_surfaceInverse*normal)*m_useOrder*ray.m_wavelength; // le vecteur réseau exprimé dans le repère de calcul (absolu local)
+        VectorType G=m_surfaceDirect*mappedGratingVector(m_surfaceInverse*ray.position(), m_surfaceInverse*normal)*order*ray.m_wavelength; // le vecteur réseau exprimé dans le repère de calcul (absolu local)
         // G par  construction est dans le plan tangent G.Normal=0
 //    #endif // TEST_POLYGRATING
 
@@ -299,6 +544,7 @@ RayType& GratingBase::reflect(RayType& ray)
                 Vector2cd A0, A;
                 A0 << ray.m_amplitude_S, ray.m_amplitude_P;
                 A=pol.transpose()*pol0 *A0; // les matrices pol sont unitaires
+                applyReflectance(ray, KinPerp, A);
                 ray.m_amplitude_S=A(0);
                 ray.m_amplitude_P=A(1);
                 ray.m_vector_S=ray.direction().cross(normal).normalized(); // new S direction for this element in  output space)
@@ -307,11 +553,10 @@ RayType& GratingBase::reflect(RayType& ray)
                 ray.m_alive=false; // evanescent
 
 
-        if(m_recording==RecordOutput)
-            m_impacts.push_back(ray);
+        recordImpact(ray, RecordOutput);
     }
     else if(m_recording)
-            m_impacts.push_back(ray);
+            recordLostRay(ray);
 
     if(m_OPDvalid && m_recording)
             m_OPDvalid=false;
@@ -162,6 +162,18 @@ Surface::VectorType Holo::gratingVector(const Surface::VectorType &position, con
     return G;
 }
 
+void Holo::gratingVectors(const Ref<const Matrix3Xd>& positions, const Ref<const Matrix3Xd>& normals, Ref<Matrix3Xd> G)
+{
+    // same computation as gratingVector(), one column per point
+    Matrix3Xd du=(-m_inverseDistance1*positions).colwise()+m_direction1.cast<double>();
+    Matrix3Xd dv=(-m_inverseDistance2*positions).colwise()+m_direction2.cast<double>();
+    du.array().rowwise()/=du.colwise().norm().array();
+    dv.array().rowwise()/=dv.colwise().norm().array();
+    du-=dv;
+    RowVectorXd projection=du.cwiseProduct(normals).colwise().sum();
+    G=(du-normals*projection.asDiagonal())/m_holoWavelength;
+}
+
 void Holo::getPatternInfo(double halfLength, double halfWidth, GratingPatternInfo *patInfo)
 {
     // l'intercept avec la surface (orientée) doit être calculé dans le référentiel absolu local et ramené dans le référentiel surface
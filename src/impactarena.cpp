@@ -0,0 +1,52 @@
+////////////////////////////////////////////////////////////////////////////////
+/**
+*      \file           impactarena.cpp
+*
+*      \brief         ImpactArena class implementation
+*
+*      \author         François Polack <francois.polack@synchroton-soleil.fr>
+*      \date        2024-10-24  Creation
+*      \date        Last update
+*
+*/
+///////////////////////////////////////////////////////////////////////////////////
+//
+//             REVISIONS
+//
+////////////////////////////////////////////////////////////////////////////////////
+#include "impactarena.h"
+#include <new>
+#include <cstdlib>
+#ifdef _WIN32
+  #include <malloc.h>
+#endif
+#ifdef __linux__
+  #include <sys/mman.h>
+#endif
+
+ImpactArena::ImpactArena(size_t size, bool hugePages):m_block(NULL), m_size(size)
+{
+    const size_t alignment= hugePages ? (size_t(1) << 21) : 64;
+#ifdef _WIN32
+    m_block=(char*)_aligned_malloc(size, alignment);
+#else
+    void* block=NULL;
+    if(posix_memalign(&block, alignment, size)==0)
+        m_block=(char*)block;
+#endif
+    if(!m_block)
+        throw std::bad_alloc();
+#ifdef __linux__
+    if(hugePages)
+        madvise(m_block, size, MADV_HUGEPAGE);  // advisory only; failure is not an error
+#endif
+}
+
+ImpactArena::~ImpactArena()
+{
+#ifdef _WIN32
+    _aligned_free(m_block);
+#else
+    free(m_block);
+#endif
+}
@@ -0,0 +1,376 @@
+////////////////////////////////////////////////////////////////////////////////
+/**
+*      \file           impactfile.cpp
+*
+*      \brief         Columnar impact file writers and ImpactFileMap implementation
+*
+*      \author         François Polack <francois.polack@synchroton-soleil.fr>
+*      \date        2024-10-25  Creation
+*      \date        Last update
+*
+*/
+///////////////////////////////////////////////////////////////////////////////////
+//
+//             REVISIONS
+//
+////////////////////////////////////////////////////////////////////////////////////
+#include "impactfile.h"
+#include "surface.h"
+#include <fstream>
+#include <stdexcept>
+#include <cstring>
+#ifdef _WIN32
+  #include <windows.h>
+#else
+  #include <sys/mman.h>
+  #include <sys/stat.h>
+  #include <fcntl.h>
+  #include <unistd.h>
+#endif
+#ifdef HAS_HIGH5
+  #include <H5Easy.hpp>
+#endif // HAS_HIGH5
+
+#define IMPACT_FILE_VERSION 2
+#define IMPACT_BLOCK_SIZE (1 << 18)     // number of rays converted and written at once
+
+static const char ImpactFileMagic[8]={'O','P','T','X','I','M','P','C'};
+static const char* ImpactColumnNames[ColumnOrder+1]={"X", "Y", "Z", "Distance", "DX", "DY", "DZ", "Wavelength", "Intensity",
+                                                     "ReS", "ImS", "ReP", "ImP", "SX", "SY", "SZ", "Alive", "Order"};
+
+/** \brief returns the \ref ImpactField flag a scalar column belongs to */
+static uint32_t columnField(int column)
+{
+    if(column <= ColumnDistance)
+        return ImpactPosition;
+    if(column <= ColumnDZ)
+        return ImpactDirection;
+    if(column==ColumnWavelength)
+        return ImpactWavelength;
+    if(column==ColumnIntensity)
+        return ImpactIntensity;
+    return ImpactPolarization;
+}
+
+/** \brief returns the offset of the order column from the beginning of the alive column */
+static inline uint64_t orderColumnOffset(uint64_t numRays)
+{
+    return ((numRays+63)/64)*64;
+}
+
+/** \brief returns the value of a scalar column for a ray */
+static inline FloatType columnValue(RayType& ray, int column)
+{
+    switch(column)
+    {
+    case ColumnX: case ColumnY: case ColumnZ:
+        return ray.origin()(column-ColumnX);
+    case ColumnDistance:
+        return ray.parameter();
+    case ColumnDX: case ColumnDY: case ColumnDZ:
+        return ray.direction()(column-ColumnDX);
+    case ColumnWavelength:
+        return ray.m_wavelength;
+    case ColumnIntensity:
+        return norm(ray.m_amplitude_S)+norm(ray.m_amplitude_P);
+    case ColumnReS:
+        return ray.m_amplitude_S.real();
+    case ColumnImS:
+        return ray.m_amplitude_S.imag();
+    case ColumnReP:
+        return ray.m_amplitude_P.real();
+    case ColumnImP:
+        return ray.m_amplitude_P.imag();
+    default:
+        return ray.m_vector_S(column-ColumnSX);
+    }
+}
+
+/** \brief converts a block of impacts to column buffers
+ *
+ * \param surface the recording surface
+ * \param start index of the first impact of the block
+ * \param count number of impacts in the block
+ * \param frame the output frame
+ * \param columns the list of the output column identifiers
+ * \param buffers the column buffers, each one of at least count values
+ * \param alive the buffer of the alive flags
+ * \param orders the buffer of the diffraction orders
+ */
+template<typename Scalar>
+static void convertBlock(Surface& surface, size_t start, Index count, FrameID frame, const vector<int>& columns,
+                         vector<vector<Scalar> >& buffers, vector<uint8_t>& alive, vector<int16_t>& orders)
+{
+    #pragma omp parallel for schedule(static)
+    for(Index i=0; i < count; ++i)
+    {
+        RayType ray=surface.getImpactInFrame(start+i, frame);
+        for(size_t k=0; k < columns.size(); ++k)
+            buffers[k][i]=Scalar(columnValue(ray, columns[k]));
+        alive[i]=ray.m_alive;
+        orders[i]=ray.m_order;
+    }
+}
+
+template<typename Scalar>
+static void writeColumns(Surface& surface, std::ofstream& file, ImpactFileHeader& header, const vector<int>& columns, FrameID frame)
+{
+    vector<vector<Scalar> > buffers(columns.size(), vector<Scalar>(std::min<uint64_t>(header.numRays, IMPACT_BLOCK_SIZE)));
+    vector<uint8_t> alive(std::min<uint64_t>(header.numRays, IMPACT_BLOCK_SIZE));
+    vector<int16_t> orders(alive.size());
+    uint64_t aliveOffset=header.dataOffset+columns.size()*header.columnStride;
+    for(uint64_t start=0; start < header.numRays; start+=IMPACT_BLOCK_SIZE)
+    {
+        Index count=std::min<uint64_t>(header.numRays-start, IMPACT_BLOCK_SIZE);
+        convertBlock(surface, start, count, frame, columns, buffers, alive, orders);
+        for(size_t k=0; k < columns.size(); ++k)
+        {
+            file.seekp(header.dataOffset+k*header.columnStride+start*sizeof(Scalar));
+            file.write((char*)buffers[k].data(), count*sizeof(Scalar));
+        }
+        file.seekp(aliveOffset+start);
+        file.write((char*)alive.data(), count);
+        file.seekp(aliveOffset+orderColumnOffset(header.numRays)+start*sizeof(int16_t));
+        file.write((char*)orders.data(), count*sizeof(int16_t));
+        if(file.fail())
+            throw std::runtime_error("Error while writing impact file");
+    }
+}
+
+void WriteImpactFile(Surface& surface, string filename, FrameID frame, uint32_t fields, ImpactPrecision precision)
+{
+    ImpactFileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, ImpactFileMagic, sizeof(header.magic));
+    header.version=IMPACT_FILE_VERSION;
+    header.headerSize=sizeof(ImpactFileHeader);
+    header.fields=fields & ImpactAllFields;
+    header.precision= precision==Float32Precision ? Float32Precision : Float64Precision;
+    header.frame=frame;
+    header.numRays=surface.sizeImpacts();
+    strncpy(header.elementName, surface.getName().c_str(), sizeof(header.elementName)-1);
+
+    vector<int> columns;
+    for(int col=0; col < ColumnAlive; ++col)
+        if(header.fields & columnField(col))
+            columns.push_back(col);
+    for(int k=0; k < 16; ++k)
+        header.columns[k]= k < int(columns.size()) ? columns[k] : -1;
+    header.numColumns=columns.size();
+
+    size_t scalarSize= header.precision==Float32Precision ? sizeof(float) : sizeof(double);
+    header.dataOffset=((sizeof(header)+63)/64)*64;
+    header.columnStride=((header.numRays*scalarSize+63)/64)*64;
+
+    std::ofstream file(filename, std::ios::out | std::ios::binary | std::ios::trunc);
+    if(!file.is_open())
+        throw std::runtime_error(string("Can't open the file ")+filename+" for writing");
+    file.write((char*)&header, sizeof(header));
+    if(header.precision==Float32Precision)
+        writeColumns<float>(surface, file, header, columns, frame);
+    else
+        writeColumns<double>(surface, file, header, columns, frame);
+    file.close();
+    if(file.fail())
+        throw std::runtime_error(string("Error while writing impact file ")+filename);
+}
+
+#ifdef HAS_HIGH5
+template<typename Scalar>
+static void writeDatasets(Surface& surface, HighFive::Group& group, size_t numRays, const vector<int>& columns, FrameID frame)
+{
+    vector<HighFive::DataSet> datasets;
+    for(size_t k=0; k < columns.size(); ++k)
+        datasets.push_back(group.createDataSet<Scalar>(ImpactColumnNames[columns[k]], HighFive::DataSpace(numRays)));
+    HighFive::DataSet aliveSet=group.createDataSet<uint8_t>(ImpactColumnNames[ColumnAlive], HighFive::DataSpace(numRays));
+    HighFive::DataSet orderSet=group.createDataSet<int16_t>(ImpactColumnNames[ColumnOrder], HighFive::DataSpace(numRays));
+
+    size_t blockSize=std::min<size_t>(numRays, IMPACT_BLOCK_SIZE);
+    vector<vector<Scalar> > buffers(columns.size(), vector<Scalar>(blockSize));
+    vector<uint8_t> alive(blockSize);
+    vector<int16_t> orders(blockSize);
+    for(size_t start=0; start < numRays; start+=IMPACT_BLOCK_SIZE)
+    {
+        size_t count=std::min<size_t>(numRays-start, IMPACT_BLOCK_SIZE);
+        convertBlock(surface, start, count, frame, columns, buffers, alive, orders);
+        for(size_t k=0; k < columns.size(); ++k)
+        {
+            buffers[k].resize(count);
+            datasets[k].select({start}, {count}).write(buffers[k]);
+        }
+        alive.resize(count);
+        aliveSet.select({start}, {count}).write(alive);
+        orders.resize(count);
+        orderSet.select({start}, {count}).write(orders);
+    }
+}
+
+void WriteImpactHdf5(Surface& surface, string filename, FrameID frame, uint32_t fields, ImpactPrecision precision)
+{
+    fields&=ImpactAllFields;
+    vector<int> columns;
+    for(int col=0; col < ColumnAlive; ++col)
+        if(fields & columnField(col))
+            columns.push_back(col);
+    size_t numRays=surface.sizeImpacts();
+
+    H5Easy::File file(filename, H5Easy::File::Overwrite);
+    HighFive::Group group=file.createGroup("impacts");
+    int32_t iframe=frame;
+    group.createAttribute<int32_t>("frame", HighFive::DataSpace::From(iframe)).write(iframe);
+    group.createAttribute<uint32_t>("fields", HighFive::DataSpace::From(fields)).write(fields);
+    string name=surface.getName();
+    group.createAttribute<string>("element", HighFive::DataSpace::From(name)).write(name);
+
+    if(numRays==0)
+        return;
+    if(precision==Float32Precision)
+        writeDatasets<float>(surface, group, numRays, columns, frame);
+    else
+        writeDatasets<double>(surface, group, numRays, columns, frame);
+}
+#endif // HAS_HIGH5
+
+
+ImpactFileMap::ImpactFileMap(string filename)
+{
+#ifdef _WIN32
+    HANDLE hFile=CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if(hFile==INVALID_HANDLE_VALUE)
+        throw std::runtime_error(string("Can't open the file ")+filename);
+    m_fileHandle=hFile;
+    LARGE_INTEGER fileSize;
+    if(!GetFileSizeEx(hFile, &fileSize))
+    {
+        unmap();
+        throw std::runtime_error(string("Can't get the size of file ")+filename);
+    }
+    m_length=fileSize.QuadPart;
+    if(m_length >= sizeof(ImpactFileHeader))
+    {
+        m_mappingHandle=CreateFileMappingA(hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+        if(m_mappingHandle)
+            m_data=(const char*)MapViewOfFile(m_mappingHandle, FILE_MAP_READ, 0, 0, 0);
+    }
+#else
+    m_fd=open(filename.c_str(), O_RDONLY);
+    if(m_fd < 0)
+        throw std::runtime_error(string("Can't open the file ")+filename);
+    struct stat status;
+    if(fstat(m_fd, &status)!=0)
+    {
+        unmap();
+        throw std::runtime_error(string("Can't get the size of file ")+filename);
+    }
+    m_length=status.st_size;
+    if(m_length >= sizeof(ImpactFileHeader))
+    {
+        void* data=mmap(NULL, m_length, PROT_READ, MAP_SHARED, m_fd, 0);
+        if(data!=MAP_FAILED)
+            m_data=(const char*)data;
+    }
+#endif
+    if(!m_data)
+    {
+        unmap();
+        throw std::runtime_error(string("Can't map the file ")+filename);
+    }
+
+    m_header=(const ImpactFileHeader*)m_data;
+    size_t scalarSize= m_header->precision==Float32Precision ? sizeof(float) : sizeof(double);
+    bool valid= memcmp(m_header->magic, ImpactFileMagic, sizeof(ImpactFileMagic))==0 && m_header->version==IMPACT_FILE_VERSION &&
+            (m_header->precision==Float32Precision || m_header->precision==Float64Precision) && m_header->numColumns <= 16 &&
+            m_header->columnStride >= m_header->numRays*scalarSize &&
+            m_header->dataOffset+m_header->numColumns*m_header->columnStride+orderColumnOffset(m_header->numRays)
+                +m_header->numRays*sizeof(int16_t) <= m_length;
+    for(int col=0; col <= ColumnOrder; ++col)
+        m_columns[col]=NULL;
+    for(uint32_t k=0; valid && k < m_header->numColumns; ++k)
+    {
+        int col=m_header->columns[k];
+        if(col < 0 || col >= ColumnAlive)
+            valid=false;
+        else
+            m_columns[col]=m_data+m_header->dataOffset+k*m_header->columnStride;
+    }
+    if(!valid)
+    {
+        unmap();
+        throw std::runtime_error(filename+" is not a valid impact file");
+    }
+    m_columns[ColumnAlive]=m_data+m_header->dataOffset+m_header->numColumns*m_header->columnStride;
+    m_columns[ColumnOrder]=(const char*)m_columns[ColumnAlive]+orderColumnOffset(m_header->numRays);
+}
+
+ImpactFileMap::~ImpactFileMap()
+{
+    unmap();
+}
+
+void ImpactFileMap::unmap()
+{
+#ifdef _WIN32
+    if(m_data)
+        UnmapViewOfFile(m_data);
+    if(m_mappingHandle)
+        CloseHandle(m_mappingHandle);
+    if(m_fileHandle)
+        CloseHandle(m_fileHandle);
+    m_mappingHandle=m_fileHandle=NULL;
+#else
+    if(m_data)
+        munmap((void*)m_data, m_length);
+    if(m_fd >= 0)
+        close(m_fd);
+    m_fd=-1;
+#endif
+    m_data=NULL;
+    m_header=NULL;
+}
+
+const void* ImpactFileMap::column(int columnID) const
+{
+    if(columnID < 0 || columnID > ColumnOrder)
+        return NULL;
+    return m_columns[columnID];
+}
+
+template<typename Scalar>
+RayType ImpactFileMap::readRay(size_t index) const
+{
+    const Scalar* col[ColumnAlive];
+    for(int k=0; k < ColumnAlive; ++k)
+        col[k]=(const Scalar*)m_columns[k];
+
+    RayType::VectorType origin=RayType::VectorType::Zero(), direction=RayType::VectorType::UnitZ();
+    FloatType distance=0;
+    if(col[ColumnX])
+    {
+        origin << col[ColumnX][index], col[ColumnY][index], col[ColumnZ][index];
+        distance=col[ColumnDistance][index];
+    }
+    if(col[ColumnDX])
+        direction << col[ColumnDX][index], col[ColumnDY][index], col[ColumnDZ][index];
+
+    RayType ray{RayBaseType(origin, direction, distance)};
+    if(col[ColumnWavelength])
+        ray.m_wavelength=col[ColumnWavelength][index];
+    if(col[ColumnReS])
+    {
+        ray.m_amplitude_S=RayType::ComplexType(col[ColumnReS][index], col[ColumnImS][index]);
+        ray.m_amplitude_P=RayType::ComplexType(col[ColumnReP][index], col[ColumnImP][index]);
+        ray.m_vector_S << col[ColumnSX][index], col[ColumnSY][index], col[ColumnSZ][index];
+    }
+    else if(col[ColumnIntensity])
+        ray.m_amplitude_S=sqrt(double(col[ColumnIntensity][index]));
+    ray.m_alive=((const uint8_t*)m_columns[ColumnAlive])[index];
+    ray.m_order=((const int16_t*)m_columns[ColumnOrder])[index];
+    return ray;
+}
+
+RayType ImpactFileMap::getRay(size_t index) const
+{
+    if(m_header->precision==Float32Precision)
+        return readRay<float>(index);
+    return readRay<double>(index);
+}
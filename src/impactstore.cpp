@@ -0,0 +1,192 @@
+////////////////////////////////////////////////////////////////////////////////
+/**
+*      \file           impactstore.cpp
+*
+*      \brief         ImpactStore class implementation
+*
+*      \author         François Polack <francois.polack@synchroton-soleil.fr>
+*      \date        2024-10-23  Creation
+*      \date        Last update
+*
+*/
+///////////////////////////////////////////////////////////////////////////////////
+//
+//             REVISIONS
+//
+////////////////////////////////////////////////////////////////////////////////////
+#include "impactstore.h"
+
+void ImpactStore::setFormat(uint32_t fields, ImpactPrecision precision)
+{
+    m_fields=fields & ImpactAllFields;
+    m_precision=precision;
+    if(m_fields & ImpactPolarization)   // the intensity can be computed from the amplitudes
+        m_fields&= ~ImpactIntensity;
+    for(int col=0; col < NumColumns; ++col)
+    {
+        switch(col)
+        {
+        case ColX: case ColY: case ColZ: case ColDistance:
+            m_activeColumn[col]=m_fields & ImpactPosition;
+            break;
+        case ColDX: case ColDY: case ColDZ:
+            m_activeColumn[col]=m_fields & ImpactDirection;
+            break;
+        case ColWavelength:
+            m_activeColumn[col]=m_fields & ImpactWavelength;
+            break;
+        case ColIntensity:
+            m_activeColumn[col]=m_fields & ImpactIntensity;
+            break;
+        default:
+            m_activeColumn[col]=m_fields & ImpactPolarization;
+        }
+    }
+    for(int col=0; col < NumColumns; ++col)  // release the memory of the previous format
+    {
+        vector<float>().swap(m_floatColumns[col]);
+        vector<double>().swap(m_doubleColumns[col]);
+        vector<FloatType>().swap(m_longColumns[col]);
+    }
+    vector<char>().swap(m_alive);
+    vector<int16_t>().swap(m_orders);
+}
+
+template<typename Scalar>
+void ImpactStore::append(vector<Scalar>* columns, RayType& ray)
+{
+    if(m_fields & ImpactPosition)
+    {
+        for(int i=0; i < 3; ++i)
+            columns[ColX+i].push_back(Scalar(ray.origin()(i)));
+        columns[ColDistance].push_back(Scalar(ray.parameter()));
+    }
+    if(m_fields & ImpactDirection)
+        for(int i=0; i < 3; ++i)
+            columns[ColDX+i].push_back(Scalar(ray.direction()(i)));
+    if(m_fields & ImpactWavelength)
+        columns[ColWavelength].push_back(Scalar(ray.m_wavelength));
+    if(m_fields & ImpactIntensity)
+        columns[ColIntensity].push_back(Scalar(norm(ray.m_amplitude_S)+norm(ray.m_amplitude_P)));
+    if(m_fields & ImpactPolarization)
+    {
+        columns[ColReS].push_back(Scalar(ray.m_amplitude_S.real()));
+        columns[ColImS].push_back(Scalar(ray.m_amplitude_S.imag()));
+        columns[ColReP].push_back(Scalar(ray.m_amplitude_P.real()));
+        columns[ColImP].push_back(Scalar(ray.m_amplitude_P.imag()));
+        for(int i=0; i < 3; ++i)
+            columns[ColSX+i].push_back(Scalar(ray.m_vector_S(i)));
+    }
+}
+
+void ImpactStore::push_back(RayType& ray)
+{
+    m_alive.push_back(ray.m_alive);
+    m_orders.push_back(int16_t(ray.m_order));
+    switch(m_precision)
+    {
+    case Float32Precision:
+        append(m_floatColumns, ray);
+        break;
+    case Float64Precision:
+        append(m_doubleColumns, ray);
+        break;
+    default:
+        append(m_longColumns, ray);
+    }
+}
+
+template<typename Scalar>
+RayType ImpactStore::read(const vector<Scalar>* columns, size_t index) const
+{
+    RayType::VectorType origin=RayType::VectorType::Zero(), direction=RayType::VectorType::UnitZ();
+    FloatType distance=0;
+    if(m_fields & ImpactPosition)
+    {
+        origin << columns[ColX][index], columns[ColY][index], columns[ColZ][index];
+        distance=columns[ColDistance][index];
+    }
+    if(m_fields & ImpactDirection)
+        direction << columns[ColDX][index], columns[ColDY][index], columns[ColDZ][index];
+
+    RayType ray{RayBaseType(origin, direction, distance)};
+    if(m_fields & ImpactWavelength)
+        ray.m_wavelength=columns[ColWavelength][index];
+    if(m_fields & ImpactIntensity)
+        ray.m_amplitude_S=sqrt(double(columns[ColIntensity][index]));
+    if(m_fields & ImpactPolarization)
+    {
+        ray.m_amplitude_S=RayType::ComplexType(columns[ColReS][index], columns[ColImS][index]);
+        ray.m_amplitude_P=RayType::ComplexType(columns[ColReP][index], columns[ColImP][index]);
+        ray.m_vector_S << columns[ColSX][index], columns[ColSY][index], columns[ColSZ][index];
+    }
+    ray.m_alive=m_alive[index];
+    ray.m_order=m_orders[index];
+    return ray;
+}
+
+RayType ImpactStore::getRay(size_t index) const
+{
+    switch(m_precision)
+    {
+    case Float32Precision:
+        return read(m_floatColumns, index);
+    case Float64Precision:
+        return read(m_doubleColumns, index);
+    default:
+        return read(m_longColumns, index);
+    }
+}
+
+void ImpactStore::clear()
+{
+    m_alive.clear();
+    m_orders.clear();
+    for(int col=0; col < NumColumns; ++col)
+    {
+        m_floatColumns[col].clear();
+        m_doubleColumns[col].clear();
+        m_longColumns[col].clear();
+    }
+}
+
+void ImpactStore::insert(const ImpactStore& other)
+{
+    m_alive.insert(m_alive.end(), other.m_alive.begin(), other.m_alive.end());
+    m_orders.insert(m_orders.end(), other.m_orders.begin(), other.m_orders.end());
+    for(int col=0; col < NumColumns; ++col)
+    {
+        m_floatColumns[col].insert(m_floatColumns[col].end(), other.m_floatColumns[col].begin(), other.m_floatColumns[col].end());
+        m_doubleColumns[col].insert(m_doubleColumns[col].end(), other.m_doubleColumns[col].begin(), other.m_doubleColumns[col].end());
+        m_longColumns[col].insert(m_longColumns[col].end(), other.m_longColumns[col].begin(), other.m_longColumns[col].end());
+    }
+}
+
+void ImpactStore::reserve(size_t n)
+{
+    m_alive.reserve(n);
+    m_orders.reserve(n);
+    for(int col=0; col < NumColumns; ++col)
+        if(m_activeColumn[col])
+            switch(m_precision)
+            {
+            case Float32Precision:
+                m_floatColumns[col].reserve(n);
+                break;
+            case Float64Precision:
+                m_doubleColumns[col].reserve(n);
+                break;
+            default:
+                m_longColumns[col].reserve(n);
+            }
+}
+
+size_t ImpactStore::bytesPerImpact() const
+{
+    size_t scalarSize= m_precision==Float32Precision ? sizeof(float) : (m_precision==Float64Precision ? sizeof(double) : sizeof(FloatType));
+    size_t numColumns=0;
+    for(int col=0; col < NumColumns; ++col)
+        if(m_activeColumn[col])
+            ++numColumns;
+    return numColumns*scalarSize+sizeof(char)+sizeof(int16_t);
+}
@@ -25,6 +25,10 @@
 #include "files.h"
 #include "xmlfile.h"
 #include "version.h"
+#include "montecarlo.h"
+#include "impactfile.h"
+#include "spectrum.h"
+#include "alignmentcache.h"
 #include <limits>  // pour epsilon
 
 #define NFFT_PRECISION_DOUBLE
@@ -53,6 +57,7 @@ bool enableApertureLimit=true; /**< \brief Global flag to take into account or n
 bool enableReflectivity=false;     /**<  \brief Global flag to switch on or off the computation of reflectivity  in the ray tracing computation*/
 bool enableSurfaceErrors=false; /**< \brief Global flag indicating whether the surface errors are taken into account in propagation */
 bool threadInitialized=false;   /**< \brief Global flag to keep track of Open_MP  initialization */
+set<size_t> OpenImpactFiles;   /**< \brief handles of the impact files mapped by OpenImpactFile */
 
 /** \} */ // end of InternalVar
 
@@ -587,7 +592,7 @@ extern "C"
     DLL_EXPORT bool SetRecording(size_t elementID, enum RecordMode recordingMode)
     {
         ClearOptiXError();
-        if(recordingMode <RecordNone || recordingMode > RecordOutput)
+        if(recordingMode <RecordNone || recordingMode > RecordOutputStatistics)
         {
             SetOptiXLastError("Invalid recording mode",__FILE__, __func__);
             return false ;
@@ -604,6 +609,101 @@ extern "C"
         return true;
     }
 
+    DLL_EXPORT bool SetRecordingFormat(size_t elementID, enum RecordMode recordingMode, uint32_t fields, enum ImpactPrecision precision)
+    {
+        ClearOptiXError();
+        if(recordingMode <RecordNone || recordingMode > RecordOutputStatistics)
+        {
+            SetOptiXLastError("Invalid recording mode",__FILE__, __func__);
+            return false ;
+        }
+        if((fields & ImpactAllFields)==0 || (fields & ~uint32_t(ImpactAllFields)))
+        {
+            SetOptiXLastError("Invalid recorded field combination",__FILE__, __func__);
+            return false ;
+        }
+        if(precision <Float32Precision || precision > LongDoublePrecision)
+        {
+            SetOptiXLastError("Invalid recording precision",__FILE__, __func__);
+            return false ;
+        }
+        Surface* surf=dynamic_cast<Surface*>((ElementBase*)elementID);
+        if(!surf)
+        {
+            SetOptiXLastError("The pointed element is not an optical surface",__FILE__, __func__);
+            return false;
+        }
+        if(surf->isSource() && ((fields & ImpactAllFields)!=ImpactAllFields || precision!=LongDoublePrecision))
+        {
+            SetOptiXLastError("Sources record their rays in full format only; use SetRecording",__FILE__, __func__);
+            return false;
+        }
+        surf->setRecording(recordingMode, fields, precision);
+        return true;
+    }
+
+    DLL_EXPORT bool GetRecordingFormat(size_t elementID, uint32_t *fields, enum ImpactPrecision *precision)
+    {
+        ClearOptiXError();
+        Surface* surf=dynamic_cast<Surface*>((ElementBase*)elementID);
+        if(!surf)
+        {
+            SetOptiXLastError("The pointed element is not an optical surface",__FILE__, __func__);
+            return false ;
+        }
+        *fields=surf->getRecordingFields();
+        *precision=surf->getRecordingPrecision();
+        return true;
+    }
+
+    DLL_EXPORT bool SetRecordingFilter(size_t elementID, RecordingFilter *filter)
+    {
+        ClearOptiXError();
+        Surface* surf=dynamic_cast<Surface*>((ElementBase*)elementID);
+        if(!surf)
+        {
+            SetOptiXLastError("The pointed element is not an optical surface",__FILE__, __func__);
+            return false ;
+        }
+        RecordingFilter noFilter={RoiNone, AlignedLocalFrame, {0,0}, {0,0}, 1, 1., 0, 0, 0, 0};
+        try
+        {
+            surf->setRecordingFilter(filter ? *filter : noFilter);
+        }
+        catch(ParameterException & excpt)
+        {
+            SetOptiXLastError(excpt.what(), __FILE__, __func__);
+            return false;
+        }
+        return true;
+    }
+
+    DLL_EXPORT bool SetImpactOrderSelection(size_t elementID, bool active, int32_t order)
+    {
+        ClearOptiXError();
+        Surface* surf=dynamic_cast<Surface*>((ElementBase*)elementID);
+        if(!surf)
+        {
+            SetOptiXLastError("The pointed element is not an optical surface",__FILE__, __func__);
+            return false ;
+        }
+        surf->setOrderSelection(active, order);
+        return true;
+    }
+
+    DLL_EXPORT bool GetRecordingFilter(size_t elementID, RecordingFilter *filter)
+    {
+        ClearOptiXError();
+        Surface* surf=dynamic_cast<Surface*>((ElementBase*)elementID);
+        if(!surf)
+        {
+            SetOptiXLastError("The pointed element is not an optical surface",__FILE__, __func__);
+            return false ;
+        }
+        *filter=surf->getRecordingFilter();
+        return true;
+    }
+
     DLL_EXPORT bool SetParameter(size_t elementID, const char* paramTag,  Parameter paramData)
     {
         ClearOptiXError();
@@ -979,19 +1079,124 @@ extern "C"
         cout << "Central line density =" << lineDensity << endl;
         Parameter theta;
         pGrating->getParameter("theta", theta);
-        double alpha, beta, LLD=wavelength*lineDensity, C2=Cff*Cff;
-        double X,DC2=1-C2;
-        X=(sqrt(LLD*LLD*C2+DC2*DC2) -LLD)/DC2;
-        alpha=acos(X);
-       // beta=asin(Cff*sin(alpha));
-        beta=acos(X+LLD);
-        theta.value=(alpha+beta)/2.;
+        try
+        {
+            theta.value=pGrating->getCffTheta(Cff, wavelength);
+        }
+        catch(ParameterException& ex)
+        {
+            SetOptiXLastError(ex.what(), __FILE__, __func__);
+            return false;
+        }
         cout << "Half deviation angle " << theta.value << endl;
         pGrating->setParameter("theta", theta);
 
         return true;
     }
 
+    static set<AlignmentCache*> AlignmentCaches; // caches created by CreateAlignmentCache(), used to validate the handles
+
+    DLL_EXPORT bool CreateAlignmentCache(size_t elementID, int32_t numWavelengths, const double* wavelengths, size_t gratingID, double Cff,
+                                         size_t* cacheHandle)
+    {
+        ClearOptiXError();
+        if(!System.isValidID(elementID))
+        {
+            SetOptiXLastError("Invalid element ID", __FILE__, __func__);
+            return false;
+        }
+        if(numWavelengths <= 0 || !wavelengths || !cacheHandle)
+        {
+            SetOptiXLastError("Invalid wavelength array or cache handle", __FILE__, __func__);
+            return false;
+        }
+        GratingBase *pGrating=NULL;
+        if(gratingID)
+        {
+            if(!System.isValidID(gratingID))
+            {
+                SetOptiXLastError("Invalid grating ID", __FILE__, __func__);
+                return false;
+            }
+            pGrating= dynamic_cast<GratingBase*>((ElementBase*) gratingID);
+            if(!pGrating)
+            {
+                SetOptiXLastError("Element is not a grating", __FILE__, __func__);
+                return false;
+            }
+        }
+        AlignmentCache* cache=new AlignmentCache;
+        try
+        {
+            cache->build((ElementBase*) elementID, vector<double>(wavelengths, wavelengths+numWavelengths), pGrating, Cff);
+        }
+        catch(ParameterException& ex)
+        {
+            delete cache;
+            SetOptiXLastError(ex.what(), __FILE__, __func__);
+            return false;
+        }
+        catch(ElementException& ex)
+        {
+            delete cache;
+            SetOptiXLastError(ex.what(), __FILE__, __func__);
+            return false;
+        }
+        AlignmentCaches.insert(cache);
+        *cacheHandle=(size_t) cache;
+        return true;
+    }
+
+    DLL_EXPORT bool ApplyAlignmentCache(size_t cacheHandle, int32_t index)
+    {
+        ClearOptiXError();
+        AlignmentCache* cache=(AlignmentCache*) cacheHandle;
+        if(!AlignmentCaches.count(cache))
+        {
+            SetOptiXLastError("Invalid alignment cache handle", __FILE__, __func__);
+            return false;
+        }
+        for(ElementBase* pElem : cache->getElements())
+            if(!System.isValidID((size_t) pElem))
+            {
+                SetOptiXLastError("An element of the cached chain was deleted", __FILE__, __func__);
+                return false;
+            }
+        if(index < 0)
+        {
+            SetOptiXLastError("Invalid wavelength index", __FILE__, __func__);
+            return false;
+        }
+        try
+        {
+            cache->apply(size_t(index));
+        }
+        catch(ParameterException& ex)
+        {
+            SetOptiXLastError(ex.what(), __FILE__, __func__);
+            return false;
+        }
+        catch(ElementException& ex)
+        {
+            SetOptiXLastError(ex.what(), __FILE__, __func__);
+            return false;
+        }
+        return true;
+    }
+
+    DLL_EXPORT bool ReleaseAlignmentCache(size_t cacheHandle)
+    {
+        ClearOptiXError();
+        AlignmentCache* cache=(AlignmentCache*) cacheHandle;
+        if(!AlignmentCaches.erase(cache))
+        {
+            SetOptiXLastError("Invalid alignment cache handle", __FILE__, __func__);
+            return false;
+        }
+        delete cache;
+        return true;
+    }
+
     DLL_EXPORT bool EmulateUndulator(size_t elementID, double sigmaX, double sigmaY, double sigmaprimX, double sigmaprimY,
                                      double undulatorLength,  double SD_UndulatorDistance, double wavelength, double detuning=1.4)
     {
@@ -1063,6 +1268,63 @@ extern "C"
     }
 
 
+    DLL_EXPORT bool SetSourceFile(size_t elementID, const char* filename)
+    {
+        ClearOptiXError();
+        if(!System.isValidID(elementID))
+        {
+            SetOptiXLastError("Invalid element ID", __FILE__, __func__);
+            return false;
+        }
+        FileSource* source=dynamic_cast<FileSource*>((ElementBase*)elementID);
+        if(!source)
+        {
+            SetOptiXLastError("Element is not a file source", __FILE__, __func__);
+            return false;
+        }
+        try
+        {
+            source->setFile(filename);
+        }
+        catch(ParameterException & excpt)
+        {
+            SetOptiXLastError(excpt.what(), __FILE__, __func__);
+            return false;
+        }
+        catch(std::runtime_error & excpt)
+        {
+            SetOptiXLastError(excpt.what(), __FILE__, __func__);
+            return false;
+        }
+        return true;
+    }
+
+    DLL_EXPORT bool SetPhaseSpaceTable(size_t elementID, int32_t numDims, const int64_t* dims, const double* bounds, const double* density)
+    {
+        ClearOptiXError();
+        if(!System.isValidID(elementID))
+        {
+            SetOptiXLastError("Invalid element ID", __FILE__, __func__);
+            return false;
+        }
+        PhaseSpaceSource* source=dynamic_cast<PhaseSpaceSource*>((ElementBase*)elementID);
+        if(!source)
+        {
+            SetOptiXLastError("Element is not a phase space source", __FILE__, __func__);
+            return false;
+        }
+        try
+        {
+            source->setTable(numDims, dims, bounds, density);
+        }
+        catch(ParameterException & excpt)
+        {
+            SetOptiXLastError(excpt.what(), __FILE__, __func__);
+            return false;
+        }
+        return true;
+    }
+
     DLL_EXPORT bool Generate(size_t elementID, double wavelength, int *numRays)
     {
         ClearOptiXError();
@@ -1084,10 +1346,17 @@ extern "C"
             return false;
         }
 //        printf("generating rays in %s  at WL %g \n", ((ElementBase*)elementID)->getName().c_str(),wavelength );
-        if(numRays)
-            *numRays=dynamic_cast<SourceBase*>((ElementBase*)elementID)->generate(wavelength );
-        else
-            dynamic_cast<SourceBase*>((ElementBase*)elementID)->generate(wavelength );
+        try
+        {
+            int nRays=dynamic_cast<SourceBase*>((ElementBase*)elementID)->generate(wavelength );
+            if(numRays)
+                *numRays=nRays;
+        }
+        catch(ParameterException & excpt)
+        {
+            SetOptiXLastError(excpt.what(), __FILE__, __func__);
+            return false;
+        }
         return true;
     }
 
@@ -1118,10 +1387,17 @@ extern "C"
             return false;
         }
 //             printf("generating rays in %s  at WL %g \n", ((ElementBase*)elementID)->getName().c_str(),wavelength );
-        if(numRays)
-           *numRays=dynamic_cast<SourceBase*>((ElementBase*)elementID)->generate(wavelength,polar );
-        else
-           dynamic_cast<SourceBase*>((ElementBase*)elementID)->generate(wavelength,polar );
+        try
+        {
+            int nRays=dynamic_cast<SourceBase*>((ElementBase*)elementID)->generate(wavelength,polar );
+            if(numRays)
+                *numRays=nRays;
+        }
+        catch(ParameterException & excpt)
+        {
+            SetOptiXLastError(excpt.what(), __FILE__, __func__);
+            return false;
+        }
         return true;
     }
 
@@ -1148,6 +1424,9 @@ extern "C"
         }catch (InterceptException &excpt){
             SetOptiXLastError(excpt.what()+"\nPropagation interrupted", __FILE__, __func__, __LINE__);
             return false;
+        }catch (ParameterException &excpt){
+            SetOptiXLastError(excpt.what(), __FILE__, __func__, __LINE__);
+            return false;
         }
         if(losses==0)
             return true;
@@ -1189,16 +1468,220 @@ extern "C"
         }catch (InterceptException &excpt){
             SetOptiXLastError(excpt.what()+"\nPropagation interrupted", __FILE__, __func__, __LINE__);
             return false;
+        }catch (ParameterException &excpt){
+            SetOptiXLastError(excpt.what(), __FILE__, __func__, __LINE__);
+            return false;
+        }
+        if(losses==0)
+            return true;
+        else
+        {
+            char buffer[80];
+            sprintf(buffer,"WARNING: %d rays lost in propagation", losses);
+            SetOptiXLastError(buffer, __FILE__, __func__,__LINE__);
+            return false;
+        }
+    }
+
+    /** \brief copies a SpotStatistics object into the C interface structure */
+    static void CopySpotStatistics(const SpotStatistics& total, C_SpotStatistics * stats)
+    {
+        Matrix4d covariance=total.covariance();
+        stats->count=total.m_count;
+        stats->lost=total.m_lost;
+        Map<Vector4d>(stats->mean)=total.m_mean;
+        Map<Vector4d>(stats->sigma)=covariance.diagonal().cwiseSqrt();
+        Map<Vector4d>(stats->min)=total.m_min;
+        Map<Vector4d>(stats->max)=total.m_max;
+        Map<Matrix4d>(stats->covariance)=covariance;
+    }
+
+    DLL_EXPORT bool RadiateSpectrum(size_t sourceID, int32_t numWavelengths, const double* wavelengths, const double* weights,
+                                    double alignmentWavelength, size_t targetID, C_SpotStatistics* statistics)
+    {
+        ClearOptiXError();
+        if(!System.isValidID(sourceID))
+        {
+            SetOptiXLastError("Invalid element ID", __FILE__, __func__, __LINE__);
+            return false;
+        }
+        if( !((ElementBase*)sourceID)->isSource())
+        {
+            SetOptiXLastError("Element is not a source", __FILE__, __func__, __LINE__);
+            return false;
+        }
+        if(numWavelengths < 1 || !wavelengths || (targetID && !statistics))
+        {
+            SetOptiXLastError("Invalid argument", __FILE__, __func__, __LINE__);
+            return false;
+        }
+        Surface* target=NULL;
+        if(targetID)
+        {
+            target=System.isValidID(targetID) ? dynamic_cast<Surface*>((ElementBase*) targetID) : NULL;
+            if(!target)
+            {
+                SetOptiXLastError("Target is not a valid Surface", __FILE__, __func__, __LINE__);
+                return false;
+            }
+        }
+        vector<double> wavelengthList(wavelengths, wavelengths+numWavelengths), weightList;
+        if(weights)
+            weightList.assign(weights, weights+numWavelengths);
+        vector<SpotStatistics> stats(target ? numWavelengths : 0);
+        int64_t losses;
+        try {
+            losses=RadiateSpectrum(dynamic_cast<SourceBase*>((ElementBase*)sourceID), wavelengthList, weightList, alignmentWavelength,
+                                   target, target ? stats.data() : NULL);
+        }
+        catch(RayException &excpt) {
+            SetOptiXLastError(excpt.what()+"\nPropagation interrupted", __FILE__, __func__, __LINE__);
+            return false;
+        }catch (ParameterException &excpt){
+            SetOptiXLastError(excpt.what(), __FILE__, __func__, __LINE__);
+            return false;
+        }catch (ElementException &excpt){
+            SetOptiXLastError(excpt.what(), __FILE__, __func__, __LINE__);
+            return false;
         }
+        for(size_t i=0; i < stats.size(); ++i)
+            CopySpotStatistics(stats[i], statistics+i);
         if(losses==0)
             return true;
         else
         {
-            char buffer[80];
-            sprintf(buffer,"WARNING: %d rays lost in propagation", losses);
-            SetOptiXLastError(buffer, __FILE__, __func__,__LINE__);
+            char buffer[80];
+            sprintf(buffer,"WARNING: %lld rays lost in propagation", (long long) losses);
+            SetOptiXLastError(buffer, __FILE__, __func__,__LINE__);
+            return false;
+        }
+    }
+
+    DLL_EXPORT bool AllocateImpactArena(size_t sourceID, size_t numRays, bool hugePages)
+    {
+        ClearOptiXError();
+        if(!System.isValidID(sourceID))
+        {
+            SetOptiXLastError("Invalid element ID", __FILE__, __func__, __LINE__);
+            return false;
+        }
+        Surface* surf=dynamic_cast<Surface*>((ElementBase*)sourceID);
+        if(!surf)
+        {
+            SetOptiXLastError("The pointed element is not an optical surface",__FILE__, __func__);
+            return false ;
+        }
+        try
+        {
+            surf->allocateImpactArena(numRays, hugePages);
+        }
+        catch(ElementException & excpt)
+        {
+            SetOptiXLastError(excpt.what(), __FILE__, __func__);
+            return false;
+        }
+        catch(std::bad_alloc &)
+        {
+            SetOptiXLastError("Impact arena allocation failed", __FILE__, __func__, __LINE__);
+            return false;
+        }
+        return true;
+    }
+
+    DLL_EXPORT bool ReleaseImpactArena(size_t sourceID)
+    {
+        ClearOptiXError();
+        if(!System.isValidID(sourceID))
+        {
+            SetOptiXLastError("Invalid element ID", __FILE__, __func__, __LINE__);
+            return false;
+        }
+        Surface* surf=dynamic_cast<Surface*>((ElementBase*)sourceID);
+        if(!surf)
+        {
+            SetOptiXLastError("The pointed element is not an optical surface",__FILE__, __func__);
+            return false ;
+        }
+        try
+        {
+            surf->releaseImpactArena();
+        }
+        catch(ElementException & excpt)
+        {
+            SetOptiXLastError(excpt.what(), __FILE__, __func__);
+            return false;
+        }
+        return true;
+    }
+
+    DLL_EXPORT bool RunToleranceMonteCarlo(size_t sourceID, size_t targetID, double wavelength, double distance,
+                                           int32_t numParams, const ToleranceParameter* params,
+                                           int32_t numErrorSurfaces, const size_t* errorSurfaceIDs, bool random_zernike,
+                                           int32_t numRealizations, uint64_t* seed, ToleranceResult* results,
+                                           ToleranceResult* meanResult, ToleranceResult* sigmaResult)
+    {
+        ClearOptiXError();
+        if(!System.isValidID(sourceID) || !System.isValidID(targetID))
+        {
+            SetOptiXLastError("Invalid element ID", __FILE__, __func__, __LINE__);
+            return false;
+        }
+        if( !((ElementBase*)sourceID)->isSource())
+        {
+            SetOptiXLastError("Element is not a source", __FILE__, __func__, __LINE__);
+            return false;
+        }
+        Surface* target=dynamic_cast<Surface*>((ElementBase*) targetID);
+        if(!target)
+        {
+            SetOptiXLastError(string("Element ")+((ElementBase*) targetID)->getName()+" is not a Surface", __FILE__, __func__, __LINE__);
+            return false;
+        }
+        if(wavelength <=0)
+        {
+            SetOptiXLastError("Invalid wavelength", __FILE__, __func__, __LINE__);
+            return false;
+        }
+        if(numRealizations <1 || !seed || !results || !meanResult || !sigmaResult || (numParams >0 && !params) ||
+           (numErrorSurfaces >0 && !errorSurfaceIDs))
+        {
+            SetOptiXLastError("Invalid argument", __FILE__, __func__, __LINE__);
+            return false;
+        }
+        vector<ToleranceParameter> tolParams;
+        for(int32_t i=0; i < numParams; ++i)
+        {
+            if(!System.isValidID(params[i].elementID))
+            {
+                SetOptiXLastError(string("Invalid element ID in tolerance parameter ")+std::to_string(i), __FILE__, __func__, __LINE__);
+                return false;
+            }
+            tolParams.push_back(params[i]);
+        }
+        vector<Surface*> errorSurfaces;
+        for(int32_t i=0; i < numErrorSurfaces; ++i)
+        {
+            Surface* psurf=System.isValidID(errorSurfaceIDs[i]) ? dynamic_cast<Surface*>((ElementBase*) errorSurfaceIDs[i]) : NULL;
+            if(!psurf)
+            {
+                SetOptiXLastError(string("Error surface ")+std::to_string(i)+" is not a valid Surface", __FILE__, __func__, __LINE__);
+                return false;
+            }
+            errorSurfaces.push_back(psurf);
+        }
+
+        int nValid;
+        try
+        {
+            nValid=ToleranceMonteCarlo(dynamic_cast<SourceBase*>((ElementBase*)sourceID), target, wavelength, distance, tolParams,
+                                       errorSurfaces, random_zernike, numRealizations, *seed, results, *meanResult, *sigmaResult);
+        }
+        catch(ParameterException &excpt)
+        {
+            SetOptiXLastError(excpt.what(), __FILE__, __func__, __LINE__);
             return false;
         }
+        return nValid > 0;
     }
 
     DLL_EXPORT bool GetSpotDiagram(size_t elementID,  C_DiagramStruct * diagram, double distance)
@@ -1236,6 +1719,61 @@ extern "C"
         return false;
     }
 
+    DLL_EXPORT bool GetSpotStatistics(size_t elementID, C_SpotStatistics * stats)
+    {
+        ClearOptiXError();
+        if(!System.isValidID(elementID))
+        {
+            SetOptiXLastError("Invalid element ID", __FILE__, __func__, __LINE__);
+            return false;
+        }
+        Surface * surf=dynamic_cast<Surface*>((ElementBase*)elementID);
+        if(!surf)
+        {
+            SetOptiXLastError("Element cannot record impacts (not a surface) ", __FILE__, __func__);
+            return false;
+        }
+        if(surf->getRecording() < RecordInputStatistics)
+        {
+            SetOptiXLastError("Element is not recording statistics", __FILE__, __func__);
+            return false;
+        }
+        CopySpotStatistics(surf->getSpotStatistics(), stats);
+        return true;
+    }
+
+    DLL_EXPORT bool GetDetectorImage(size_t elementID, C_ndArray * image, int64_t * outsideCount, int64_t * droppedCount)
+    {
+        ClearOptiXError();
+        if(!System.isValidID(elementID))
+        {
+            SetOptiXLastError("Invalid element ID", __FILE__, __func__, __LINE__);
+            return false;
+        }
+        DetectorBase * detector=dynamic_cast<DetectorBase*>((ElementBase*)elementID);
+        if(!detector)
+        {
+            SetOptiXLastError("Element is not a detector", __FILE__, __func__);
+            return false;
+        }
+        size_t dims[4];
+        ArrayXd data=detector->getImage(dims);
+        size_t imageStorage=data.size()*sizeof(double)+4*sizeof(size_t);
+        if(image->allocatedStorage < imageStorage)
+        {
+            SetOptiXLastError("Allocated storage for image is to small for the detector image size", __FILE__, __func__);
+            return false;
+        }
+        image->ndims=4;
+        memcpy(image->storage, dims, 4*sizeof(size_t));
+        memcpy((char*)image->storage+4*sizeof(size_t), data.data(), data.size()*sizeof(double));
+        if(outsideCount)
+            *outsideCount=detector->getOutsideCount();
+        if(droppedCount)
+            *droppedCount=detector->getDroppedCount();
+        return true;
+    }
+
     DLL_EXPORT bool GetImpactsData(size_t elementID,  C_DiagramStruct * diagram, enum FrameID frame)
     {
         ClearOptiXError();
@@ -1275,7 +1813,42 @@ extern "C"
                                     double* xbound, double * ybound)
     {
         ClearOptiXError();
+        if(!System.isValidID(elementID))
+        {
+            SetOptiXLastError("Invalid element ID", __FILE__, __func__, __LINE__);
+            return false;
+        }
+        Surface * surf=dynamic_cast<Surface*>((ElementBase*)elementID);
+        if(!surf)
+        {
+            SetOptiXLastError("Element is not a surface) ", __FILE__, __func__, __LINE__);
+            return false;
+        }
 
+        if(surf->getRecording()!=RecordInput && surf->getRecording()!=RecordOutput)
+        {
+            SetOptiXLastError("Element is not recording impacts", __FILE__, __func__);
+            return false;
+        }
+        if(dims[0] < 1 || dims[1] < 1 || dims[2] < 1)
+        {
+            SetOptiXLastError("Invalid focal diagram dimensions", __FILE__, __func__);
+            return false;
+        }
+        Tensor<int32_t,3> focdiag=surf->getFocalDiagram(dims, zbound, xbound, ybound);
+        memcpy(focdg, focdiag.data(), focdiag.size()*sizeof(int32_t));
+        return true;
+    }
+
+    DLL_EXPORT bool GetIntensityFocalDiagram(size_t elementID, const int dims[3], const double zbound[2], double *focdg,
+                                    double* xbound, double * ybound)
+    {
+        ClearOptiXError();
+        if(!System.isValidID(elementID))
+        {
+            SetOptiXLastError("Invalid element ID", __FILE__, __func__, __LINE__);
+            return false;
+        }
         Surface * surf=dynamic_cast<Surface*>((ElementBase*)elementID);
         if(!surf)
         {
@@ -1283,16 +1856,45 @@ extern "C"
             return false;
         }
 
-        if(surf->getRecording()==0)
+        if(surf->getRecording()!=RecordInput && surf->getRecording()!=RecordOutput)
+        {
+            SetOptiXLastError("Element is not recording impacts", __FILE__, __func__);
+            return false;
+        }
+        if(dims[0] < 1 || dims[1] < 1 || dims[2] < 1)
+        {
+            SetOptiXLastError("Invalid focal diagram dimensions", __FILE__, __func__);
+            return false;
+        }
+        Tensor<double,3> focdiag=surf->getIntensityFocalDiagram(dims, zbound, xbound, ybound);
+        memcpy(focdg, focdiag.data(), focdiag.size()*sizeof(double));
+        return true;
+    }
+
+    DLL_EXPORT bool GetBestFocus(size_t elementID, BestFocus* focus, bool intensityWeighted)
+    {
+        ClearOptiXError();
+        if(!System.isValidID(elementID))
+        {
+            SetOptiXLastError("Invalid element ID", __FILE__, __func__, __LINE__);
+            return false;
+        }
+        Surface * surf=dynamic_cast<Surface*>((ElementBase*)elementID);
+        if(!surf)
+        {
+            SetOptiXLastError("Element is not a surface) ", __FILE__, __func__, __LINE__);
+            return false;
+        }
+        if(surf->getRecording()!=RecordInput && surf->getRecording()!=RecordOutput)
         {
             SetOptiXLastError("Element is not recording impacts", __FILE__, __func__);
             return false;
         }
-        cout << "getting focal digram \n";
-        Tensor<int,3> focdiag=surf->getFocalDiagram(dims, zbound, xbound, ybound);
-        cout << "copying diagram to return array\n";
-        memcpy(focdg, focdiag.data(), dims[0]*dims[1]*dims[2]*sizeof(int));
-        cout << "returning \n";
+        if(surf->getBestFocus(*focus, intensityWeighted)==0)
+        {
+            SetOptiXLastError("No alive impact, or only impacts of null intensity, recorded on the surface", __FILE__, __func__);
+            return false;
+        }
         return true;
     }
 
@@ -1463,6 +2065,96 @@ extern "C"
         return true;
     }
 
+    DLL_EXPORT bool ExportImpacts(size_t elementID, const char* filename, enum FrameID frame, uint32_t fields, enum ImpactPrecision precision, bool hdf5)
+    {
+        ClearOptiXError();
+        if(!System.isValidID(elementID))
+        {
+            SetOptiXLastError("Invalid element ID", __FILE__, __func__, __LINE__);
+            return false;
+        }
+        Surface* surf=dynamic_cast<Surface*>((ElementBase*)elementID);
+        if(!surf)
+        {
+            SetOptiXLastError("Element cannot record impacts (not a surface) ", __FILE__, __func__, __LINE__);
+            return false;
+        }
+        if(surf->getRecording()!=RecordInput && surf->getRecording()!=RecordOutput)
+        {
+            SetOptiXLastError("Element is not recording impacts", __FILE__, __func__);
+            return false;
+        }
+        try
+        {
+            if(hdf5)
+            {
+#ifdef HAS_HIGH5
+                WriteImpactHdf5(*surf, filename, frame, fields, precision);
+#else
+                SetOptiXLastError("The library was compiled without HDF5 support", __FILE__, __func__);
+                return false;
+#endif // HAS_HIGH5
+            }
+            else
+                WriteImpactFile(*surf, filename, frame, fields, precision);
+        }
+        catch(std::exception & excpt)
+        {
+            SetOptiXLastError(excpt.what(), __FILE__, __func__);
+            return false;
+        }
+        return true;
+    }
+
+    DLL_EXPORT bool OpenImpactFile(const char* filename, size_t* handle, ImpactFileHeader* header)
+    {
+        ClearOptiXError();
+        ImpactFileMap* fileMap;
+        try
+        {
+            fileMap=new ImpactFileMap(filename);
+        }
+        catch(std::runtime_error & excpt)
+        {
+            SetOptiXLastError(excpt.what(), __FILE__, __func__);
+            return false;
+        }
+        OpenImpactFiles.insert((size_t)fileMap);
+        *handle=(size_t)fileMap;
+        if(header)
+            *header=fileMap->header();
+        return true;
+    }
+
+    DLL_EXPORT bool GetImpactFileColumn(size_t handle, enum ImpactColumn column, const void** data)
+    {
+        ClearOptiXError();
+        if(!OpenImpactFiles.count(handle))
+        {
+            SetOptiXLastError("invalid handle", __FILE__, __func__);
+            return false;
+        }
+        *data=((ImpactFileMap*)handle)->column(column);
+        if(!*data)
+        {
+            SetOptiXLastError("The column is not stored in the file", __FILE__, __func__);
+            return false;
+        }
+        return true;
+    }
+
+    DLL_EXPORT bool CloseImpactFile(size_t handle)
+    {
+        ClearOptiXError();
+        if(!OpenImpactFiles.erase(handle))
+        {
+            SetOptiXLastError("invalid handle", __FILE__, __func__);
+            return false;
+        }
+        delete (ImpactFileMap*)handle;
+        return true;
+    }
+
     DLL_EXPORT bool SaveSystemAsXml(const char * filename){ return SaveElementsAsXml(filename, System);}
 
     DLL_EXPORT bool LoadSystemFromXml(const char * filename)
@@ -1498,6 +2190,34 @@ extern "C"
 
         return true;
     }
+
+    DLL_EXPORT bool SetGratingVectorMap(size_t elementID, double halfLength, double halfWidth, double tolerance, int32_t maxDegree, double* fitError)
+    {
+        ClearOptiXError();
+        if(!System.isValidID(elementID))
+        {
+            SetOptiXLastError("Invalid element ID", __FILE__, __func__);
+            return false;
+        }
+        GratingBase *pGrating= dynamic_cast<GratingBase*>((ElementBase*) elementID);
+        if( !pGrating)
+        {
+            SetOptiXLastError("Element is not a grating", __FILE__, __func__);
+            return false;
+        }
+        try
+        {
+            double error=pGrating->setGratingMap(halfLength, halfWidth, tolerance, maxDegree);
+            if(fitError)
+                *fitError=error;
+        }
+        catch(OptixException& ex)
+        {
+            SetOptiXLastError(ex.what(), __FILE__, __func__);
+            return false;
+        }
+        return true;
+    }
 // ------------------------------------------------------------------------
 // |           Surface error related functions                             |
 // ------------------------------------------------------------------------
@@ -1723,6 +2443,24 @@ extern "C"
         return true;
     }
 
+    DLL_EXPORT bool ReflectivityEnable(const bool activity)
+    {
+        enableReflectivity=activity;
+        return true;
+    }
+
+    DLL_EXPORT bool ReflectivityGetState(bool *activityFlag)
+    {
+        ClearOptiXError();
+        if(!activityFlag)
+        {
+            SetOptiXLastError("Invalid reference to activityFlag", __FILE__, __func__);
+            return false;
+        }
+        *activityFlag= enableReflectivity;
+        return true;
+    }
+
 // -----------------------------------------------------------------
 // |           Aperture and wavefront related functions            |
 // -----------------------------------------------------------------
@@ -1866,6 +2604,87 @@ extern "C"
     }
 #endif // HAS_REFLEX
 
+    DLL_EXPORT bool SetReflectanceTable(size_t elementID, double energyMin, double energyMax, int64_t numEnergies, bool logSpacing,
+                                        double angleMin, double angleMax, int64_t numAngles, const double* rs, const double* rp)
+    {
+        ClearOptiXError();
+        if(!System.isValidID(elementID))
+        {
+            SetOptiXLastError("invalid element ID", __FILE__, __func__);
+            return false;
+        }
+        Surface * psurf=dynamic_cast<Surface*>((ElementBase*)elementID);
+        if(! psurf )
+        {
+            SetOptiXLastError("element is not an OptiX Surface", __FILE__, __func__);
+            return false;
+        }
+        if(psurf->isSource())
+        {
+            SetOptiXLastError("Cannot define a reflectance on a source", __FILE__, __func__);
+            return false;
+        }
+        try
+        {
+            psurf->setReflectanceTable(make_shared<ReflectanceTable>(energyMin, energyMax, numEnergies, logSpacing, angleMin, angleMax, numAngles,
+                                                                     (const complex<double>*) rs, (const complex<double>*) rp));
+        }
+        catch(ParameterException & excpt)
+        {
+            SetOptiXLastError(excpt.what(), __FILE__, __func__);
+            return false;
+        }
+        return true;
+    }
+
+    DLL_EXPORT bool RemoveReflectanceTable(size_t elementID)
+    {
+        ClearOptiXError();
+        if(!System.isValidID(elementID))
+        {
+            SetOptiXLastError("invalid element ID", __FILE__, __func__);
+            return false;
+        }
+        Surface * psurf=dynamic_cast<Surface*>((ElementBase*)elementID);
+        if(! psurf )
+        {
+            SetOptiXLastError("element is not an OptiX Surface", __FILE__, __func__);
+            return false;
+        }
+        psurf->setReflectanceTable(NULL);
+        return true;
+    }
+
+    DLL_EXPORT bool GetReflectance(size_t elementID, int64_t numValues, const double* wavelengths, const double* angles, double* rs, double* rp)
+    {
+        ClearOptiXError();
+        if(!System.isValidID(elementID))
+        {
+            SetOptiXLastError("invalid element ID", __FILE__, __func__);
+            return false;
+        }
+        Surface * psurf=dynamic_cast<Surface*>((ElementBase*)elementID);
+        if(! psurf )
+        {
+            SetOptiXLastError("element is not an OptiX Surface", __FILE__, __func__);
+            return false;
+        }
+        shared_ptr<const ReflectanceTable> table=psurf->getReflectanceTable();
+        if(!table)
+        {
+            SetOptiXLastError(psurf->getName()+" has no reflectance table", __FILE__, __func__);
+            return false;
+        }
+        if(numValues < 0 || !wavelengths || !angles || !rs || !rp)
+        {
+            SetOptiXLastError("Invalid array arguments", __FILE__, __func__);
+            return false;
+        }
+        table->getReflectances(Map<const ArrayXd>(wavelengths, numValues), Map<const ArrayXd>(angles, numValues),
+                               Map<ArrayXcd>((complex<double>*) rs, numValues), Map<ArrayXcd>((complex<double>*) rp, numValues));
+        return true;
+    }
+
 #ifdef __cplusplus
 } // extern C
 #endif
@@ -0,0 +1,149 @@
+////////////////////////////////////////////////////////////////////////////////
+/**
+*      \file           lowdiscrepancy.cpp
+*
+*      \brief         LowDiscrepancySampler implementation and inverse normal distribution
+*
+*      \author         François Polack <francois.polack@synchroton-soleil.fr>
+*      \date        2024-10-29  Creation
+*      \date        Last update
+*
+*/
+///////////////////////////////////////////////////////////////////////////////////
+//
+//             REVISIONS
+//
+////////////////////////////////////////////////////////////////////////////////////
+#include "lowdiscrepancy.h"
+#include "counterrng.h"
+#include <cmath>
+
+/** \brief Sobol direction numbers of the first dimensions, from the primitive polynomials and initial numbers of S. Joe and F. Y. Kuo (2008) */
+struct SobolDirections
+{
+    uint32_t v[LowDiscrepancySampler::MaxDimensions][32];
+    SobolDirections()
+    {
+        // degree s, polynomial coefficients a and initial numbers m of the dimensions 2 to 5; dimension 1 is the van der Corput sequence
+        static const uint32_t s[]={1, 2, 3, 3}, a[]={0, 1, 1, 2};
+        static const uint32_t m[][3]={{1, 0, 0}, {1, 3, 0}, {1, 3, 1}, {1, 1, 1}};
+        for(int j=0; j < 32; ++j)
+            v[0][j]=1U << (31-j);
+        for(int d=1; d < LowDiscrepancySampler::MaxDimensions; ++d)
+        {
+            uint32_t deg=s[d-1];
+            for(uint32_t j=0; j < 32; ++j)
+            {
+                if(j < deg)
+                    v[d][j]=m[d-1][j] << (31-j);
+                else
+                {
+                    v[d][j]=v[d][j-deg] ^ (v[d][j-deg] >> deg);
+                    for(uint32_t k=1; k < deg; ++k)
+                        if((a[d-1] >> (deg-1-k)) & 1)
+                            v[d][j]^=v[d][j-k];
+                }
+            }
+        }
+    }
+};
+
+static inline uint32_t reverseBits(uint32_t x)
+{
+    x=((x >> 1) & 0x55555555U) | ((x & 0x55555555U) << 1);
+    x=((x >> 2) & 0x33333333U) | ((x & 0x33333333U) << 2);
+    x=((x >> 4) & 0x0F0F0F0FU) | ((x & 0x0F0F0F0FU) << 4);
+    x=((x >> 8) & 0x00FF00FFU) | ((x & 0x00FF00FFU) << 8);
+    return (x >> 16) | (x << 16);
+}
+
+/** \brief Owen scrambling of the bits of x: each bit is flipped according to a hash of the higher order bits (Laine-Karras permutation) */
+static inline uint32_t nestedUniformScramble(uint32_t x, uint32_t seed)
+{
+    x=reverseBits(x);
+    x+=seed;
+    x^=x*0x6C50B47CU;
+    x^=x*0xB82F1E52U;
+    x^=x*0xC7AFE638U;
+    x^=x*0x8D22F6E6U;
+    return reverseBits(x);
+}
+
+LowDiscrepancySampler::LowDiscrepancySampler(SamplingMode mode, uint64_t seed):m_mode(mode)
+{
+    CounterRNG rng(seed);
+    uint32_t words[8];
+    rng.block(0, 0, words);
+    rng.block(0, 1, words+4);
+    for(int d=0; d <= MaxDimensions; ++d)
+        m_scramble[d]=words[d];
+    rng.block(1, 0, words);
+    rng.block(1, 1, words+4);
+    for(int d=0; d < MaxDimensions; ++d)
+        m_shift[d]=CounterRNG::uniform(words[d]);
+}
+
+void LowDiscrepancySampler::point(uint64_t index, double u[MaxDimensions]) const
+{
+    if(m_mode==HaltonSampling)
+    {
+        static const uint32_t bases[MaxDimensions]={2, 3, 5, 7, 11};
+        for(int d=0; d < MaxDimensions; ++d)
+        {
+            // radical inverse of index+1, the point 0 being skipped
+            double inverse=0, factor=1./bases[d];
+            for(uint64_t n=index+1; n > 0; n/=bases[d], factor/=bases[d])
+                inverse+=(n % bases[d])*factor;
+            inverse+=m_shift[d];
+            if(inverse >= 1.)
+                inverse-=1.;
+            u[d]= inverse > 0 ? inverse : 0.5*0x1.0p-32;
+        }
+        return;
+    }
+
+    static const SobolDirections directions;
+    uint32_t i=nestedUniformScramble(uint32_t(index), m_scramble[MaxDimensions]);  // shuffles the order of the points
+    for(int d=0; d < MaxDimensions; ++d)
+    {
+        uint32_t x=0, bits=i;
+        for(int j=0; bits; ++j, bits>>=1)
+            if(bits & 1)
+                x^=directions.v[d][j];
+        u[d]=CounterRNG::uniform(nestedUniformScramble(x, m_scramble[d]));
+    }
+}
+
+double InverseNormalCDF(double p)
+{
+    double q=p-0.5, r, x;
+    if(fabs(q) <= 0.425)
+    {
+        r=0.180625-q*q;
+        return q*(((((((r*2509.0809287301226727+33430.575583588128105)*r+67265.770927008700853)*r+45921.953931549871457)*r
+                   +13731.693765509461125)*r+1971.5909503065514427)*r+133.14166789178437745)*r+3.387132872796366608)
+                /(((((((r*5226.495278852545925+28729.085735721942674)*r+39307.89580009271061)*r+21213.794301586595867)*r
+                   +5394.1960214247511077)*r+687.1870074920579083)*r+42.313330701600911252)*r+1.);
+    }
+    r= q < 0 ? p : 1.-p;
+    if(r <= 0)
+        return q < 0 ? -HUGE_VAL : HUGE_VAL;
+    r=sqrt(-log(r));
+    if(r <= 5.)
+    {
+        r-=1.6;
+        x=(((((((r*7.7454501427834140764e-4+.0227238449892691845833)*r+.24178072517745061177)*r+1.27045825245236838258)*r
+             +3.64784832476320460504)*r+5.7694972214606914055)*r+4.6303378461565452959)*r+1.42343711074968357734)
+            /(((((((r*1.05075007164441684324e-9+5.475938084995344946e-4)*r+.0151986665636164571966)*r+.14810397642748007459)*r
+             +.68976733498510000455)*r+1.6763848301838038494)*r+2.05319162663775882187)*r+1.);
+    }
+    else
+    {
+        r-=5.;
+        x=(((((((r*2.01033439929228813265e-7+2.71155556874348757815e-5)*r+.0012426609473880784386)*r+.026532189526576123093)*r
+             +.29656057182850489123)*r+1.7848265399172913358)*r+5.4637849111641143699)*r+6.6579046435011037772)
+            /(((((((r*2.04426310338993978564e-15+1.4215117583164458887e-7)*r+1.8463183175100546818e-5)*r+7.868691311456132591e-4)*r
+             +.0148753612908506148525)*r+.13692988092273580531)*r+.59983220655588793769)*r+1.);
+    }
+    return q < 0 ? -x : x;
+}
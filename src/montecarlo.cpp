@@ -0,0 +1,210 @@
+////////////////////////////////////////////////////////////////////////////////
+/**
+*      \file           montecarlo.cpp
+*
+*      \brief         Monte Carlo tolerancing implementation
+*
+*      \author         François Polack <francois.polack@synchroton-soleil.fr>
+*      \date        2024-10-18  Creation
+*      \date         Last update
+*
+
+*/
+///////////////////////////////////////////////////////////////////////////////////
+//
+//             REVISIONS
+//
+////////////////////////////////////////////////////////////////////////////////////
+
+#include "montecarlo.h"
+#include "opticalelements.h"
+#include "OptixException.h"
+#include <random>
+#include <cstring>
+#include <omp.h>
+
+using namespace std;
+
+void GetToleranceFigures(Surface* surface, double distance, ToleranceResult& result)
+{
+    vector<size_t> alive;
+    result.lost=surface->getAliveImpacts(alive);
+    result.count=alive.size();
+    result.meanX=result.meanY=result.sigmaX=result.sigmaY=result.sigmaXprime=result.sigmaYprime=0;
+    if(result.count==0)
+        return;
+
+    RayType::PlaneType obsPlane(RayType::VectorType::UnitZ(), -distance);  // equation UnitZ*X - distance =0
+    Array4d sum=Array4d::Zero(), sum2=Array4d::Zero();
+    for(vector<size_t>::iterator pIndex=alive.begin(); pIndex!=alive.end(); ++pIndex)
+    {
+        RayType ray=surface->getImpactInFrame(*pIndex, AlignedLocalFrame);
+        ray.moveToPlane(obsPlane);
+        Array4d spot;
+        spot << ray.position().segment(0,2).cast<double>(), ray.direction().segment(0,2).cast<double>();
+        sum+=spot;
+        sum2+=spot.square();
+    }
+    sum/=result.count;
+    sum2=(sum2/result.count - sum.square()).max(0).sqrt();
+    result.meanX=sum(0);
+    result.meanY=sum(1);
+    result.sigmaX=sum2(0);
+    result.sigmaY=sum2(1);
+    result.sigmaXprime=sum2(2);
+    result.sigmaYprime=sum2(3);
+}
+
+/** \brief checks that the element belongs to the chain starting from source
+ */
+static bool isInChain(SourceBase* source, ElementBase* elem)
+{
+    for(ElementBase* pElem=source; pElem; pElem=pElem->getNext())
+        if(pElem==elem)
+            return true;
+    return false;
+}
+
+int ToleranceMonteCarlo(SourceBase* source, Surface* target, double wavelength, double distance,
+                        const std::vector<ToleranceParameter>& parameters, const std::vector<Surface*>& errorSurfaces,
+                        bool randomLegendre, int numRealizations, uint64_t& seed,
+                        ToleranceResult* results, ToleranceResult& mean, ToleranceResult& sigma)
+{
+    // all checks are done before entering the parallel section where no error can be reported
+    if(!isInChain(source, target))
+        throw ParameterException(string("target surface ")+target->getName()+" is not in the chain of source "+source->getName(),
+                                 __FILE__, __func__, __LINE__);
+    if(target->getRecording()==RecordNone)
+        throw ParameterException(string("target surface ")+target->getName()+" does not record impacts",
+                                 __FILE__, __func__, __LINE__);
+    for(const ToleranceParameter& tolParam : parameters)
+    {
+        ElementBase* elem=(ElementBase*) tolParam.elementID;
+        if(!isInChain(source, elem))
+            throw ParameterException(string("element ")+elem->getName()+" is not in the chain of source "+source->getName(),
+                                     __FILE__, __func__, __LINE__);
+        Parameter param;
+        if(!tolParam.paramName || !elem->getParameter(tolParam.paramName, param))
+            throw ParameterException(string("invalid parameter name in element ")+elem->getName(), __FILE__, __func__, __LINE__);
+        if(param.flags & ArrayData)
+            throw ParameterException(string("array parameter ")+tolParam.paramName+" of element "+elem->getName()+" cannot be toleranced",
+                                     __FILE__, __func__, __LINE__);
+        if(tolParam.law!=UniformLaw && tolParam.law!=GaussianLaw)
+            throw ParameterException(string("invalid tolerance law for parameter ")+tolParam.paramName+" of element "+elem->getName(),
+                                     __FILE__, __func__, __LINE__);
+    }
+    for(Surface* psurf : errorSurfaces)
+    {
+        if(!isInChain(source, psurf))
+            throw ParameterException(string("surface ")+psurf->getName()+" is not in the chain of source "+source->getName(),
+                                     __FILE__, __func__, __LINE__);
+        if(!psurf->hasParameter("error_limits"))
+            throw ParameterException(string("surface ")+psurf->getName()+" doesn't have an active surface error generator",
+                                     __FILE__, __func__, __LINE__);
+    }
+
+    if(seed==0)
+    {
+        random_device rd;
+        seed=(uint64_t(rd()) << 32) | rd();
+    }
+
+    string firstError;
+    #pragma omp parallel for schedule(dynamic)
+    for(int i=0; i < numRealizations; ++i)
+    {
+        ToleranceResult &result=results[i];
+        memset(&result, 0, sizeof(ToleranceResult));
+        // one generator per realization, so that the draws do not depend on the thread scheduling
+        seed_seq seq{uint32_t(seed), uint32_t(seed >> 32), uint32_t(i)};
+        mt19937_64 engine(seq);
+        normal_distribution<double> gaussian(0, 1.);
+        uniform_real_distribution<double> uniform(-1., 1.);
+        try
+        {
+            ChainCopy chain;
+            if(!DuplicateChain(source, chain))
+                throw ElementException("Failed to duplicate the element chain", __FILE__, __func__, __LINE__);
+
+            for(const ToleranceParameter& tolParam : parameters)
+            {
+                ElementBase* elem=chain.copyMap[(ElementBase*) tolParam.elementID];
+                Parameter param;
+                elem->getParameter(tolParam.paramName, param);
+                param.value+= tolParam.spread*(tolParam.law==GaussianLaw ? gaussian(engine) : uniform(engine));
+                if(!elem->setParameter(tolParam.paramName, param))
+                    throw ParameterException(string("cannot set parameter ")+tolParam.paramName+" of element "+elem->getName(),
+                                             __FILE__, __func__, __LINE__);
+            }
+
+            for(Surface* psurf : errorSurfaces)
+            {
+                Surface* surfCopy=dynamic_cast<Surface*>(chain.copyMap[psurf]);
+                int dims[2];
+                double total_sigma;
+                MatrixXd legendre;
+                if(!surfCopy->generateSurfaceErrors(dims, &total_sigma, legendre, randomLegendre, engine()))
+                    throw ElementException(string("surface error generation failed on ")+surfCopy->getName(), __FILE__, __func__, __LINE__);
+            }
+
+            SourceBase* sourceCopy=dynamic_cast<SourceBase*>(chain.First);
+            if(sourceCopy->alignFromHere(wavelength))
+                throw ElementException("System alignment failed", __FILE__, __func__, __LINE__);
+            sourceCopy->clearImpacts();
+            sourceCopy->generate(wavelength);
+            sourceCopy->radiate();
+
+            GetToleranceFigures(dynamic_cast<Surface*>(chain.copyMap[target]), distance, result);
+        }
+        catch(OptixException& ex)
+        {
+            result.status=-1;
+            #pragma omp critical (ToleranceError)
+            {
+                if(firstError.empty())
+                    firstError=string("realization ")+to_string(i)+": "+ex.what();
+            }
+        }
+        catch(std::exception& ex)
+        {
+            result.status=-1;
+            #pragma omp critical (ToleranceError)
+            {
+                if(firstError.empty())
+                    firstError=string("realization ")+to_string(i)+": "+ex.what();
+            }
+        }
+    }
+
+    // statistics over the valid realizations
+    int nValid=0;
+    ArrayXd sum=ArrayXd::Zero(8), sum2=ArrayXd::Zero(8);
+    for(int i=0; i < numRealizations; ++i)
+    {
+        if(results[i].status)
+            continue;
+        ++nValid;
+        Map<const Array<double,6,1> > fig(&results[i].meanX);
+        ArrayXd val(8);
+        val << fig, results[i].count, results[i].lost;
+        sum+=val;
+        sum2+=val.square();
+    }
+    memset(&mean, 0, sizeof(ToleranceResult));
+    memset(&sigma, 0, sizeof(ToleranceResult));
+    mean.status=nValid;
+    if(nValid)
+    {
+        sum/=nValid;
+        sum2=(sum2/nValid - sum.square()).max(0).sqrt();
+        Map<Array<double,6,1> >(&mean.meanX)=sum.head(6);
+        Map<Array<double,6,1> >(&sigma.meanX)=sum2.head(6);
+        mean.count=lround(sum(6));
+        mean.lost=lround(sum(7));
+        sigma.count=lround(sum2(6));
+        sigma.lost=lround(sum2(7));
+    }
+    if(!firstError.empty())
+        SetOptiXLastError(firstError, __FILE__, __func__);
+    return nValid;
+}
@@ -40,6 +40,10 @@ template class Film<Cone>;
 template class Film<NaturalPolynomialSurface>;
 template class Film<LegendrePolynomialSurface>;
 
+template class Detector<Plane>;
+template class Detector<Sphere>;
+template class Detector<Cylinder>;
+
 template class Grating<Holo,Plane>;
 template class Grating<Holo,Sphere>;
 template class Grating<Holo,Cylinder>;
@@ -78,6 +82,10 @@ ElementBase* CreateElementObject(string s_type, string name)
         elem= new AstigmaticGaussianSource(name);
     else if (s_type=="Source<BMtype,Gaussian>" || s_type=="BMtypeGaussianSource")
         elem= new BMtypeGaussianSource(name);
+    else if (s_type=="Source<File>" || s_type=="FileSource")
+        elem= new FileSource(name);
+    else if (s_type=="Source<PhaseSpace>" || s_type=="PhaseSpaceSource")
+        elem= new PhaseSpaceSource(name);
 
     else if (s_type=="Mirror<Plane>" || s_type=="PlaneMirror")
         elem= new Mirror<Plane>(name);
@@ -118,6 +126,13 @@ ElementBase* CreateElementObject(string s_type, string name)
     else if (s_type=="Film<LegendrePolynomialSurface>" || s_type=="LegendrePolynomialFilm")
         elem= new Film<LegendrePolynomialSurface>(name);
 
+    else if (s_type=="Detector<Plane>" || s_type=="PlaneDetector")
+        elem= new Detector<Plane>(name);
+    else if (s_type=="Detector<Sphere>" || s_type=="SphericalDetector")
+        elem= new Detector<Sphere>(name);
+    else if (s_type=="Detector<Cylinder>" || s_type=="CylindricalDetector")
+        elem= new Detector<Cylinder>(name);
+
     else if (s_type=="Grating<Holo,Plane>" || s_type=="PlaneHoloGrating")
         elem= new Grating<Holo,Plane>(name);
     else if (s_type=="Grating<Holo,Sphere>" || s_type=="SphericalHoloGrating")
@@ -167,6 +182,10 @@ ElementBase * ElementCopy(ElementBase* source)
         Copy= new UniformGaussianSource(*dynamic_cast<UniformGaussianSource*>(source));
     else if (s_type=="Source<BMtype,Gaussian>" || s_type=="BMtypeGaussianSource")
         Copy= new BMtypeGaussianSource(*dynamic_cast<BMtypeGaussianSource*>(source));
+    else if (s_type=="Source<File>" || s_type=="FileSource")
+        Copy= new FileSource(*dynamic_cast<FileSource*>(source));
+    else if (s_type=="Source<PhaseSpace>" || s_type=="PhaseSpaceSource")
+        Copy= new PhaseSpaceSource(*dynamic_cast<PhaseSpaceSource*>(source));
 
     else if (s_type=="Mirror<Plane>" || s_type=="PlaneMirror")
         Copy= new Mirror<Plane>(*dynamic_cast<Mirror<Plane>*>(source));
@@ -206,6 +225,13 @@ ElementBase * ElementCopy(ElementBase* source)
     else if (s_type=="Film<LegendrePolynomialSurface>" || s_type=="LegendrePolynomialFilm")
         Copy= new Film<LegendrePolynomialSurface>(*dynamic_cast<Film<LegendrePolynomialSurface>*>(source));
 
+    else if (s_type=="Detector<Plane>" || s_type=="PlaneDetector")
+        Copy= new Detector<Plane>(*dynamic_cast<Detector<Plane>*>(source));
+    else if (s_type=="Detector<Sphere>" || s_type=="SphericalDetector")
+        Copy= new Detector<Sphere>(*dynamic_cast<Detector<Sphere>*>(source));
+    else if (s_type=="Detector<Cylinder>" || s_type=="CylindricalDetector")
+        Copy= new Detector<Cylinder>(*dynamic_cast<Detector<Cylinder>*>(source));
+
     else if (s_type=="Grating<Holo,Plane>" || s_type=="PlaneHoloGrating")
         Copy= new Grating<Holo,Plane>(*dynamic_cast<Grating<Holo,Plane>*>(source));
     else if (s_type=="Grating<Holo,Sphere>" || s_type=="SphericalHoloGrating")
@@ -266,13 +292,13 @@ bool DuplicateChain(ElementBase * source, ChainCopy& newChain)
         ElementCopyMap::iterator it=newChain.copyMap.find(source->getPrevious());
         if (it==newChain.copyMap.end() )
         {
-            cout << "element not found\n";
+//            cout << "element not found\n";
             return false;  // again should never occur
         }
-        cout << "It " <<it->first<< "  " << it->second <<endl;
+//        cout << "It " <<it->first<< "  " << it->second <<endl;
         elemCopy->setPrevious(it->second); // obligé de faire un set car le chainage de source reste en place et chain irait rétroagir sur source
         it->second->setNext(elemCopy);
-        cout << "S: " << source << " < " << source->getPrevious() << ", " << source->getNext() <<endl;
+//        cout << "S: " << source << " < " << source->getPrevious() << ", " << source->getNext() <<endl;
     }
 
     newChain.copyMap.insert(ElemPair(source,elemCopy));
@@ -14,6 +14,7 @@
  ***************************************************************************/
 
 #include "polynomial.h"
+#include "wavefront.h"
 #include <sstream>
 //#define VERBOSE
 
@@ -184,6 +185,13 @@ double Polynomial::fitHeights(Index Nx, Index Ny, const Ref<ArrayX3d>& heightdat
     Index i=0,j=0, k=0;
     double sigma=0;
 
+    ArrayXd Xgrid, Ygrid;
+    if(GridFromXYZ(heightdata.col(0), heightdata.col(1), Xgrid, Ygrid))
+    {
+        ArrayXXd Zgrid=heightdata.col(2).reshaped(Xgrid.size(), Ygrid.size());
+        return fitGridHeights(Nx, Ny, Xgrid, Ygrid, Zgrid);
+    }
+
     m_coeffs=MatrixXType::Zero(Nx,Ny);
     ArrayXXType Px, Py, dPx, dPy;
 
@@ -206,11 +214,33 @@ double Polynomial::fitHeights(Index Nx, Index Ny, const Ref<ArrayX3d>& heightdat
     Map<VectorXType> Cmap(m_coeffs.data(), nvars);
     Cmap=A.lu().solve(Rhs);
 
-    Vheight-= A*Cmap;
+    Vheight-= Mat*Cmap;
     sigma= sqrt(Vheight.array().square().sum()/numData);
     return sigma;
 }
 
+double Polynomial::fitGridHeights(Index Nx, Index Ny, const Ref<ArrayXd>& Xpos, const Ref<ArrayXd>& Ypos, const Ref<ArrayXXd>& heights)
+{
+    if(heights.rows()!=Xpos.size() || heights.cols()!=Ypos.size())
+        throw ParameterException("The size of the height array doesn't match the grid coordinate sizes", __FILE__, __func__, __LINE__);
+    ArrayXXType dPx, dPy;
+    MatrixXType Px, Py;
+
+    ArrayXType tmparray=Xnormalize(Xpos);
+    Px=getBaseValues(Nx,tmparray, dPx);
+    tmparray=Ynormalize(Ypos);
+    Py=getBaseValues(Ny, tmparray, dPy);
+
+    // the normal equations of a tensor product basis separate along X and Y :  (Px^T Px) C (Py^T Py) = Px^T Z Py
+    MatrixXType Z=heights.cast<FloatType>().matrix();
+    MatrixXType Rhs=(Px.transpose()*Z)*Py;
+    MatrixXType Cx=(Px.transpose()*Px).ldlt().solve(Rhs);
+    m_coeffs=(Py.transpose()*Py).ldlt().solve(Cx.transpose()).transpose();
+
+    Z-= Px*m_coeffs*Py.transpose();
+    return sqrt(double(Z.squaredNorm())/Z.size());
+}
+
 
 ArrayXXd Polynomial::surfaceHeight(const Ref<ArrayXd>& Xpos, const Ref<ArrayXd>& Ypos )
 {
@@ -0,0 +1,83 @@
+////////////////////////////////////////////////////////////////////////////////
+/**
+*      \file           reflectancetable.cpp
+*
+*      \brief         ReflectanceTable implementation
+*
+*      \author         François Polack <francois.polack@synchroton-soleil.fr>
+*      \date        2024-11-04  Creation
+*      \date         Last update
+*
+
+*/
+///////////////////////////////////////////////////////////////////////////////////
+//
+//             REVISIONS
+//
+////////////////////////////////////////////////////////////////////////////////////
+
+#include "reflectancetable.h"
+
+using namespace std;
+
+ReflectanceTable::ReflectanceTable(double energyMin, double energyMax, int64_t numEnergies, bool logSpacing,
+                                   double angleMin, double angleMax, int64_t numAngles, const ComplexType* rs, const ComplexType* rp)
+{
+    if(!(energyMin > 0) || !(energyMax > energyMin) || numEnergies < 2)
+        throw ParameterException("Invalid energy grid of the reflectance table", __FILE__, __func__, __LINE__);
+    if(!(angleMin >= 0) || !(angleMax > angleMin) || angleMax > M_PI_2 || numAngles < 2)
+        throw ParameterException("Invalid grazing angle grid of the reflectance table", __FILE__, __func__, __LINE__);
+    if(!rs || !rp)
+        throw ParameterException("Undefined reflectance values", __FILE__, __func__, __LINE__);
+
+    m_energyMin=energyMin;
+    m_energyMax=energyMax;
+    m_numEnergies=numEnergies;
+    m_logSpacing=logSpacing;
+    if(logSpacing)
+    {
+        m_energyOrigin=log(energyMin);
+        m_energyScale=(numEnergies-1)/(log(energyMax)-m_energyOrigin);
+    }
+    else
+    {
+        m_energyOrigin=energyMin;
+        m_energyScale=(numEnergies-1)/(energyMax-energyMin);
+    }
+    m_angleMin=angleMin;
+    m_angleMax=angleMax;
+    m_numAngles=numAngles;
+    m_angleScale=(numAngles-1)/(angleMax-angleMin);
+
+    size_t numNodes=numEnergies*numAngles;
+    m_values.resize(2*numNodes);
+    for(size_t i=0; i < numNodes; ++i)
+    {
+        m_values[2*i]=rs[i];
+        m_values[2*i+1]=rp[i];
+    }
+}
+
+void ReflectanceTable::getReflectances(const Ref<const ArrayXd>& wavelengths, const Ref<const ArrayXd>& grazingAngles,
+                                       Ref<ArrayXcd> rs, Ref<ArrayXcd> rp) const
+{
+    if(grazingAngles.size()!=wavelengths.size() || rs.size()!=wavelengths.size() || rp.size()!=wavelengths.size())
+        throw ParameterException("array sizes do not match", __FILE__, __func__, __LINE__);
+    for(Eigen::Index k=0; k < wavelengths.size(); ++k)
+        getReflectance(wavelengths(k), grazingAngles(k), rs(k), rp(k));
+}
+
+void ReflectanceTable::getEnergyRange(double* energyMin, double* energyMax, int64_t* numEnergies, bool* logSpacing) const
+{
+    *energyMin=m_energyMin;
+    *energyMax=m_energyMax;
+    *numEnergies=m_numEnergies;
+    *logSpacing=m_logSpacing;
+}
+
+void ReflectanceTable::getAngleRange(double* angleMin, double* angleMax, int64_t* numAngles) const
+{
+    *angleMin=m_angleMin;
+    *angleMax=m_angleMax;
+    *numAngles=m_numAngles;
+}
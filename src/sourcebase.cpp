@@ -21,6 +21,20 @@ SourceBase::SourceBase():Surface(true,"Source") {} //
 
 SourceBase::~SourceBase(){}
 
+bool SourceBase::getAcceptanceCorners(Matrix<FloatType,3,8> &corners)
+{
+    Surface* pnext=dynamic_cast<Surface*>(m_next);
+    if(!pnext)
+        return false;
+    if(!pnext->isAligned())
+        throw ParameterException("The system must be aligned to compute the acceptance of "+pnext->getName(), __FILE__, __func__, __LINE__);
+    if(!pnext->getApertureCorners(corners))
+        return false;
+    if((corners.row(2).array() <= 0).any())
+        throw ParameterException("The aperture of "+pnext->getName()+" is not entirely downstream of the source", __FILE__, __func__, __LINE__);
+    return true;
+}
+
 void SourceBase::waveRadiate(double wavelength, double Xaperture, double Yaperture, size_t Xsize, size_t Ysize, char polar)
 {
     VectorXd gridX=VectorXd::LinSpaced(-Xaperture, Xaperture, Xsize);
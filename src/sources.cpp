@@ -15,10 +15,79 @@
 //
 ////////////////////////////////////////////////////////////////////////////////////
 #include "sources.h"
+#include "counterrng.h"
+#include "lowdiscrepancy.h"
 # include <random>
 
 using namespace std;
 
+/** \brief computes the bounds of the slopes of the rays emitted from a point of the source plane, which can reach the aperture defined by corners
+ *  (see SourceBase::getAcceptanceCorners())
+ */
+static inline void acceptedSlopes(const Matrix<FloatType,3,8> &corners, const RayBaseType::VectorType &origin, FloatType lower[2], FloatType upper[2])
+{
+    for(int k=0; k < 2; ++k)
+    {
+        lower[k]=HUGE_VAL;
+        upper[k]=-HUGE_VAL;
+        for(int c=0; c < 8; ++c)
+        {
+            FloatType slope=(corners(k,c)-origin(k))/corners(2,c);
+            lower[k]=min(lower[k], slope);
+            upper[k]=max(upper[k], slope);
+        }
+    }
+}
+
+/** \brief draws a centered gaussian value restricted to the interval [lower, upper] by inversion of the distribution function
+ * \param u a uniform deviate in (0,1)
+ * \param[in,out] weight is multiplied by the probability of the interval
+ */
+static FloatType truncatedGaussian(FloatType sigma, FloatType lower, FloatType upper, double u, FloatType &weight)
+{
+    if(sigma <= 0)
+    {
+        if(lower > 0 || upper < 0)
+            weight=0;
+        return 0;
+    }
+    double a=lower/sigma, b=upper/sigma, sign=1.;
+    if(a > 0)   // the interval is moved to the lower tail where the distribution function is accurate
+    {
+        a=-upper/sigma;
+        b=-lower/sigma;
+        sign=-1.;
+    }
+    double pa=0.5*erfc(-a*M_SQRT1_2), pb=0.5*erfc(-b*M_SQRT1_2);
+    weight*=pb-pa;
+    if(pb <= pa)
+        return sign*sigma*a;
+    return sign*sigma*InverseNormalCDF(pa+u*(pb-pa));
+}
+
+/** \brief draws a uniform value in the intersection of [-semi, semi] and [lower, upper]
+ * \param u a uniform deviate in (0,1)
+ * \param[in,out] weight is multiplied by the probability of the intersection
+ */
+static FloatType truncatedUniform(FloatType semi, FloatType lower, FloatType upper, double u, FloatType &weight)
+{
+    if(semi <= 0)
+    {
+        if(lower > 0 || upper < 0)
+            weight=0;
+        return 0;
+    }
+    lower=max(lower, -semi);
+    upper=min(upper, semi);
+    if(upper <= lower)
+    {
+        weight=0;
+        return 0;
+    }
+    weight*=(upper-lower)/(2*semi);
+    return lower+u*(upper-lower);
+}
+
 //   ----------------   XYGridSource implementation   --------------------------
 
 XYGridSource::XYGridSource(string name ,Surface * previous):Surface(true,name, previous)  // surface non réfléchissante
@@ -251,12 +320,23 @@ GaussianSource::GaussianSource(string name ,Surface * previous):Surface(true,nam
     defineParameter("sigmaXdiv", param); //
     defineParameter("sigmaYdiv", param); // default round source dsigma div = 500 µrad
 
+    param.type=Dimensionless;
+    param.value=PseudoRandomSampling;
+    param.flags=NotOptimizable;
+    defineParameter("sampling", param); // pseudo random draws by default
+    param.type=Dimensionless;
+    param.value=0;
+    param.flags=NotOptimizable;
+    defineParameter("acceptance", param); // full emission by default
+
 
     setHelpstring("nRays", " number of rays to be generated");  // complete la liste de infobulles de la classe Surface
     setHelpstring("sigmaX", "RMS source size in X direction");
     setHelpstring("sigmaY", "RMS source size in Y direction");
     setHelpstring("sigmaXdiv", "RMS source divergence in X direction");
     setHelpstring("sigmaYdiv", "RMS source divergence in y direction");
+    setHelpstring("sampling", "0 pseudo-random, 1 scrambled Sobol, 2 Halton");
+    setHelpstring("acceptance", "1 to emit only inside the acceptance of the next element aperture");
 
 }
 
@@ -278,6 +358,13 @@ int GaussianSource::generate(const double wavelength, const char polar)
     sigmaXprim=param.value;
     getParameter("sigmaYdiv", param);
     sigmaYprim=param.value;
+    getParameter("sampling", param);
+    SamplingMode sampling=SamplingMode(lround(param.value));
+    if(sampling < PseudoRandomSampling || sampling > HaltonSampling)
+        throw ParameterException("invalid sampling mode (0 pseudo-random, 1 Sobol or 2 Halton only are allowed)", __FILE__, __func__, __LINE__);
+    getParameter("acceptance", param);
+    Matrix<FloatType,3,8> corners;
+    bool restricted= lround(param.value)!=0 && getAcceptanceCorners(corners);
 
     RayType::ComplexType Samp, Pamp;
     if(polar=='S')
@@ -312,20 +399,42 @@ int GaussianSource::generate(const double wavelength, const char polar)
     }
     random_device rd;
     // if not clean enough use a Mersenne twister as mt19937 gen{rd()};
+    LowDiscrepancySampler sampler(sampling, (uint64_t(rd()) << 32) ^ rd());  // a new randomization of the point set at each call
+    double u[LowDiscrepancySampler::MaxDimensions];
     for(int i=0; i<nRays; ++ i)
     {
-        org <<0, 0, 0;
-        if(sigmaX > 0)
-            org(0)=gaussX(rd);
-        if(sigmaY >0)
-            org(1)=gaussY(rd);
-        dir << 0, 0, 1.L;
-        if(sigmaXprim > 0)
-            dir(0)=gaussXprim(rd);
-        if(sigmaYprim > 0)
-            dir(1)=gaussYprim(rd);
+        if(sampling!=PseudoRandomSampling)
+        {
+            sampler.point(i, u);  // gaussian deviates by inversion of the distribution function
+            org << sigmaX*InverseNormalCDF(u[0]), sigmaY*InverseNormalCDF(u[1]), 0;
+            dir << sigmaXprim*InverseNormalCDF(u[2]), sigmaYprim*InverseNormalCDF(u[3]), 1.L;
+        }
+        else
+        {
+            org <<0, 0, 0;
+            if(sigmaX > 0)
+                org(0)=gaussX(rd);
+            if(sigmaY >0)
+                org(1)=gaussY(rd);
+            dir << 0, 0, 1.L;
+            if(sigmaXprim > 0)
+                dir(0)=gaussXprim(rd);
+            if(sigmaYprim > 0)
+                dir(1)=gaussYprim(rd);
+        }
+        FloatType weight=1.;
+        if(restricted)  // the directions are drawn again, inside the slopes accepted from this origin, and the ray is weighted by their probability
+        {
+            if(sampling==PseudoRandomSampling)
+                u[2]=CounterRNG::uniform(rd()), u[3]=CounterRNG::uniform(rd());
+            FloatType lower[2], upper[2];
+            acceptedSlopes(corners, org, lower, upper);
+            dir(0)=truncatedGaussian(sigmaXprim, lower[0], upper[0], u[2], weight);
+            dir(1)=truncatedGaussian(sigmaYprim, lower[1], upper[1], u[3], weight);
+        }
         dir.normalize();
-        m_impacts.push_back(RayType(RayBaseType(org,dir),wavelength,Samp,Pamp)); // amplitude set to 1 and S polar by default
+        double amplitude=sqrt(double(weight)); // the intensity is proportional to the weight
+        m_impacts.push_back(RayType(RayBaseType(org,dir),wavelength,Samp*amplitude,Pamp*amplitude));
     }
     m_OPDvalid=false;
     return nRays;
@@ -362,6 +471,11 @@ AstigmaticGaussianSource::AstigmaticGaussianSource(string name ,Surface * previo
     defineParameter("sigmaXdiv", param); //
     defineParameter("sigmaYdiv", param); // default round source dsigma div = 500 µrad
 
+    param.type=Dimensionless;
+    param.value=PseudoRandomSampling;
+    param.flags=NotOptimizable;
+    defineParameter("sampling", param); // pseudo random draws by default
+
 
     setHelpstring("nRays", " number of rays to be generated");  // complete la liste de infobulles de la classe Surface
     setHelpstring("sigmaX", "RMS source size in X direction");
@@ -370,6 +484,7 @@ AstigmaticGaussianSource::AstigmaticGaussianSource(string name ,Surface * previo
     setHelpstring("waistY", "distance of Y waist to the source plane");
     setHelpstring("sigmaXdiv", "RMS source divergence in X direction");
     setHelpstring("sigmaYdiv", "RMS source divergence in y direction");
+    setHelpstring("sampling", "0 pseudo-random, 1 scrambled Sobol, 2 Halton");
 
 }
 
@@ -391,6 +506,10 @@ int AstigmaticGaussianSource::generate(const double wavelength, const char polar
     sigmaXprim=param.value;
     getParameter("sigmaYdiv", param);
     sigmaYprim=param.value;
+    getParameter("sampling", param);
+    SamplingMode sampling=SamplingMode(lround(param.value));
+    if(sampling < PseudoRandomSampling || sampling > HaltonSampling)
+        throw ParameterException("invalid sampling mode (0 pseudo-random, 1 Sobol or 2 Halton only are allowed)", __FILE__, __func__, __LINE__);
     getParameter("waistX", param);
     waistX=param.value;
     getParameter("waistY", param);
@@ -429,20 +548,32 @@ int AstigmaticGaussianSource::generate(const double wavelength, const char polar
     }
     random_device rd;
     // if not clean enough use a Mersenne twister as mt19937 gen{rd()};
+    LowDiscrepancySampler sampler(sampling, (uint64_t(rd()) << 32) ^ rd());  // a new randomization of the point set at each call
+    double u[LowDiscrepancySampler::MaxDimensions];
     for(int i=0; i<nRays; ++ i)
     {
-        dir << 0, 0, 1.L;
-        if(sigmaXprim > 0)
-            dir(0)=gaussXprim(rd);
-        if(sigmaYprim > 0)
-            dir(1)=gaussYprim(rd);
-        dir.normalize();
+        if(sampling!=PseudoRandomSampling)
+        {
+            sampler.point(i, u);  // gaussian deviates by inversion of the distribution function
+            dir << sigmaXprim*InverseNormalCDF(u[2]), sigmaYprim*InverseNormalCDF(u[3]), 1.L;
+            dir.normalize();
+            org << sigmaX*InverseNormalCDF(u[0])-waistX*dir(0), sigmaY*InverseNormalCDF(u[1])-waistY*dir(1), 0;
+        }
+        else
+        {
+            dir << 0, 0, 1.L;
+            if(sigmaXprim > 0)
+                dir(0)=gaussXprim(rd);
+            if(sigmaYprim > 0)
+                dir(1)=gaussYprim(rd);
+            dir.normalize();
 
-        org <<0, 0, 0;
-        if(sigmaX > 0)
-            org(0)=gaussX(rd)-waistX*dir(0);
-        if(sigmaY >0)
-            org(1)=gaussY(rd)-waistY*dir(1);
+            org <<0, 0, 0;
+            if(sigmaX > 0)
+                org(0)=gaussX(rd)-waistX*dir(0);
+            if(sigmaY >0)
+                org(1)=gaussY(rd)-waistY*dir(1);
+        }
 
         m_impacts.push_back(RayType(RayBaseType(org,dir), wavelength,Samp,Pamp)); // amplitude set to 1 and S polar by default
     }
@@ -478,12 +609,23 @@ UniformGaussianSource::UniformGaussianSource(string name ,Surface * previous):Su
     defineParameter("semiXdiv", param); //
     defineParameter("semiYdiv", param); // default round source dsigma div = 500 µrad
 
+    param.type=Dimensionless;
+    param.value=PseudoRandomSampling;
+    param.flags=NotOptimizable;
+    defineParameter("sampling", param); // pseudo random draws by default
+    param.type=Dimensionless;
+    param.value=0;
+    param.flags=NotOptimizable;
+    defineParameter("acceptance", param); // full emission by default
+
 
     setHelpstring("nRays", " number of rays to be generated");  // complete la liste de infobulles de la classe Surface
     setHelpstring("sigmaX", "RMS source size in X direction");
     setHelpstring("sigmaY", "RMS source size in Y direction");
     setHelpstring("semiXdiv", "1/2 source divergence in X direction");
     setHelpstring("semiYdiv", "1/2 source divergence in y direction");
+    setHelpstring("sampling", "0 pseudo-random, 1 scrambled Sobol, 2 Halton");
+    setHelpstring("acceptance", "1 to emit only inside the acceptance of the next element aperture");
 
 }
 
@@ -505,6 +647,13 @@ int UniformGaussianSource::generate(const double wavelength, const char polar)
     semiXdiv=param.value;
     getParameter("semiYdiv", param);
     semiYdiv=param.value;
+    getParameter("sampling", param);
+    SamplingMode sampling=SamplingMode(lround(param.value));
+    if(sampling < PseudoRandomSampling || sampling > HaltonSampling)
+        throw ParameterException("invalid sampling mode (0 pseudo-random, 1 Sobol or 2 Halton only are allowed)", __FILE__, __func__, __LINE__);
+    getParameter("acceptance", param);
+    Matrix<FloatType,3,8> corners;
+    bool restricted= lround(param.value)!=0 && getAcceptanceCorners(corners);
 
     RayType::ComplexType Samp, Pamp;
     if(polar=='S')
@@ -539,20 +688,42 @@ int UniformGaussianSource::generate(const double wavelength, const char polar)
     }
     random_device rd;
     // if not clean enough use a Mersenne twister as mt19937 gen{rd()};
+    LowDiscrepancySampler sampler(sampling, (uint64_t(rd()) << 32) ^ rd());  // a new randomization of the point set at each call
+    double u[LowDiscrepancySampler::MaxDimensions];
     for(int i=0; i<nRays; ++ i)
     {
-        org <<0, 0, 0;
-        if(sigmaX > 0)
-            org(0)=gaussX(rd);
-        if(sigmaY >0)
-            org(1)=gaussY(rd);
-        dir << 0, 0, 1.L;
-        if(semiXdiv > 0)
-            dir(0)=uniformXprim(rd);
-        if(semiYdiv > 0)
-            dir(1)=uniformYprim(rd);
+        if(sampling!=PseudoRandomSampling)
+        {
+            sampler.point(i, u);  // gaussian deviates by inversion of the distribution function, uniform ones by scaling
+            org << sigmaX*InverseNormalCDF(u[0]), sigmaY*InverseNormalCDF(u[1]), 0;
+            dir << semiXdiv*(2.*u[2]-1.), semiYdiv*(2.*u[3]-1.), 1.L;
+        }
+        else
+        {
+            org <<0, 0, 0;
+            if(sigmaX > 0)
+                org(0)=gaussX(rd);
+            if(sigmaY >0)
+                org(1)=gaussY(rd);
+            dir << 0, 0, 1.L;
+            if(semiXdiv > 0)
+                dir(0)=uniformXprim(rd);
+            if(semiYdiv > 0)
+                dir(1)=uniformYprim(rd);
+        }
+        FloatType weight=1.;
+        if(restricted)  // the directions are drawn again, inside the slopes accepted from this origin, and the ray is weighted by their probability
+        {
+            if(sampling==PseudoRandomSampling)
+                u[2]=CounterRNG::uniform(rd()), u[3]=CounterRNG::uniform(rd());
+            FloatType lower[2], upper[2];
+            acceptedSlopes(corners, org, lower, upper);
+            dir(0)=truncatedUniform(semiXdiv, lower[0], upper[0], u[2], weight);
+            dir(1)=truncatedUniform(semiYdiv, lower[1], upper[1], u[3], weight);
+        }
         dir.normalize();
-        m_impacts.push_back(RayType(RayBaseType(org,dir),wavelength,Samp,Pamp)); // amplitude set to 1 and S polar by default
+        double amplitude=sqrt(double(weight)); // the intensity is proportional to the weight
+        m_impacts.push_back(RayType(RayBaseType(org,dir),wavelength,Samp*amplitude,Pamp*amplitude));
     }
     m_OPDvalid=false;
     return nRays;
@@ -694,3 +865,259 @@ int BMtypeGaussianSource::generate(const double wavelength, const char polar)
 }
 
 
+
+
+//   ----------------   FileSource implementation   --------------------------
+
+FileSource::FileSource(string name ,Surface * previous):Surface(true,name, previous)
+{
+    Parameter param;
+    param.type=Dimensionless;
+    param.group=SourceGroup;
+    param.value=0;
+    param.flags=NotOptimizable;
+    defineParameter("firstRay", param);
+    defineParameter("nRays", param);    // 0 = up to the end of the file
+
+    setHelpstring("firstRay", "index in the file of the first ray to propagate");
+    setHelpstring("nRays", "number of rays to propagate; 0 to read up to the end of the file");
+}
+
+void FileSource::setFile(string filename)
+{
+    shared_ptr<ImpactFileMap> file=make_shared<ImpactFileMap>(filename);
+    if(file->header().frame==SurfaceFrame)
+        throw ParameterException("Rays recorded in the SurfaceFrame cannot be used in a source", __FILE__, __func__, __LINE__);
+    m_file=file;
+    m_filename=filename;
+}
+
+void FileSource::getRange(size_t& first, size_t& count)
+{
+    Parameter param;
+    getParameter("firstRay",param);
+    first=std::min<size_t>(std::max(0L, lround(param.value)), m_file->size());
+    getParameter("nRays",param);
+    count=std::max(0L, lround(param.value));
+    if(count==0 || count > m_file->size()-first)
+        count=m_file->size()-first;
+}
+
+int FileSource::generate(const double wavelength, const char polar)
+{
+    if(!m_file)
+        throw ParameterException(string("No ray file was set in source ")+m_name, __FILE__, __func__, __LINE__);
+    if(polar=='S')
+        m_amplitudeS=1., m_amplitudeP=0;
+    else if(polar=='P')
+        m_amplitudeS=0, m_amplitudeP=1.;
+    else if(polar=='R')
+        m_amplitudeS=sqrt(2.), m_amplitudeP=complex<double>(0,-sqrt(2.));
+    else if(polar=='L')
+        m_amplitudeS=sqrt(2.), m_amplitudeP=complex<double>(0,sqrt(2.));
+    else
+        throw ParameterException("invalid polarization (S, P, R or L only are  allowed)", __FILE__, __func__, __LINE__);
+    m_wavelength=wavelength;
+
+    size_t first, count;
+    getRange(first, count);
+    return count;
+}
+
+int FileSource::radiate()
+{
+    if(!m_file)
+        throw ParameterException(string("No ray file was set in source ")+m_name, __FILE__, __func__, __LINE__);
+    if(m_next==0)
+        return 0;
+
+    const uint32_t fields=m_file->header().fields;
+    const int32_t frame=m_file->header().frame;
+    const Index chunkSize=4096;     // rays decoded at once, small enough to stay in cache
+    vector<RayType> chunk(chunkSize);
+    size_t first, count;
+    getRange(first, count);
+    int losses=0;
+    for(size_t start=first; start < first+count; start+=chunkSize)
+    {
+        Index n=std::min<size_t>(chunkSize, first+count-start);
+        #pragma omp parallel for schedule(static)
+        for(Index i=0; i < n; ++i)
+        {
+            RayType& ray=chunk[i];
+            ray=m_file->getRay(start+i);
+            if(frame==AlignedLocalFrame)
+            {
+                ray.origin()=m_frameDirect*ray.origin();
+                ray.direction()=m_frameDirect*ray.direction();
+            }
+            else if(frame==GeneralFrame)
+                ray-=VectorType(m_exitFrame.translation());
+            if(!(fields & ImpactWavelength))
+                ray.m_wavelength=m_wavelength;
+            if(!(fields & ImpactPolarization))
+            {
+                double scale= (fields & ImpactIntensity) ? abs(ray.m_amplitude_S) : 1.;
+                ray.m_amplitude_S=scale*m_amplitudeS;
+                ray.m_amplitude_P=scale*m_amplitudeP;
+                ray.m_vector_S=VectorType::UnitY().cross(ray.direction()).normalized();
+            }
+        }
+        // propagation is sequential, as in SourceBase::radiate()
+        for(Index i=0; i < n; ++i)
+        {
+            if(!chunk[i].m_alive)
+                continue;
+            losses+=m_next->propagate(chunk[i]);
+        }
+    }
+    return losses;
+}
+
+
+//   ----------------   PhaseSpaceSource implementation   --------------------------
+
+PhaseSpaceSource::PhaseSpaceSource(string name ,Surface * previous):Surface(true,name, previous)
+{
+    Parameter param;
+    param.type=Dimensionless;
+    param.group=SourceGroup;
+    param.value=1000.;
+    param.flags=NotOptimizable;
+    defineParameter("nRays", param);  // 1000 points par défaut
+    param.value=0;
+    defineParameter("seed", param);
+
+    setHelpstring("nRays", " number of rays to be generated");
+    setHelpstring("seed", "seed of the random generator; 0 for a new random seed at each generation");
+}
+
+void PhaseSpaceSource::setTable(int numDims, const int64_t* dims, const double* bounds, const double* density)
+{
+    if(numDims!=4 && numDims!=5)
+        throw ParameterException("The phase space table must have 4 or 5 dimensions", __FILE__, __func__, __LINE__);
+    shared_ptr<Table> table=make_shared<Table>();
+    table->numDims=numDims;
+    size_t numCells=1;
+    for(int k=0; k < numDims; ++k)
+    {
+        if(dims[k] < 1 || !(bounds[2*k+1] >= bounds[2*k]))
+            throw ParameterException("Invalid dimension or bounds of the phase space table", __FILE__, __func__, __LINE__);
+        table->dims[k]=dims[k];
+        table->lower[k]=bounds[2*k];
+        table->width[k]=(bounds[2*k+1]-bounds[2*k])/dims[k];
+        numCells*=dims[k];
+    }
+    if(numDims==5 && table->lower[4] <= 0)
+        throw ParameterException("The photon energies of the phase space table must be positive", __FILE__, __func__, __LINE__);
+    if(numCells > UINT32_MAX)
+        throw ParameterException("The phase space table has too many cells", __FILE__, __func__, __LINE__);
+
+    double total=0;
+    for(size_t i=0; i < numCells; ++i)
+    {
+        if(!(density[i] >= 0) || std::isinf(density[i]))
+            throw ParameterException("The phase space density must be positive and finite", __FILE__, __func__, __LINE__);
+        total+=density[i];
+    }
+    if(total <= 0)
+        throw ParameterException("The phase space density is null everywhere", __FILE__, __func__, __LINE__);
+
+    // Vose's alias method: each cell keeps its own probability and an alias cell receiving the remaining part
+    vector<double>& prob=table->prob;
+    vector<uint32_t>& alias=table->alias;
+    prob.resize(numCells);
+    alias.resize(numCells);
+    vector<uint32_t> small, large;
+    for(size_t i=0; i < numCells; ++i)
+    {
+        prob[i]=density[i]*numCells/total;
+        alias[i]=i;
+        if(prob[i] < 1.)
+            small.push_back(i);
+        else
+            large.push_back(i);
+    }
+    while(!small.empty() && !large.empty())
+    {
+        uint32_t s=small.back(), l=large.back();
+        small.pop_back();
+        alias[s]=l;
+        prob[l]-=1.-prob[s];
+        if(prob[l] < 1.)
+        {
+            large.pop_back();
+            small.push_back(l);
+        }
+    }
+    // the remaining cells are full, up to rounding errors
+    for(uint32_t i : small)
+        prob[i]=1.;
+    for(uint32_t i : large)
+        prob[i]=1.;
+    m_table=table;
+}
+
+int PhaseSpaceSource::generate(const double wavelength, const char polar)
+{
+    if(!m_table)
+        throw ParameterException(string("The phase space table of source ")+m_name+" is not defined", __FILE__, __func__, __LINE__);
+    int nRays;
+    uint64_t seed;
+    Parameter param;
+    getParameter("nRays",param);
+    nRays=lround(param.value);
+    if(nRays<1)
+        nRays=1;
+    getParameter("seed",param);
+    seed=llround(std::max(0., param.value));
+    if(seed==0)
+    {
+        random_device rd;
+        seed=(uint64_t(rd()) << 32) ^ rd();
+    }
+
+    RayType::ComplexType Samp, Pamp;
+    if(polar=='S')
+        Samp=1., Pamp=0;
+    else if(polar=='P')
+        Samp=0, Pamp=1.;
+    else if(polar=='R')
+        Samp=sqrt(2.), Pamp=complex<double>(0,-sqrt(2.));
+    else if(polar=='L')
+        Samp=sqrt(2.), Pamp=complex<double>(0,sqrt(2.));
+    else
+        throw ParameterException("invalid polarization (S, P, R or L only are  allowed)", __FILE__, __func__, __LINE__);
+
+    const Table& table=*m_table;
+    const double numCells=table.prob.size();
+    const double hc=1.239841984e-6;     // photon wavelength (m) times energy (eV)
+    const CounterRNG rng(seed);
+    const size_t first=m_impacts.size();    // the ray index in impacts is the counter, so that successive calls do not repeat the draws
+    m_impacts.resize(first+nRays);
+
+    #pragma omp parallel for schedule(static)
+    for(int i=0; i < nRays; ++i)
+    {
+        uint32_t words[8];
+        rng.block(first+i, 0, words);
+        rng.block(first+i, 1, words+4);
+        size_t cell=std::min(size_t(CounterRNG::uniform(words[0], words[1])*numCells), table.prob.size()-1);
+        if(CounterRNG::uniform(words[2]) >= table.prob[cell])
+            cell=table.alias[cell];
+
+        double coord[5];
+        for(int k=0; k < table.numDims; ++k)
+        {
+            coord[k]=table.lower[k]+(cell % table.dims[k] + CounterRNG::uniform(words[3+k]))*table.width[k];
+            cell/=table.dims[k];
+        }
+        VectorType org, dir;
+        org << coord[0], coord[1], 0;
+        dir << coord[2], coord[3], 1.L;
+        dir.normalize();
+        m_impacts[first+i]=RayType(RayBaseType(org,dir), table.numDims==5 ? hc/coord[4] : wavelength, Samp, Pamp);
+    }
+    m_OPDvalid=false;
+    return nRays;
+}
@@ -0,0 +1,127 @@
+////////////////////////////////////////////////////////////////////////////////
+/**
+*      \file           spectrum.cpp
+*
+*      \brief         Multi-wavelength ray tracing implementation
+*
+*      \author         François Polack <francois.polack@synchroton-soleil.fr>
+*      \date        2024-10-30  Creation
+*      \date         Last update
+*
+
+*/
+///////////////////////////////////////////////////////////////////////////////////
+//
+//             REVISIONS
+//
+////////////////////////////////////////////////////////////////////////////////////
+
+#include "spectrum.h"
+#include "opticalelements.h"
+#include "OptixException.h"
+#include <cmath>
+#include <omp.h>
+
+using namespace std;
+
+int64_t RadiateSpectrum(SourceBase* source, const vector<double>& wavelengths, const vector<double>& weights,
+                        double alignmentWavelength, Surface* target, SpotStatistics* statistics)
+{
+    // all checks are done before entering the parallel section where no error can be reported
+    if(source->sizeImpacts()==0)
+        throw ParameterException(string("source ")+source->getName()+" has no generated rays", __FILE__, __func__, __LINE__);
+    if(!weights.empty() && weights.size()!=wavelengths.size())
+        throw ParameterException("the number of weights differs from the number of wavelengths", __FILE__, __func__, __LINE__);
+    for(size_t i=0; i < wavelengths.size(); ++i)
+    {
+        if(wavelengths[i] <= 0)
+            throw ParameterException("wavelengths must be positive", __FILE__, __func__, __LINE__);
+        if(!weights.empty() && weights[i] < 0)
+            throw ParameterException("weights cannot be negative", __FILE__, __func__, __LINE__);
+    }
+    if(alignmentWavelength < 0)
+        throw ParameterException("invalid alignment wavelength", __FILE__, __func__, __LINE__);
+    Surface* first=NULL;
+    bool targetFound=false;
+    for(ElementBase* pElem=source->getNext(); pElem; pElem=pElem->getNext())
+    {
+        Surface* psurf=dynamic_cast<Surface*>(pElem);
+        if(!psurf)
+            throw ElementException("Group object not implemented", __FILE__,__func__);
+        if(!first)
+            first=psurf;
+        if(psurf==target)
+            targetFound=true;
+        // impacts recorded in frames of different alignments could not be converted with the frames of the original chain
+        if(alignmentWavelength==0 && (psurf->getRecording()==RecordInput || psurf->getRecording()==RecordOutput))
+            throw ParameterException(string("surface ")+psurf->getName()+" records impacts, which requires a fixed alignment wavelength",
+                                     __FILE__, __func__, __LINE__);
+    }
+    if(target && !targetFound)
+        throw ParameterException(string("target surface ")+target->getName()+" is not downstream of source "+source->getName(),
+                                 __FILE__, __func__, __LINE__);
+    if(target && target->getRecording()==RecordNone)
+        throw ParameterException(string("target surface ")+target->getName()+" does not record impacts or statistics",
+                                 __FILE__, __func__, __LINE__);
+    if(!first)
+        return 0;
+
+    if(alignmentWavelength > 0 && source->alignFromHere(alignmentWavelength))
+        throw ElementException("System alignment failed", __FILE__, __func__, __LINE__);
+    first->clearImpacts();
+    // the copies are duplicated from a model chain which is not modified, while the original chain receives the recordings
+    ChainCopy model;
+    if(!DuplicateChain(source, model))
+        throw ElementException("Failed to duplicate the element chain", __FILE__, __func__, __LINE__);
+
+    int64_t losses=0;
+    string firstError;
+    int numWavelengths=int(wavelengths.size());
+    #pragma omp parallel for schedule(dynamic) ordered reduction(+:losses)
+    for(int i=0; i < numWavelengths; ++i)
+    {
+        ChainCopy chain;
+        bool traced=false;
+        try
+        {
+            if(!DuplicateChain(model.First, chain))
+                throw ElementException("Failed to duplicate the element chain", __FILE__, __func__, __LINE__);
+            SourceBase* sourceCopy=dynamic_cast<SourceBase*>(chain.First);
+            if(sourceCopy->alignFromHere(alignmentWavelength > 0 ? alignmentWavelength : wavelengths[i]))
+                throw ElementException("System alignment failed", __FILE__, __func__, __LINE__);
+            sourceCopy->setWavelength(wavelengths[i]);
+            if(!weights.empty())
+                sourceCopy->scaleAmplitudes(sqrt(weights[i]));
+            losses+=sourceCopy->radiate();
+            if(target && statistics)
+                statistics[i]=dynamic_cast<Surface*>(chain.copyMap.at(model.copyMap.at(target)))->getSpotStatistics();
+            traced=true;
+        }
+        catch(OptixException& ex)
+        {
+            #pragma omp critical (SpectrumError)
+            {
+                if(firstError.empty())
+                    firstError=string("wavelength ")+to_string(wavelengths[i])+": "+ex.what();
+            }
+        }
+        catch(std::exception& ex)
+        {
+            #pragma omp critical (SpectrumError)
+            {
+                if(firstError.empty())
+                    firstError=string("wavelength ")+to_string(wavelengths[i])+": "+ex.what();
+            }
+        }
+        // the recordings are appended to the original chain in the order of the wavelength list
+        #pragma omp ordered
+        if(traced)
+        {
+            for(ElementBase* pElem=first; pElem; pElem=pElem->getNext())
+                dynamic_cast<Surface*>(pElem)->mergeRecording(*dynamic_cast<Surface*>(chain.copyMap.at(model.copyMap.at(pElem))));
+        }
+    }
+    if(!firstError.empty())
+        throw RayException(firstError, __FILE__, __func__, __LINE__);
+    return losses;
+}
@@ -17,6 +17,8 @@
 #include "wavefront.h" // needed from Legendre fits of optical surfaces and wave-fronts
 #include "fractalsurface.h" // needed to generate surface errors
 #include <exception>
+#include <random>
+#include <algorithm>
 
 #define NFFT_PRECISION_DOUBLE
 #include <nfft3mp.h>
@@ -76,12 +78,13 @@ void Surface::applyPerturbation(Vector2d& spos, RayType& ray, VectorType& normal
 
 RayType& Surface::transmit(RayType& ray)
 {
+    VectorType normal;
+    bool reflectance=enableReflectivity && m_reflectance;
     ray-=m_translationFromPrevious;
-    intercept(ray); // intercept n'effectue  pas le changement de repère previous to this. The position is updated only if the ray is alive
+    intercept(ray, reflectance ? &normal : NULL); // intercept n'effectue  pas le changement de repère previous to this. The position is updated only if the ray is alive
     if(ray.m_alive)
     {
-        if(m_recording==RecordInput)
-            m_impacts.push_back(ray);
+        recordImpact(ray, RecordInput);
 
         if(enableApertureLimit && m_apertureActive)
         {
@@ -91,11 +94,30 @@ RayType& Surface::transmit(RayType& ray)
             ray.m_amplitude_S*=T;
         }
 
-        if(m_recording==RecordOutput)
-            m_impacts.push_back(ray);
+        if(reflectance)
+        {   // the polarization is converted to the frame of the surface (see reflect()), the ray direction is unchanged
+            Vector2cd A;
+            A << ray.m_amplitude_S, ray.m_amplitude_P;
+            VectorType Sdir=normal.cross(ray.direction());
+            if(Sdir.norm() > 1e-12) // S and P are undefined at normal incidence, where they are equivalent
+            {
+                Matrix<double,3,2> pol0, pol;
+                pol0.col(0)=ray.m_vector_S.cast<double>();
+                pol0.col(1)=ray.direction().cross(ray.m_vector_S).cast<double>();
+                ray.m_vector_S=Sdir.normalized();
+                pol.col(0)=ray.m_vector_S.cast<double>();
+                pol.col(1)=ray.direction().cross(ray.m_vector_S).cast<double>();
+                A=pol.transpose()*pol0 *A;
+            }
+            applyReflectance(ray, ray.direction().dot(normal), A);
+            ray.m_amplitude_S=A(0);
+            ray.m_amplitude_P=A(1);
+        }
+
+        recordImpact(ray, RecordOutput);
     }
     else if(m_recording)
-        m_impacts.push_back(ray);
+        recordLostRay(ray);
 
     if(m_OPDvalid && m_recording)
         m_OPDvalid=false;
@@ -128,8 +150,7 @@ RayType& Surface::reflect(RayType& ray)    /*  this implementation simply reflec
     try{
         if(ray.m_alive)
         {
-            if(m_recording==RecordInput)
-                m_impacts.push_back(ray);
+            recordImpact(ray, RecordInput);
             // find pos in surface frame 2024/05/27 moved out of aperture case as needed also by surf.errors
             Vector2d spos=(m_surfaceInverse*ray.position()).head(2).cast<double>();
 
@@ -169,14 +190,14 @@ RayType& Surface::reflect(RayType& ray)    /*  this implementation simply reflec
             Vector2cd A0, A;
             A0 << ray.m_amplitude_S, ray.m_amplitude_P;
             A=pol.transpose()*pol0 *A0; // les matrices pol sont unitaires
+            applyReflectance(ray, singrazing, A);
             ray.m_amplitude_S=A(0);
             ray.m_amplitude_P=A(1);
 
-            if(m_recording==RecordOutput)
-                m_impacts.push_back(ray);
+            recordImpact(ray, RecordOutput);
         }
         else if(m_recording)
-                m_impacts.push_back(ray);
+                recordLostRay(ray);
 
         if(m_OPDvalid && m_recording)
             m_OPDvalid=false;
@@ -270,8 +291,13 @@ void Surface::operator<<(xmlNodePtr surfnode)
 void Surface::clearImpacts()
 {
     m_impacts.clear();
+    m_impactStore.clear();
+    m_filterCount=0;
     m_OPDvalid=false;
     m_lostCount=0;
+    if(m_recording >= RecordInputStatistics)
+        m_statistics.assign(omp_get_max_threads(), SpotStatistics());
+    m_overflowStatistics=SpotStatistics();
     if(m_next!=NULL)
     {
         Surface* psurf=dynamic_cast<Surface*>(m_next);
@@ -284,56 +310,300 @@ void Surface::clearImpacts()
 
 void Surface::reserveImpacts(int n)
 {
-    if(m_recording!=RecordNone) // added 18/05/23 (no reason to reserve space for non recording surfaces)
-        m_impacts.reserve(n);
+    if(m_recording==RecordInput || m_recording==RecordOutput) // added 18/05/23 (no reason to reserve space for non recording surfaces)
+    {
+        if(m_impactStore.isActive())
+            m_impactStore.reserve(n);
+        else
+            m_impacts.reserve(n);
+    }
     if(m_next!=NULL)
         dynamic_cast<Surface*>(m_next)->reserveImpacts(n);
 }
 
-int Surface::getImpacts(vector<RayType> &impacts, FrameID frame)
+size_t Surface::allocateImpactArena(size_t nRays, bool hugePages)
 {
-    int lostCount=0;
+    vector<Surface*> users;
+    for(ElementBase* pElem=this; pElem; pElem=pElem->getNext())
+    {
+        Surface* psurf=dynamic_cast<Surface*>(pElem);
+        if(!psurf)     //this is a group
+            throw ElementException("Group object not implemented", __FILE__,__func__);
+        if(psurf==this || ((psurf->m_recording==RecordInput || psurf->m_recording==RecordOutput) && !psurf->m_impactStore.isActive()))
+            users.push_back(psurf);
+    }
+    const size_t sliceSize=((nRays*sizeof(RayType)+63)/64)*64;    // slices are aligned on cache lines
+    shared_ptr<ImpactArena> arena=make_shared<ImpactArena>(sliceSize*users.size(), hugePages);
+    for(size_t i=0; i < users.size(); ++i)
+    {
+        shared_ptr<ArenaSlice> slice=make_shared<ArenaSlice>();
+        slice->arena=arena;
+        slice->begin=arena->data()+i*sliceSize;
+        slice->capacity=sliceSize;
+        ImpactVector impacts{ArenaAllocator<RayType>(slice)};
+        impacts.reserve(nRays);
+        impacts.insert(impacts.end(), users[i]->m_impacts.begin(), users[i]->m_impacts.end());
+        users[i]->m_impacts=std::move(impacts);
+    }
+    return arena->size();
+}
 
-    impacts.reserve(m_impacts.size());
-    vector<RayType>::iterator it;
-    for(it=m_impacts.begin(); it != m_impacts.end(); ++it)
+void Surface::releaseImpactArena()
+{
+    for(ElementBase* pElem=this; pElem; pElem=pElem->getNext())
     {
-//        RayType ray(*it);
-        RayType ray=*it;
-        if(!ray.m_alive)
+        Surface* psurf=dynamic_cast<Surface*>(pElem);
+        if(!psurf)     //this is a group
+            throw ElementException("Group object not implemented", __FILE__,__func__);
+        if(psurf->m_impacts.get_allocator().m_slice)
+        {
+            ImpactVector impacts(psurf->m_impacts.begin(), psurf->m_impacts.end());
+            psurf->m_impacts=std::move(impacts);
+        }
+    }
+}
+
+bool Surface::getApertureCorners(Matrix<FloatType,3,8> &corners)
+{
+    Vector2d lower, upper;
+    if(!enableApertureLimit || !m_apertureActive || !m_aperture.getBoundingBox(lower, upper))
+        return false;
+    // range of the surface heights over the bounding box, sampled on a grid including the box edges
+    const int n=9;
+    FloatType hmin=0, hmax=0;
+    VectorType dir=m_surfaceDirect.linear()*VectorType::UnitZ(), org;
+    for(int j=0; j < n; ++j)
+        for(int i=0; i < n; ++i)
         {
-            ++lostCount;
-            continue; // invalid rays are not returned but counted as "lost" . The alive ray count is given by impacts.size()
-                    // NB in principle the total number of rays dead and alive can be obtained by impacts.capacity() unless shrink_to_fit is called
+            org << lower(0)+(upper(0)-lower(0))*i/(n-1), lower(1)+(upper(1)-lower(1))*j/(n-1), 0;
+            RayBaseType ray(m_surfaceDirect*org, dir);
+            VectorType spos=m_surfaceInverse*intercept(ray);
+            if(!ray.m_alive)
+                continue;   // the box may extend beyond a closed surface
+            hmin=min(hmin, spos(2));
+            hmax=max(hmax, spos(2));
         }
-        switch(frame)
+    // X/Z and Y/Z are linear fractional functions of the position, so their extrema over the box are reached at its corners
+    for(int k=0; k < 8; ++k)
+    {
+        VectorType spos((k & 1) ? upper(0) : lower(0), (k & 2) ? upper(1) : lower(1), (k & 4) ? hmax : hmin);
+        corners.col(k)=m_translationFromPrevious+m_surfaceDirect*spos;
+    }
+    return true;
+}
+
+int Surface::getImpacts(vector<RayType> &impacts, FrameID frame)
+{
+    vector<size_t> alive;
+    int lostCount=getAliveImpacts(alive); // invalid rays are not returned but counted as "lost" . The alive ray count is given by impacts.size()
+
+    impacts.reserve(alive.size());
+    for(vector<size_t>::iterator it=alive.begin(); it != alive.end(); ++it)
+        impacts.push_back(getImpactInFrame(*it, frame));
+    return lostCount;
+}
+
+void Surface::accumulateStatistics(RayType& ray, RecordMode space)
+{
+    if(!ray.m_alive)
+    {
+        addToStatistics(NULL);
+        return;
+    }
+    RotationType& toAligned=(space==RecordInput && m_previous) ? m_previous->exitFrameInverse() : m_frameInverse;
+    RayType alignedRay(ray);
+    alignedRay.origin()=toAligned*ray.origin();
+    alignedRay.direction()=toAligned*ray.direction();
+    alignedRay.moveToPlane(RayType::PlaneType(VectorType::UnitZ(), 0));
+    Vector4d spot;
+    spot << alignedRay.position().segment(0,2).cast<double>(), alignedRay.direction().segment(0,2).cast<double>();
+    addToStatistics(&spot);
+}
+
+void Surface::addToStatistics(const Vector4d* spot)
+{
+    size_t thread=omp_get_thread_num();
+    if(thread < m_statistics.size())
+    {
+        if(spot)
+            m_statistics[thread].add(*spot);
+        else
+            ++m_statistics[thread].m_lost;
+        return;
+    }
+    #pragma omp critical (SurfaceStatisticsOverflow)
+    {
+        if(spot)
+            m_overflowStatistics.add(*spot);
+        else
+            ++m_overflowStatistics.m_lost;
+    }
+}
+
+void Surface::setRecordingFilter(const RecordingFilter& filter)
+{
+    if(filter.roiShape < RoiNone || filter.roiShape > RoiEllipse)
+        throw ParameterException("Invalid region of interest shape", __FILE__, __func__, __LINE__);
+    if(filter.roiFrame < GeneralFrame || filter.roiFrame > SurfaceFrame)
+        throw ParameterException("Invalid frame of the region of interest", __FILE__, __func__, __LINE__);
+    if(filter.roiShape!=RoiNone && (filter.roiHalfSize[0] <= 0 || filter.roiHalfSize[1] <= 0))
+        throw ParameterException("The sizes of the region of interest must be positive", __FILE__, __func__, __LINE__);
+    if(filter.probability <= 0)
+        throw ParameterException("The recording probability must be positive", __FILE__, __func__, __LINE__);
+    m_recordFilter=filter;
+    m_filterActive= filter.roiShape!=RoiNone || filter.stride > 1 || filter.probability < 1. || filter.aliveOnly || filter.orderActive;
+    m_filterCount=0;
+}
+
+bool Surface::acceptImpact(RayType& ray, RecordMode space)
+{
+    if(m_recordFilter.orderActive && ray.m_order!=m_recordFilter.order)
+        return false;
+    if(!ray.m_alive)
+    {
+        if(m_recordFilter.aliveOnly || m_recordFilter.roiShape!=RoiNone) // lost rays have no valid position
+            return false;
+    }
+    else if(m_recordFilter.roiShape!=RoiNone)
+    {
+        VectorType position=ray.position();
+        switch(m_recordFilter.roiFrame)
         {
         case AlignedLocalFrame:
-            if(m_recording==RecordInput && m_previous)
-            {
-                ray.origin()=m_previous->exitFrameInverse()*it->origin();
-                ray.direction()=m_previous->exitFrameInverse()*it->direction();
-            }
-            else
-            {
-                ray.origin()=m_frameInverse*it->origin();
-                ray.direction()=m_frameInverse*it->direction();
-            }
+            position= (space==RecordInput && m_previous) ? m_previous->exitFrameInverse()*position : m_frameInverse*position;
             break;
         case SurfaceFrame:
-            ray.origin()=m_surfaceInverse*it->origin();
-            ray.direction()=m_surfaceInverse*it->direction();
+            position=m_surfaceInverse*position;
             break;
         case GeneralFrame:
-            ray+=m_exitFrame.translation();
-            break;
-        case LocalAbsoluteFrame:
+            position+=m_exitFrame.translation();
             break;
         }
-        impacts.push_back(ray);
+        double u=(position(0)-m_recordFilter.roiCenter[0])/m_recordFilter.roiHalfSize[0];
+        double v=(position(1)-m_recordFilter.roiCenter[1])/m_recordFilter.roiHalfSize[1];
+        if(m_recordFilter.roiShape==RoiRectangle ? (abs(u) > 1. || abs(v) > 1.) : (u*u+v*v > 1.))
+            return false;
+    }
+    if(m_recordFilter.stride <= 1 && m_recordFilter.probability >= 1.)
+        return true;
 
+    uint64_t count;
+    #pragma omp atomic capture
+    count=m_filterCount++;
+    if(m_recordFilter.stride > 1 && count % m_recordFilter.stride)
+        return false;
+    if(m_recordFilter.probability < 1.)
+    {
+        // counter based draw (splitmix64 hash of the seed and ray count), so that a given seed selects the same rays
+        uint64_t z=m_recordFilter.seed + (count+1)*0x9E3779B97F4A7C15ULL;
+        z=(z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z=(z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        z^= z >> 31;
+        if((z >> 11)*0x1.0p-53 >= m_recordFilter.probability)
+            return false;
     }
-    return lostCount;
+    return true;
+}
+
+SpotStatistics Surface::getSpotStatistics()
+{
+    SpotStatistics total;
+    if(m_recording==RecordInput || m_recording==RecordOutput)
+    {
+        RayType::PlaneType alignedPlane(VectorType::UnitZ(), 0);
+        for(size_t i=0; i < size_t(sizeImpacts()); ++i)
+        {
+            RayType ray=getImpactInFrame(i, AlignedLocalFrame);
+            if(m_orderSelected && ray.m_order!=m_selectedOrder)
+                continue;
+            if(!ray.m_alive)
+            {
+                ++total.m_lost;
+                continue;
+            }
+            ray.moveToPlane(alignedPlane);
+            Vector4d spot;
+            spot << ray.position().segment(0,2).cast<double>(), ray.direction().segment(0,2).cast<double>();
+            total.add(spot);
+        }
+        return total;
+    }
+    for(vector<SpotStatistics>::iterator it=m_statistics.begin(); it!=m_statistics.end(); ++it)
+        total.merge(*it);
+    total.merge(m_overflowStatistics);
+    return total;
+}
+
+void Surface::mergeRecording(Surface& copy)
+{
+    if(m_impactStore.isActive())
+        m_impactStore.insert(copy.m_impactStore);
+    else
+        m_impacts.insert(m_impacts.end(), copy.m_impacts.begin(), copy.m_impacts.end());
+    if(m_recording >= RecordInputStatistics)
+        m_statistics[0].merge(copy.getSpotStatistics());
+    m_lostCount+=copy.m_lostCount;
+    m_OPDvalid=false;
+}
+
+int Surface::getAliveImpacts(vector<size_t> &aliveIndexes)
+{
+    aliveIndexes.clear();
+    size_t selected=0;
+    if(m_impactStore.isActive())
+    {
+        aliveIndexes.reserve(m_impactStore.size());
+        for(size_t i=0; i < m_impactStore.size(); ++i)
+        {
+            if(m_orderSelected && m_impactStore.getOrder(i)!=m_selectedOrder)
+                continue;
+            ++selected;
+            if(m_impactStore.isAlive(i))
+                aliveIndexes.push_back(i);
+        }
+        return selected-aliveIndexes.size();
+    }
+    aliveIndexes.reserve(m_impacts.size());
+    for(size_t i=0; i < m_impacts.size(); ++i)
+    {
+        if(m_orderSelected && m_impacts[i].m_order!=m_selectedOrder)
+            continue;
+        ++selected;
+        if(m_impacts[i].m_alive)
+            aliveIndexes.push_back(i);
+    }
+    return selected-aliveIndexes.size();
+}
+
+RayType Surface::getImpactInFrame(size_t index, FrameID frame)
+{
+    // in compact recording the impact is rebuilt from the stored columns
+    RayType ray= m_impactStore.isActive() ? m_impactStore.getRay(index) : m_impacts[index];
+    switch(frame)
+    {
+    case AlignedLocalFrame:
+        if(m_recording==RecordInput && m_previous)
+        {
+            ray.origin()=m_previous->exitFrameInverse()*ray.origin();
+            ray.direction()=m_previous->exitFrameInverse()*ray.direction();
+        }
+        else
+        {
+            ray.origin()=m_frameInverse*ray.origin();
+            ray.direction()=m_frameInverse*ray.direction();
+        }
+        break;
+    case SurfaceFrame:
+        ray.origin()=m_surfaceInverse*ray.origin();
+        ray.direction()=m_surfaceInverse*ray.direction();
+        break;
+    case GeneralFrame:
+        ray+=m_exitFrame.translation();
+        break;
+    case LocalAbsoluteFrame:
+        break;
+    }
+    return ray;
 }
 
 int Surface::getSpotDiagram(Diagram & spotDiagram, double distance)
@@ -346,10 +616,10 @@ int Surface::getSpotDiagram(Diagram & spotDiagram, double distance)
         throw std::invalid_argument("SpotDiagram argument should have a vector dimension of at least 4");
 
 
-    vector<RayType> impacts;
-    spotDiagram.m_lost=getImpacts(impacts,AlignedLocalFrame);
+    vector<size_t> alive;
+    spotDiagram.m_lost=getAliveImpacts(alive);
 
-    spotDiagram.m_count=impacts.size();
+    spotDiagram.m_count=alive.size();
     if(spotDiagram.m_count==0)
         return 0;
     if(spotDiagram.m_spots)  // buffer is allocated
@@ -368,37 +638,33 @@ int Surface::getSpotDiagram(Diagram & spotDiagram, double distance)
     Map<VectorXd> vMean(spotDiagram.m_mean, spotDiagram.m_dim),vSigma(spotDiagram.m_sigma,spotDiagram.m_dim);
     Map<VectorXd> vMin(spotDiagram.m_min,spotDiagram.m_dim), vMax(spotDiagram.m_max,spotDiagram.m_dim);
 
-    vector<RayType>::iterator pRay;
-
     RayType::PlaneType obsPlane(VectorType::UnitZ(), -distance);  // equation UnitZ*X - distance =0
-    Index ip;
-    for(ip=0, pRay=impacts.begin(); pRay!=impacts.end(); ++pRay)
+    Index ip, count=spotDiagram.m_count, dim=spotDiagram.m_dim;
+    // each alive impact is read from m_impacts, transformed and written to its own column, in parallel
+    #pragma omp parallel for schedule(static)
+    for(ip=0; ip < count; ++ip)
     {
-        if(pRay->m_alive)  // cette précaution est inutile getImpact ne retourne que des rayons valides (et seulement le compt des rayons perdus)
+        RayType ray=getImpactInFrame(alive[ip], AlignedLocalFrame);
+        ray.moveToPlane(obsPlane);
+        spotMat.block<2,1>(0,ip)=ray.position().segment(0,2).cast<double>();
+        spotMat.block<2,1>(2,ip)=ray.direction().segment(0,2).cast<double>();
+
+        double Is,Ip;
+        complex<double> prod;
+        if(dim>4)
+            spotMat(4,ip)=ray.m_wavelength;
+        if(dim>5)
         {
-            pRay->moveToPlane(obsPlane);
-            spotMat.block<2,1>(0,ip)=pRay->position().segment(0,2).cast<double>();
-            spotMat.block<2,1>(2,ip)=pRay->direction().segment(0,2).cast<double>();
-
-            double Is,Ip;
-            complex<double> prod;
-            if(spotDiagram.m_dim>4)
-                spotMat(4,ip)=pRay->m_wavelength;
-            if(spotDiagram.m_dim>5)
-            {
-                Is=norm(pRay->m_amplitude_S);
-                Ip=norm(pRay->m_amplitude_P);
-                spotMat(5,ip)=Is+Ip;
-            }
-            if(spotDiagram.m_dim>8)
-            {
-                prod=conj(pRay->m_amplitude_S)*pRay->m_amplitude_P;
-                spotMat(6,ip)=Is-Ip;
-                spotMat(7,ip)=prod.real();
-                spotMat(8,ip)=prod.imag();
-            }
-
-            ++ip;
+            Is=norm(ray.m_amplitude_S);
+            Ip=norm(ray.m_amplitude_P);
+            spotMat(5,ip)=Is+Ip;
+        }
+        if(dim>8)
+        {
+            prod=conj(ray.m_amplitude_S)*ray.m_amplitude_P;
+            spotMat(6,ip)=Is-Ip;
+            spotMat(7,ip)=prod.real();
+            spotMat(8,ip)=prod.imag();
         }
     }
     vMin=spotMat.rowwise().minCoeff();
@@ -407,71 +673,171 @@ int Surface::getSpotDiagram(Diagram & spotDiagram, double distance)
 //        Array4d temp=spotMat.rowwise().squaredNorm()/spotDiagram.m_count;
 //        vSigma=(temp-vMean.array().square()).sqrt();
     vSigma=(spotMat.rowwise().squaredNorm().array()/spotDiagram.m_count-vMean.array().square()).sqrt();
-    return ip;
+    return count;
 }
 
-Tensor<int32_t,3> Surface::getFocalDiagram(const int dims[3], const double zbound[2], double* xbound, double * ybound)
+template<typename Scalar>
+void Surface::fillFocalDiagram(Tensor<Scalar,3>& diagram, const double zbound[2], double* xbound, double * ybound, bool weighted)
 {
-    Tensor<int32_t,3> diagram;
-    vector<RayType> impacts;
-    /*int lost=*/ getImpacts(impacts,AlignedLocalFrame);
-
-    int spotcount=impacts.size();
+    diagram.setZero();
+    vector<size_t> alive;
+    /*int lost=*/ getAliveImpacts(alive);
+    Index spotcount=alive.size();
     if(spotcount ==0)
-        return diagram;
+        return;
 
-    diagram.resize(dims[0], dims[1], dims[2]);
-    diagram.setZero();
-//    RayType::PlaneType obsPlane(VectorType::UnitZ(), 0);
+    const Index nx=diagram.dimension(0), ny=diagram.dimension(1), nz=diagram.dimension(2);
+    const double zstep= nz > 1 ? (zbound[1]-zbound[0])/(nz-1) : 0;
 
-    Matrix<FloatType,2,Dynamic> pos(2,spotcount), dir(2,spotcount);
-    Index ip;
-    vector<RayType>::iterator pRay;
-    for(ip=0, pRay=impacts.begin(); pRay!=impacts.end(); ++pRay)
+    // first pass: the trajectories being straight lines, the volume limits are reached at zmin or zmax
+    double xmin=numeric_limits<double>::max(), xmax=-xmin, ymin=xmin, ymax=-xmin;
+    #pragma omp parallel for schedule(static) reduction(min:xmin,ymin) reduction(max:xmax,ymax)
+    for(Index ip=0; ip < spotcount; ++ip)
     {
-        if(pRay->m_alive) // useless precaution
+        RayType ray=getImpactInFrame(alive[ip], AlignedLocalFrame);
+        Vector2d pos=ray.position().segment(0,2).cast<double>();
+        Vector2d slope=(ray.direction().segment(0,2)/ray.direction()(2)).cast<double>();
+        for(int iz=0; iz < 2; ++iz)
         {
-//            pRay->moveToPlane(obsPlane);
-            pos.col(ip)=pRay->position().segment(0,2);
-            dir.col(ip)=pRay->direction().segment(0,2)/pRay->direction()(2);
-            ++ip;
+            Vector2d spot=pos+zbound[iz]*slope;
+            xmin=std::min(xmin, spot(0));
+            xmax=std::max(xmax, spot(0));
+            ymin=std::min(ymin, spot(1));
+            ymax=std::max(ymax, spot(1));
         }
     }
+    if(xbound)
+    {
+        xbound[0]=xmin;
+        xbound[1]=xmax;
+    }
+    if(ybound)
+    {
+        ybound[0]=ymin;
+        ybound[1]=ymax;
+    }
+    // inverse steps; a degenerate axis collapses on its first sample
+    const double xscale= (nx > 1 && xmax > xmin) ? (nx-1)/(xmax-xmin) : 0;
+    const double yscale= (ny > 1 && ymax > ymin) ? (ny-1)/(ymax-ymin) : 0;
+
+    // second pass: the ray data are converted once to grid units, then the z planes, which are independent, are distributed over the threads
+    Array<double,5,Dynamic> rays(5, spotcount); // x, y, slope x, slope y, weight
+    #pragma omp parallel for schedule(static)
+    for(Index ip=0; ip < spotcount; ++ip)
+    {
+        RayType ray=getImpactInFrame(alive[ip], AlignedLocalFrame);
+        rays(0,ip)=(ray.position()(0)-xmin)*xscale;
+        rays(1,ip)=(ray.position()(1)-ymin)*yscale;
+        rays(2,ip)=ray.direction()(0)/ray.direction()(2)*xscale;
+        rays(3,ip)=ray.direction()(1)/ray.direction()(2)*yscale;
+        rays(4,ip)= weighted ? norm(ray.m_amplitude_S)+norm(ray.m_amplitude_P) : 1.;
+    }
+    #pragma omp parallel for schedule(dynamic)
+    for(Index iz=0; iz < nz; ++iz)
+    {
+        double z=zbound[0]+iz*zstep;
+        for(Index ip=0; ip < spotcount; ++ip)
+        {
+            // bounds are checked in double to avoid any integer overflow; rounding errors may bring a limit point slightly outside
+            double fx=round(rays(0,ip)+z*rays(2,ip)), fy=round(rays(1,ip)+z*rays(3,ip));
+            if(fx < 0 || fx >= nx || fy < 0 || fy >= ny)
+                continue;
+            diagram(Index(fx), Index(fy), iz)+=Scalar(rays(4,ip));
+        }
+    }
+}
 
-    Vector<FloatType,Dynamic> zval=Vector<FloatType, Dynamic>::LinSpaced(dims[2],zbound[0],zbound[1]);
-    Array<FloatType,Dynamic,Dynamic> matx, maty;
-//    cout << "zval\n" << zval.transpose() << endl;
+Tensor<int32_t,3> Surface::getFocalDiagram(const int dims[3], const double zbound[2], double* xbound, double * ybound)
+{
+    Tensor<int32_t,3> diagram(dims[0], dims[1], dims[2]);
+    fillFocalDiagram(diagram, zbound, xbound, ybound, false);
+    return diagram;
+}
+
+Tensor<double,3> Surface::getIntensityFocalDiagram(const int dims[3], const double zbound[2], double* xbound, double * ybound)
+{
+    Tensor<double,3> diagram(dims[0], dims[1], dims[2]);
+    fillFocalDiagram(diagram, zbound, xbound, ybound, true);
+    return diagram;
+}
 
-    matx=(zval*dir.row(0)).array().rowwise()+pos.row(0).array(); //  xstep).round().cast<int>();
-    maty=(zval*dir.row(1)).array().rowwise()+pos.row(1).array(); // /ystep).round().cast<int>();
-//    cout << "size="<< matx(seqN(0, 2, nz-1),all).size() <<endl;
-    xbound[0]=matx(seqN(0, 2, dims[2]-1),all).minCoeff() ;
-    xbound[1]=matx(seqN(0, 2, dims[2]-1),all).maxCoeff() ;
-    ybound[0]=maty(seqN(0, 2, dims[2]-1),all).minCoeff() ;
-    ybound[1]=maty(seqN(0, 2, dims[2]-1),all).maxCoeff() ;
 
-    double xstep=(xbound[1]-xbound[0])/(dims[0]-1);
-    double ystep=(ybound[1]-ybound[0])/(dims[1]-1);
-    cout <<"X " << xbound[0] <<", " << xbound[1] << "  step " <<  xstep << endl;
-    cout <<"y " << ybound[0] <<", " << ybound[1] << "  step " <<  ystep << endl;
-    matx=(matx-xbound[0])/xstep;
-    maty=(maty-ybound[0])/ystep;
+int Surface::getBestFocus(BestFocus& focus, bool intensityWeighted)
+{
+    vector<size_t> alive;
+    getAliveImpacts(alive);
+    Index spotcount=alive.size();
+    const double NaN=numeric_limits<double>::quiet_NaN();
+    focus.zX=focus.zY=focus.z=focus.waistX=focus.waistY=focus.waist=focus.meanX=focus.meanY=NaN;
+    focus.count=spotcount;
+    if(spotcount==0)
+        return 0;
 
-    Index i,iz=0;
-    for( i=0; i< spotcount; ++i)
+    // spot vector (x0, y0, x', y') on the plane Z=0 of the aligned frame
+    auto spotAt=[this, &alive](Index ip, double& weight, bool weighted) -> Array4d
+    {
+        RayType ray=getImpactInFrame(alive[ip], AlignedLocalFrame);
+        RayType::VectorType slope=ray.direction()/ray.direction()(2);
+        Array4d spot;
+        spot << (ray.position().segment(0,2)-ray.position()(2)*slope.segment(0,2)).cast<double>(), slope.segment(0,2).cast<double>();
+        weight= weighted ? norm(ray.m_amplitude_S)+norm(ray.m_amplitude_P) : 1.;
+        return spot;
+    };
+
+    // sums are accumulated relatively to the first impact to limit the cancellation errors
+    double weight;
+    const Array4d shift=spotAt(0, weight, false);
+    double W=0;
+    Array4d S1=Array4d::Zero(); // x0, y0, x', y'
+    Array<double,6,1> S2=Array<double,6,1>::Zero();  // x0*x0, x0*x', x'*x', y0*y0, y0*y', y'*y'
+    #pragma omp parallel
     {
-        for(iz=0; iz <dims[2]; ++iz)
+        double localW=0;
+        Array4d localS1=Array4d::Zero();
+        Array<double,6,1> localS2=Array<double,6,1>::Zero();
+        #pragma omp for schedule(static)
+        for(Index ip=0; ip < spotcount; ++ip)
+        {
+            double w;
+            Array4d d=spotAt(ip, w, intensityWeighted)-shift;
+            localW+=w;
+            localS1+=w*d;
+            localS2(0)+=w*d(0)*d(0);
+            localS2(1)+=w*d(0)*d(2);
+            localS2(2)+=w*d(2)*d(2);
+            localS2(3)+=w*d(1)*d(1);
+            localS2(4)+=w*d(1)*d(3);
+            localS2(5)+=w*d(3)*d(3);
+        }
+        #pragma omp critical (BestFocusMerge)
         {
-            int ix=(int)round(matx(iz,i));
-            int iy=(int)round(maty(iz,i));
-//            if(iy <0 || ix >=dims[0] || iy <0 || iy >=dims[1])
-//                cout << "index overflow (" << iz << ", " <<ix << ", " <<iy <<")\n";
-//            else
-               ++ diagram(ix,iy,iz);
+            W+=localW;
+            S1+=localS1;
+            S2+=localS2;
         }
     }
-//    cout << endl << i << "   " << iz << endl;
-    return diagram;
+    if(W <= 0)  // all the rays have a null intensity
+        return 0;
+
+    Array4d mean=S1/W;
+    // variance of position, covariance position-slope, variance of slope, in X then Y
+    Array3d momX, momY;
+    momX << S2(0)/W-mean(0)*mean(0), S2(1)/W-mean(0)*mean(2), S2(2)/W-mean(2)*mean(2);
+    momY << S2(3)/W-mean(1)*mean(1), S2(4)/W-mean(1)*mean(3), S2(5)/W-mean(3)*mean(3);
+    mean+=shift;
+
+    focus.zX= momX(2) > 0 ? -momX(1)/momX(2) : NaN;
+    focus.waistX= sqrt(std::max(0., momX(2) > 0 ? momX(0)-momX(1)*momX(1)/momX(2) : momX(0)));
+    focus.zY= momY(2) > 0 ? -momY(1)/momY(2) : NaN;
+    focus.waistY= sqrt(std::max(0., momY(2) > 0 ? momY(0)-momY(1)*momY(1)/momY(2) : momY(0)));
+
+    Array3d mom=momX+momY;
+    double z= mom(2) > 0 ? -mom(1)/mom(2) : 0;
+    focus.z= mom(2) > 0 ? z : NaN;
+    focus.waist=sqrt(std::max(0., mom(0)+2*z*mom(1)+z*z*mom(2)));
+    focus.meanX=mean(0)+z*mean(2);
+    focus.meanY=mean(1)+z*mean(3);
+    return spotcount;
 }
 
 
@@ -484,7 +850,9 @@ int Surface::getImpactData(Diagram &impactData, FrameID frame)
     if(impactData.m_dim < 6)
         throw std::invalid_argument("Impact data argument should have a vector dimension of at least 6");
 
-    impactData.m_count=m_impacts.size();
+    vector<size_t> alive;
+    impactData.m_lost=getAliveImpacts(alive);
+    impactData.m_count=alive.size();
     if(impactData.m_count==0)
         return 0;
     if(impactData.m_spots)  // buffer is allocated
@@ -503,54 +871,31 @@ int Surface::getImpactData(Diagram &impactData, FrameID frame)
     Map<VectorXd> vMean(impactData.m_mean, impactData.m_dim),vSigma(impactData.m_sigma,impactData.m_dim);
     Map<VectorXd> vMin(impactData.m_min,impactData.m_dim), vMax(impactData.m_max,impactData.m_dim);
 
-    vector<RayType>::iterator pRay;
-    Index ip;
-    impactData.m_lost=0;
-    for(ip=0, pRay=m_impacts.begin(); pRay!=m_impacts.end(); ++pRay)
+    Index ip, count=impactData.m_count, dim=impactData.m_dim;
+    #pragma omp parallel for schedule(static)
+    for(ip=0; ip < count; ++ip)
     {
-        if(pRay->m_alive)
+        RayType ray=getImpactInFrame(alive[ip], frame);
+        spotMat.block<3,1>(0,ip)=ray.origin().cast<double>();
+        spotMat.block<3,1>(3,ip)=ray.direction().cast<double>();
+
+        double Is,Ip;
+        complex<double> prod;
+        if(dim>6)
+            spotMat(6,ip)=ray.m_wavelength;
+        if(dim>7)
         {
-            switch(frame)
-            {
-            case AlignedLocalFrame:  // if impacts are correctly computed position is identical to origin (rebased on surface)
-                spotMat.block<3,1>(0,ip)=(m_frameInverse*pRay->origin()).cast<double>();
-                spotMat.block<3,1>(3,ip)=(m_frameInverse*pRay->direction()).cast<double>();
-                break;
-            case SurfaceFrame:
-                spotMat.block<3,1>(0,ip)=(m_surfaceInverse*pRay->origin()).cast<double>();
-                spotMat.block<3,1>(3,ip)=(m_surfaceInverse*pRay->direction()).cast<double>();
-                break;
-            case GeneralFrame:
-                spotMat.block<3,1>(0,ip)=(pRay->origin()+m_exitFrame.translation()).cast<double>();
-                spotMat.block<3,1>(3,ip)=pRay->direction().cast<double>();
-                break;
-            case LocalAbsoluteFrame:
-                spotMat.block<3,1>(0,ip)=pRay->origin().cast<double>();
-                spotMat.block<3,1>(3,ip)=pRay->direction().cast<double>();
-                break;
-            }
-            double Is,Ip;
-            complex<double> prod;
-            if(impactData.m_dim>6)
-                spotMat(6,ip)=pRay->m_wavelength;
-            if(impactData.m_dim>7)
-            {
-                Is=norm(pRay->m_amplitude_S);   // atn norm(complex<double) retourne la magnitude square, alors que norm(Eigen::Matrix) retourne la norme euclidienne= sqrt(mag square)
-                Ip=norm(pRay->m_amplitude_P);
-                spotMat(7,ip)=Is+Ip;
-            }
-            if(impactData.m_dim>10)
-            {
-                prod=conj(pRay->m_amplitude_S)*pRay->m_amplitude_P;
-                spotMat(8,ip)=Is-Ip;
-                spotMat(9,ip)=prod.real();
-                spotMat(10,ip)=prod.imag();
-            }
-
-            ++ip;
+            Is=norm(ray.m_amplitude_S);   // atn norm(complex<double) retourne la magnitude square, alors que norm(Eigen::Matrix) retourne la norme euclidienne= sqrt(mag square)
+            Ip=norm(ray.m_amplitude_P);
+            spotMat(7,ip)=Is+Ip;
+        }
+        if(dim>10)
+        {
+            prod=conj(ray.m_amplitude_S)*ray.m_amplitude_P;
+            spotMat(8,ip)=Is-Ip;
+            spotMat(9,ip)=prod.real();
+            spotMat(10,ip)=prod.imag();
         }
-        else
-            ++impactData.m_lost;
     }
 
     vMin=spotMat.rowwise().minCoeff();
@@ -558,7 +903,7 @@ int Surface::getImpactData(Diagram &impactData, FrameID frame)
     vMean=spotMat.rowwise().mean();
 
     vSigma=(spotMat.rowwise().squaredNorm().array()/impactData.m_count-vMean.array().square()).sqrt();
-    return ip;
+    return count;
 }
 
 int Surface::getCaustic(Diagram& causticData)
@@ -567,24 +912,26 @@ int Surface::getCaustic(Diagram& causticData)
 //        delete[] causticData.m_spots;
     if(causticData.m_dim < 4)
         throw std::invalid_argument("Caustic data argument should have a vector dimension of at least 4");
-    vector<RayType> impacts;
-    causticData.m_lost=getImpacts(impacts,AlignedLocalFrame);
+    vector<size_t> alive;
+    causticData.m_lost=getAliveImpacts(alive);
 //    if(impacts.size()==0)
 //    {
 //        causticData.m_spots=NULL;
 //        return 0;
 //    }
 
-    ArrayXXd causticMat(causticData.m_dim,impacts.size() );
+    ArrayXXd causticMat(causticData.m_dim,alive.size() );
 
     //  minimum de distance à l'axe oz   param t= (DP.U0 + DP.U U0.U) (1-U0.U^2)  avec U0=UnitZ DP =(P-P0)= P
     //              donc t=(Pz+ P.U Uz  )(1-Uz^2)
 
-    vector<RayType>::iterator pRay;
+    vector<size_t>::iterator pIndex;
 //    causticData.m_dropped=0;
     Index ip;
-    for(ip=0, pRay=impacts.begin(); pRay!=impacts.end(); ++pRay)
+    for(ip=0, pIndex=alive.begin(); pIndex!=alive.end(); ++pIndex)
     {
+        RayType ray=getImpactInFrame(*pIndex, AlignedLocalFrame);
+        RayType* pRay=&ray;
         long double Ut2 = pRay->direction()[0]*pRay->direction()[0] + pRay->direction()[1]*pRay->direction()[1];
         if(Ut2 < 1e-12)
         {
@@ -636,63 +983,68 @@ int Surface::getWavefrontData(Diagram & WFdata, double distance)
     if(WFdata.m_dim < 5)
         throw std::invalid_argument("WavefrontData argument should have a vector dimension of at least 5");
 
-    if(WFdata.m_spots)
-    delete[] WFdata.m_spots;
-
-    vector<RayType> impacts;
-    WFdata.m_lost=getImpacts(impacts,AlignedLocalFrame);
+    vector<size_t> alive;
+    WFdata.m_lost=getAliveImpacts(alive);
 
-    if(impacts.size()==0)
-    {
-        WFdata.m_spots=NULL;
+    WFdata.m_count=alive.size();
+    if(WFdata.m_count==0)
         return 0;
+    if(WFdata.m_spots)  // buffer is allocated
+        if(WFdata.m_reserved < WFdata.m_count) // too small ?
+        {
+            delete [] WFdata.m_spots;
+            WFdata.m_spots=0;
+        }
+    if(! WFdata.m_spots)
+    {
+        WFdata.m_spots=new double[WFdata.m_dim *WFdata.m_count];
+        WFdata.m_reserved = WFdata.m_count;
     }
 
     VectorType referencePoint= VectorType::UnitZ()*distance;
-    Array4Xd WFmat(WFdata.m_dim, impacts.size() );
+    Map<Array<double,Dynamic, Dynamic> > WFmat(WFdata.m_spots, WFdata.m_dim,  WFdata.m_count);
 
-    vector<RayType>::iterator pRay;
-    Index ip;
-    for(ip=0, pRay=impacts.begin(); pRay!=impacts.end(); ++pRay, ++ip)
+    Index ip, count=WFdata.m_count;
+    #pragma omp parallel for schedule(static)
+    for(ip=0; ip < count; ++ip)
     {
+        RayType ray=getImpactInFrame(alive[ip], AlignedLocalFrame);
         //On calcule la projectiondu point de référence sur chaque rayon. C'est l'écart aberrant.
         // celui-ci est ensuite projeté sur les deux directions de référence du plan normal à chaque rayon,
         // pour être ensuite égalées aux dérivées du front d'onde par rapport aux angles d'ouverture
-        VectorType delta=pRay->projection(referencePoint)-referencePoint;
-        WFmat(0,ip)= (delta(0)*pRay->direction()(2)- delta(2)*pRay->direction()(0) ) /sqrtl(1.L-pRay->direction()(1)*pRay->direction()(1));
-        WFmat(1,ip)= (delta(1)*pRay->direction()(2)- delta(2)*pRay->direction()(1) ) /sqrtl(1.L-pRay->direction()(0)*pRay->direction()(0));
-        WFmat.block<2,1>(2,ip)= pRay->direction().segment(0,2).cast<double>();
-        WFmat(4,ip)=pRay->m_wavelength;
-    }
-    Map<Array<double,Dynamic, Dynamic> > WFMap(WFdata.m_spots, WFdata.m_dim,  ip);
-    WFMap.swap(WFmat);
-    return ip;
+        VectorType delta=ray.projection(referencePoint)-referencePoint;
+        WFmat(0,ip)= (delta(0)*ray.direction()(2)- delta(2)*ray.direction()(0) ) /sqrtl(1.L-ray.direction()(1)*ray.direction()(1));
+        WFmat(1,ip)= (delta(1)*ray.direction()(2)- delta(2)*ray.direction()(1) ) /sqrtl(1.L-ray.direction()(0)*ray.direction()(0));
+        WFmat.block<2,1>(2,ip)= ray.direction().segment(0,2).cast<double>();
+        WFmat(4,ip)=ray.m_wavelength;
+    }
+    return count;
 }
 
 MatrixXd Surface::getWavefontExpansion(double distance, Index Nx, Index Ny, Array22d& XYbounds)
 {
     MatrixXd LegendreCoefs;
-    vector<RayType> impacts;
-    getImpacts(impacts,AlignedLocalFrame);
+    vector<size_t> alive;
+    getAliveImpacts(alive);
 
-    if(impacts.size()==0)
+    if(alive.size()==0)
         return LegendreCoefs; //Returns a matrix whose size() is zero
 
     VectorType referencePoint= VectorType::UnitZ()*distance;
-    ArrayX4d slopeMat(impacts.size(),4 );
+    ArrayX4d slopeMat(alive.size(),4 );
 
-    vector<RayType>::iterator pRay;
-    Index ip;
+    Index ip=alive.size();
     // on charge dans le tableau slope mat (cf GetWavefrontData mais attention c'est la transposée de la fonction précédente)
     // dans les colonnes 0 et 1, l'aberration transverse selon x et y (dans le plan perpendiculaire au rayon)
     // dans les colonnes 2 et 4 les coefficient directeur de la direction du rayon
-    for(ip=0, pRay=impacts.begin(); pRay!=impacts.end(); ++pRay, ++ip)
+    #pragma omp parallel for schedule(static)
+    for(Index i=0; i < ip; ++i)
     {
-
-        VectorType delta=pRay->projection(referencePoint)-referencePoint;
-        slopeMat(ip,0)= (delta(0)*pRay->direction()(2)- delta(2)*pRay->direction()(0) ) /sqrtl(1.L-pRay->direction()(1)*pRay->direction()(1));
-        slopeMat(ip,1)= (delta(1)*pRay->direction()(2)- delta(2)*pRay->direction()(1) ) /sqrtl(1.L-pRay->direction()(0)*pRay->direction()(0));
-        slopeMat.block<1,2>(ip,2)= pRay->direction().segment(0,2).cast<double>();  // la direction U
+        RayType ray=getImpactInFrame(alive[i], AlignedLocalFrame);
+        VectorType delta=ray.projection(referencePoint)-referencePoint;
+        slopeMat(i,0)= (delta(0)*ray.direction()(2)- delta(2)*ray.direction()(0) ) /sqrtl(1.L-ray.direction()(1)*ray.direction()(1));
+        slopeMat(i,1)= (delta(1)*ray.direction()(2)- delta(2)*ray.direction()(1) ) /sqrtl(1.L-ray.direction()(0)*ray.direction()(0));
+        slopeMat.block<1,2>(i,2)= ray.direction().segment(0,2).cast<double>();  // la direction U
     }
     XYbounds.row(0)=slopeMat.block(0,2,ip,2).colwise().minCoeff(); // ici il est permis de faire min max sur les valeurs passées dans XY bounds
     XYbounds.row(1)=slopeMat.block(0,2,ip,2).colwise().maxCoeff();
@@ -714,31 +1066,31 @@ void Surface::computeOPD(double distance, Index Nx, Index Ny)
         Peut-on recupérer les fluctuation de direction et en inférer une "rugosité" ?*/
 
     MatrixXd LegendreCoefs;
-    vector<RayType> impacts;
-    getImpacts(impacts,AlignedLocalFrame);
+    vector<size_t> alive;
+    getAliveImpacts(alive);
 
-    if(impacts.size()< (size_t) 2*Nx*Ny)
+    if(alive.size()< (size_t) 2*Nx*Ny)
         throw std::runtime_error("The impact number is too small to compute a valid OPD");
 
     VectorType referencePoint= VectorType::UnitZ()*distance;
     // the slopeMat arrays contains the data required for LegendreIntegrateteSlopes namely transverse X & Y aberration, then  X & Y aperture angles
-    ArrayX4d slopeMat(impacts.size(),4 );  // impacts ne contient que les rayons 'alive'
+    ArrayX4d slopeMat(alive.size(),4 );  // seuls les rayons 'alive' sont pris en compte
 
-    vector<RayType>::iterator pRay;
-    Index ip;
+    Index ip=alive.size();
 
-    m_OPDdata.resize(impacts.size(),3);
-    m_amplitudes.resize(impacts.size(),2);
+    m_OPDdata.resize(alive.size(),3);
+    m_amplitudes.resize(alive.size(),2);
 
-    for(ip=0, pRay=impacts.begin(); pRay!=impacts.end(); ++pRay, ++ip)
+    #pragma omp parallel for schedule(static)
+    for(Index i=0; i < ip; ++i)
     {
-
-        VectorType delta=pRay->projection(referencePoint)-referencePoint;
-        slopeMat(ip,0)= (delta(0)*pRay->direction()(2)- delta(2)*pRay->direction()(0) ) /sqrtl(1.L-pRay->direction()(1)*pRay->direction()(1)); // l'aberration transversale
-        slopeMat(ip,1)= (delta(1)*pRay->direction()(2)- delta(2)*pRay->direction()(1) ) /sqrtl(1.L-pRay->direction()(0)*pRay->direction()(0));
-        slopeMat.block<1,2>(ip,2)= pRay->direction().segment(0,2).cast<double>(); // la direction U
-        m_amplitudes(ip,0)=pRay->m_amplitude_S;
-        m_amplitudes(ip,1)=pRay->m_amplitude_P;
+        RayType ray=getImpactInFrame(alive[i], AlignedLocalFrame);
+        VectorType delta=ray.projection(referencePoint)-referencePoint;
+        slopeMat(i,0)= (delta(0)*ray.direction()(2)- delta(2)*ray.direction()(0) ) /sqrtl(1.L-ray.direction()(1)*ray.direction()(1)); // l'aberration transversale
+        slopeMat(i,1)= (delta(1)*ray.direction()(2)- delta(2)*ray.direction()(1) ) /sqrtl(1.L-ray.direction()(0)*ray.direction()(0));
+        slopeMat.block<1,2>(i,2)= ray.direction().segment(0,2).cast<double>(); // la direction U
+        m_amplitudes(i,0)=ray.m_amplitude_S;
+        m_amplitudes(i,1)=ray.m_amplitude_P;
     }
     m_XYbounds.row(0)=slopeMat.block(0,2,ip,2).colwise().minCoeff(); // ici il est permis de faire min max sur les valeurs passées dans XY bounds
     m_XYbounds.row(1)=slopeMat.block(0,2,ip,2).colwise().maxCoeff();
@@ -772,7 +1124,10 @@ void Surface::computePSF(ndArray<std::complex<double>,3> &PSF, Array2d& pixelSiz
 
     nfft_plan plan;
 
-    nfft_init_2d(&plan,dims[1],dims[0],m_OPDdata.rows());
+    {
+        std::lock_guard<std::mutex> lock(FFTWPlannerMutex()); // nfft_init creates FFTW plans
+        nfft_init_2d(&plan,dims[1],dims[0],m_OPDdata.rows());
+    }
 
     Array2d unorm, ucenter;
     unorm = (m_XYbounds.row(1)-m_XYbounds.row(0))*oversampling;
@@ -808,8 +1163,10 @@ void Surface::computePSF(ndArray<std::complex<double>,3> &PSF, Array2d& pixelSiz
     nfft_adjoint(&plan);
     Ppsf=Tf.transpose()/m_OPDdata.rows();
 
-    nfft_finalize(&plan);  // ceci desalloue toute la structure plan
-
+    {
+        std::lock_guard<std::mutex> lock(FFTWPlannerMutex());
+        nfft_finalize(&plan);  // ceci desalloue toute la structure plan
+    }
 }
 
 void Surface::computePSF(ndArray<std::complex<double>,4> &PSF, Array2d &pixelSizes, ArrayXd &distOffset, double lambda, double oversampling)
@@ -825,7 +1182,10 @@ void Surface::computePSF(ndArray<std::complex<double>,4> &PSF, Array2d &pixelSiz
 
     nfft_plan plan;
 
-    nfft_init_2d(&plan,dims[1],dims[0],m_OPDdata.rows()); // m_OPDdata.rows() is the number of contributing rays
+    {
+        std::lock_guard<std::mutex> lock(FFTWPlannerMutex()); // nfft_init creates FFTW plans
+        nfft_init_2d(&plan,dims[1],dims[0],m_OPDdata.rows()); // m_OPDdata.rows() is the number of contributing rays
+    }
 
     Array2d unorm, ucenter;
     unorm = (m_XYbounds.row(1)-m_XYbounds.row(0))*oversampling;
@@ -868,7 +1228,10 @@ void Surface::computePSF(ndArray<std::complex<double>,4> &PSF, Array2d &pixelSiz
         Ppsf=Tf.transpose()/m_OPDdata.rows();
 
     }
-   nfft_finalize(&plan);  // ceci desalloue toute la structure plan
+    {
+        std::lock_guard<std::mutex> lock(FFTWPlannerMutex());
+        nfft_finalize(&plan);  // ceci desalloue toute la structure plan
+    }
 }
 
 
@@ -1063,7 +1426,9 @@ bool Surface::validateErrorGenerator()
     double xstep=(Limits(1)-Limits(0))/xpoints++;
     double ystep=(Limits(3)-Limits(2))/ypoints++;
 
+#ifdef VERBOSE
     cout << "The generated error map is defined on " << xpoints << " x " << ypoints << " soit " <<  xpoints*ypoints << " points\n";
+#endif // VERBOSE
     if( xpoints < 10 || ypoints < 8 )
     {
         errorstring+="The number of points is abnormally small, check 'surface_limits' and 'sampling' parameters\n";
@@ -1091,11 +1456,13 @@ bool Surface::validateErrorGenerator()
     if(!m_ErrorGeneratorValid)
         SetOptiXLastError(errorstring+ "in ",__FILE__, __func__);
 
+#ifdef VERBOSE
     cout << "Error map generation parameters validated\n";
+#endif // VERBOSE
     return m_ErrorGeneratorValid;
 }
 
-bool Surface::generateSurfaceErrors(int dims[2], double* total_sigma, MatrixXd& normLegendre, bool random_zernike )
+bool Surface::generateSurfaceErrors(int dims[2], double* total_sigma, MatrixXd& normLegendre, bool random_zernike, uint64_t seed )
 {
     if(!hasParameter("error_limits"))
     {
@@ -1141,9 +1508,17 @@ bool Surface::generateSurfaceErrors(int dims[2], double* total_sigma, MatrixXd&
 
 //        cout << "ready to generate a fractal map of " << xpoints << " x "  << ypoints << " intervals\n";
     // increment to the number of points and generate the fractal surface
-    ArrayXXd surfError=fractalSurf.generate(++xpoints, steps(0), ++ypoints, steps(1));
+    if(!seed)
+    {
+        std::random_device rdsource;
+        seed=(uint64_t(rdsource()) << 32) | rdsource();
+    }
+    std::mt19937_64 generator(seed);
+    ArrayXXd surfError=fractalSurf.generate(++xpoints, steps(0), ++ypoints, steps(1), generator());
 
+#ifdef VERBOSE
        cout << "map generated "<< xpoints << " x "  << ypoints << " points\n";
+#endif // VERBOSE
     dims[0]=xpoints;
     dims[1]=ypoints;
     getParameter("residual_sigma", param1);
@@ -1183,7 +1558,10 @@ bool Surface::generateSurfaceErrors(int dims[2], double* total_sigma, MatrixXd&
     {
         MatrixXd  Lcoeffs = LegendreFromNormal(legendre) ;
         if(random_zernike)
-            Lcoeffs.array() *= ArrayXXd::Random(legendre.rows(), legendre.cols());
+        {
+            std::uniform_real_distribution<double> uniformrnd(-1.,1.);
+            Lcoeffs.array() *= ArrayXXd::NullaryExpr(legendre.rows(), legendre.cols(), [&](){return uniformrnd(generator);});
+        }
 
 //            cout << "random legendres:\n" << Lcoeffs << endl;
         surfError+= LegendreSurfaceGrid(surfError.rows(), surfError.cols(), Lcoeffs);
@@ -1192,8 +1570,10 @@ bool Surface::generateSurfaceErrors(int dims[2], double* total_sigma, MatrixXd&
 
         normLegendre=LegendreNormalize(Lcoeffs);
         *total_sigma=sqrt(sigmaRes*sigmaRes+normLegendre.squaredNorm());
+#ifdef VERBOSE
         cout <<"constrained Legendre normalized:\n" << normLegendre ;
         cout << "\n total constrained sigma=" << *total_sigma <<endl;;
+#endif // VERBOSE
     }
 //            cout << "surface errors computed\n";
     if(!m_errorMap)
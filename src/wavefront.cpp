@@ -97,6 +97,41 @@ ArrayXXd LegendreIntegrateSlopes(int Nx, int Ny, const Ref<ArrayX4d>& WFdata, co
 }
 
 
+/** \brief Solves the tensor product least square problem  Lx * C * Ly^T = Z
+ *
+ *  Since the normal equations of a fit on a tensor product basis separate along X and Y, the  Nx x Ny coefficients are obtained
+ *  with two small projections, without building the (numData, Nx*Ny) design matrix.
+ * \param Lx the X basis values at the grid abscissas (rows = grid X size)
+ * \param Ly the Y basis values at the grid ordinates (rows = grid Y size)
+ * \param griddata the gridded values of the function to fit
+ * \return The Nx x Ny array of coefficients
+ */
+static ArrayXXd separableFit(const MatrixXd& Lx, const MatrixXd& Ly, const Ref<const MatrixXd>& griddata)
+{
+    MatrixXd Rhs=(Lx.transpose()*griddata)*Ly;   // (Nx, Ny)
+    MatrixXd Cx=(Lx.transpose()*Lx).ldlt().solve(Rhs);
+    return (Ly.transpose()*Ly).ldlt().solve(Cx.transpose()).transpose().array();
+}
+
+bool GridFromXYZ(const Ref<const ArrayXd>& Xdata, const Ref<const ArrayXd>& Ydata, ArrayXd& Xgrid, ArrayXd& Ygrid)
+{
+    Index numData=Xdata.size(), nx=1;
+    if(numData < 4 || Ydata.size()!=numData)
+        return false;
+    while(nx < numData && Ydata(nx)==Ydata(0))
+        ++nx;
+    if(nx < 2 || nx==numData || numData % nx)
+        return false;
+    Index ny=numData/nx;
+    for(Index j=0, k=0; j < ny; ++j)
+        for(Index i=0; i < nx; ++i, ++k)
+            if(Xdata(k)!=Xdata(i) || Ydata(k)!=Ydata(j*nx))
+                return false;
+    Xgrid=Xdata.head(nx);
+    Ygrid=Map<const ArrayXd, 0, InnerStride<> >(Ydata.data(), ny, InnerStride<>(nx));
+    return true;
+}
+
 ArrayXXd LegendreFitXYZ(int Nx, int Ny, const Ref<ArrayX3d>& XYZdata,
                                 const Ref<Array2d>& Xaperture, const Ref<Array2d>& Yaperture)
 {
@@ -108,6 +143,17 @@ ArrayXXd LegendreFitXYZ(int Nx, int Ny, const Ref<ArrayX3d>& XYZdata,
     double Y0=(Yaperture(1)+Yaperture(0))/2.;
     ArrayXXd Zcoefs=ArrayXXd::Zero(Nx,Ny);
     ArrayXXd Lx, Ly, LPx, LPy;
+
+    ArrayXd Xgrid, Ygrid;
+    if(GridFromXYZ(XYZdata.col(0), XYZdata.col(1), Xgrid, Ygrid))
+    {   // data are sampled on a regular X,Y grid : the fit is separable
+        ArrayXd Xnormed=Kx*(Xgrid-X0), Ynormed=Ky*(Ygrid-Y0);
+        Lx=Legendre(Nx,Xnormed, LPx);
+        Ly=Legendre(Ny,Ynormed, LPy);
+        VectorXd Zcol=XYZdata.col(2);
+        return separableFit(Lx.matrix(), Ly.matrix(), Zcol.reshaped(Xgrid.size(), Ygrid.size()));
+    }
+
     ArrayXd Xnormed=Kx*(XYZdata.col(0)-X0), Ynormed=Ky*(XYZdata.col(1)-Y0);  // ccordonnées normalisés
 
     MatrixXd Mat(numData, nvars), A;
@@ -130,35 +176,16 @@ ArrayXXd LegendreFitXYZ(int Nx, int Ny, const Ref<ArrayX3d>& XYZdata,
 
 ArrayXXd LegendreFitGrid(int Nx, int Ny, const Ref<ArrayXXd>& griddata)
 {
-    Index numData=griddata.rows()*griddata.cols(), nvars=Nx*Ny;
-    Index  i=0,j=0, k=0;
-
-    ArrayXXd Zcoefs=ArrayXXd::Zero(Nx,Ny);
-    ArrayXXd Lx, Ly, LPx, LPy, matLx(griddata.rows(),griddata.cols()), matLy(griddata.rows(),griddata.cols());
+    ArrayXXd LPx, LPy;
     ArrayXd Xnormed=ArrayXd::LinSpaced(griddata.rows(),-1.,1.);
     ArrayXd Ynormed=ArrayXd::LinSpaced(griddata.cols(),-1.,1.);
 
-    MatrixXd Mat(numData, nvars), A;
-    VectorXd Vprim(numData), Rhs;
-    Lx=Legendre(Nx,Xnormed, LPx);
-    Ly=Legendre(Ny,Ynormed, LPy);
-
-    Map<ArrayXd> colLx(matLx.data(),numData,1);
-    Map<ArrayXd> colLy(matLy.data(),numData,1);
-
-    for(j=0, k=0; j < Ny; ++j)
-        for(i=0; i < Nx; ++i, ++k)
-        {
-            matLx.colwise()=Lx.col(i);
-            matLy.rowwise()=Ly.col(j).transpose();
-            Mat.col(k)=colLx*colLy;
-        }
-    A=Mat.transpose()*Mat;
-    Rhs=Mat.transpose()*griddata.matrix().reshaped();
-
-    Map<VectorXd>(Zcoefs.data(), nvars)=A.lu().solve(Rhs);
+    // The design matrix of a grid is the Kronecker product Ly (x) Lx, hence the fit is done as two 1D projections
+    // in O(numData*(Nx+Ny)) instead of building the (numData, Nx*Ny) matrix of the full normal equations
+    MatrixXd Lx=Legendre(Nx,Xnormed, LPx).matrix();
+    MatrixXd Ly=Legendre(Ny,Ynormed, LPy).matrix();
 
-    return Zcoefs;
+    return separableFit(Lx, Ly, griddata.matrix());
 }
 
 
@@ -218,19 +245,36 @@ ArrayXXd LegendreSurfaceGrid(int Nx, int Ny, const Ref<MatrixXd>& legendreCoefs
 
 ArrayXd Legendre2DInterpolate(const Ref<ArrayXd>& Xpos, const Ref<ArrayXd>& Ypos, const Ref<Array22d>& bounds, const Ref<MatrixXd>& legendreCoefs )
 {
-    ArrayXXd Zvalues;
-    MatrixXd Lx, Ly;
-    ArrayXXd deriv;
     double Kx=2./(bounds(1,0)-bounds(0,0));
     double Ky=2./(bounds(1,1)-bounds(0,1));
     double X0=(bounds(1,0)+bounds(0,0))/2.;
     double Y0=(bounds(1,1)+bounds(0,1))/2.;
-    ArrayXd Xnormed=Kx*(Xpos-X0), Ynormed=Ky*(Ypos-Y0);
-
-
-    Lx=Legendre(legendreCoefs.rows(),Xnormed, deriv);
-    Ly=Legendre(legendreCoefs.cols(),Ynormed, deriv);
-    Zvalues=(Lx*legendreCoefs*Ly.transpose()).diagonal(); // Lazy evaluation enforced  see https://stackoverflow.com/questions/37863668/eigen-use-of-diagonal-matrix/37868577#37868577
+    Index numPoints=Xpos.size(), Nx=legendreCoefs.rows(), Ny=legendreCoefs.cols();
+    if(Ypos.size()!=numPoints)
+        throw std::runtime_error("Xpos and Ypos arrays must have the same size");
+
+    // The coefficient matrix is copied to a dense column major buffer since the Ref may have an outer stride
+    MatrixXd coefs=legendreCoefs;
+    ArrayXd Zvalues(numPoints);
+    bool outOfRange=false;
+
+    // Each point is computed independently by nested Clenshaw recurrences, first along X for every column,
+    // then along Y on the resulting Ny values. No basis matrix is built and memory is O(numPoints)
+    #pragma omp parallel reduction(||:outOfRange)
+    {
+        VectorXd colValues(Ny);
+        #pragma omp for schedule(static)
+        for(Index i=0; i < numPoints; ++i)
+        {
+            double x=Kx*(Xpos(i)-X0), y=Ky*(Ypos(i)-Y0);
+            if(x > 1. || x < -1. || y > 1. || y < -1.)
+                outOfRange=true;
+            for(Index j=0; j < Ny; ++j)
+                colValues(j)=LegendreClenshaw(coefs.data()+j*Nx, Nx, x);
+            Zvalues(i)=LegendreClenshaw(colValues.data(), Ny, y);
+        }
+    }
+    if(outOfRange)
+        throw std::runtime_error("Values in Xpos or Ypos vector should be in the [-1, +1] range");
     return Zvalues ;
-
 }